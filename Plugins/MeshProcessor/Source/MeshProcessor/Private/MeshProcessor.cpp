@@ -6,7 +6,15 @@
 #include "AssetToolsModule.h"
 #include "AssetRegistry/AssetRegistryModule.h"
 #include "MeshInfoTableRow.h"
+#include "MeshFaceObjectMap.h"
 #include "RawMesh.h"
+#include "Async/ParallelFor.h"
+#include "UObject/UObjectGlobals.h"
+#include "Engine/DataTable.h"
+#include "Engine/StaticMesh.h"
+#include "Materials/MaterialInterface.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMeshProcessor, Log, All);
 
 #define LOCTEXT_NAMESPACE "FMeshProcessorModule"
 
@@ -22,7 +30,380 @@ void FMeshProcessorModule::ShutdownModule()
 	
 IMPLEMENT_MODULE(FMeshProcessorModule, MeshProcessor)
 
-void CombineStaticMeshes(UObject* Outer, FString OutAssetName, class UDataTable* OutInfoTable)
+namespace
+{
+    //一个待合并的源网格，及其所在的输出网格和在其中的三角形区间
+    struct FSourceMesh
+    {
+        FName ID;
+        UStaticMesh* StaticMesh = nullptr;
+        FRawMesh RawMesh;
+        FBox3f Bounds = FBox3f(ForceInit);
+        int32 NumFaces = 0;
+        int32 NumWedges = 0;
+        int32 NumVertices = 0;
+        //各材质槽的材质和三角形数，材质槽即RawMesh中三角形的材质序号，LoadRawMesh已将其映射为GetStaticMaterials()的序号
+        TArray<UMaterialInterface*> SlotMaterials;
+        TArray<int32> SlotFaceCounts;
+
+        //以下在合并到输出网格时计算
+        int32 OutputIndex = INDEX_NONE;
+        int32 VertexOffset = 0;
+        //各材质槽对应的输出Section，及该材质槽的三角形在输出中的起始位置
+        TArray<int32> SlotSections;
+        TArray<int32> SlotFaceOffsets;
+        //在输出中的三角形区间，按起始位置升序，同一Section内相邻的材质槽合为一段
+        TArray<FMeshSectionFaceRange> SectionRanges;
+    };
+
+    //第一遍：异步加载全部资产包，再并行读取各源网格的RawMesh并统计大小
+    void LoadSourceMeshes(const TArray<FAssetData>& AssetDataArray, TArray<FSourceMesh>& OutSources)
+    {
+        //同时发出全部加载请求，由异步加载线程并行读取，之后一次性等待完成
+        for (const FAssetData& AssetData : AssetDataArray)
+        {
+            if (!AssetData.IsAssetLoaded())
+                LoadPackageAsync(AssetData.PackageName.ToString());
+        }
+        FlushAsyncLoading();
+
+        OutSources.SetNum(AssetDataArray.Num());
+        for (int32 i = 0; i < AssetDataArray.Num(); ++i)
+        {
+            OutSources[i].ID = AssetDataArray[i].AssetName;
+            OutSources[i].StaticMesh = Cast<UStaticMesh>(AssetDataArray[i].GetAsset());
+            check(OutSources[i].StaticMesh && OutSources[i].StaticMesh->GetSourceModels().Num() == 1);
+        }
+
+        //各源网格的数据互不相关，解码网格描述并转换为RawMesh可以并行
+        ParallelFor(OutSources.Num(), [&OutSources](int32 i) {
+            FSourceMesh& Source = OutSources[i];
+            Source.StaticMesh->GetSourceModels()[0].LoadRawMesh(Source.RawMesh);
+            Source.NumWedges = Source.RawMesh.WedgeIndices.Num();
+            Source.NumFaces = Source.NumWedges / 3;
+            Source.NumVertices = Source.RawMesh.VertexPositions.Num();
+            Source.Bounds = FBox3f(Source.RawMesh.VertexPositions);
+
+            for (int32 Face = 0; Face < Source.NumFaces; ++Face)
+            {
+                int32 Slot = Source.RawMesh.FaceMaterialIndices.IsValidIndex(Face) ? FMath::Max(0, Source.RawMesh.FaceMaterialIndices[Face]) : 0;
+                if (Slot >= Source.SlotFaceCounts.Num())
+                {
+                    Source.SlotFaceCounts.SetNumZeroed(Slot + 1);
+                }
+                Source.SlotFaceCounts[Slot]++;
+            }
+
+            //材质序号直接对应静态材质，超出静态材质个数的材质槽为空材质
+            const TArray<FStaticMaterial>& StaticMaterials = Source.StaticMesh->GetStaticMaterials();
+            Source.SlotMaterials.SetNumZeroed(FMath::Max(Source.SlotFaceCounts.Num(), StaticMaterials.Num()));
+            Source.SlotFaceCounts.SetNumZeroed(Source.SlotMaterials.Num());
+            for (int32 Slot = 0; Slot < StaticMaterials.Num(); ++Slot)
+            {
+                Source.SlotMaterials[Slot] = StaticMaterials[Slot].MaterialInterface;
+            }
+            });
+    }
+
+    /**
+     * 按空间位置把源网格分组，每组合并为一个输出网格
+     * 按包围盒中心所在范围的最长轴排序后，在三角形数过半处一分为二，递归直到每组的三角形数和顶点数都不超过上限
+     * 单个源网格超过上限时独占一组；上限为0表示不限制
+     */
+    void PartitionSources(const TArray<FSourceMesh>& Sources, int32 MaxTriangles, int32 MaxVertices, TArray<TArray<int32>>& OutGroups)
+    {
+        const int64 TriangleLimit = MaxTriangles > 0 ? MaxTriangles : MAX_int64;
+        const int64 VertexLimit = MaxVertices > 0 ? MaxVertices : MAX_int64;
+
+        TArray<TArray<int32>> Stack;
+        TArray<int32>& All = Stack.AddDefaulted_GetRef();
+        for (int32 i = 0; i < Sources.Num(); ++i)
+        {
+            All.Add(i);
+        }
+
+        while (Stack.Num() > 0)
+        {
+            TArray<int32> Group = Stack.Pop(false);
+            int64 NumTriangles = 0;
+            int64 NumVertices = 0;
+            FBox3f CenterBounds(ForceInit);
+            for (int32 SourceIndex : Group)
+            {
+                NumTriangles += Sources[SourceIndex].NumFaces;
+                NumVertices += Sources[SourceIndex].NumVertices;
+                CenterBounds += Sources[SourceIndex].Bounds.GetCenter();
+            }
+            if (Group.Num() == 1 || (NumTriangles <= TriangleLimit && NumVertices <= VertexLimit))
+            {
+                //组内按资产名称的顺序合并
+                Group.Sort();
+                OutGroups.Add(MoveTemp(Group));
+                continue;
+            }
+
+            const FVector3f CenterSize = CenterBounds.GetSize();
+            const int32 Axis = CenterSize.X >= CenterSize.Y ? (CenterSize.X >= CenterSize.Z ? 0 : 2) : (CenterSize.Y >= CenterSize.Z ? 1 : 2);
+            Group.Sort([&Sources, Axis](int32 A, int32 B) { return Sources[A].Bounds.GetCenter()[Axis] < Sources[B].Bounds.GetCenter()[Axis]; });
+
+            //两侧都至少有一个源网格
+            int32 Split = 1;
+            int64 LeftTriangles = Sources[Group[0]].NumFaces;
+            while (Split < Group.Num() - 1 && LeftTriangles * 2 < NumTriangles)
+            {
+                LeftTriangles += Sources[Group[Split++]].NumFaces;
+            }
+
+            //右半先入栈，输出的分组保持空间上的先后顺序
+            Stack.Emplace(TArray<int32>(Group.GetData() + Split, Group.Num() - Split));
+            Group.SetNum(Split, false);
+            Stack.Add(MoveTemp(Group));
+        }
+    }
+
+    //角点属性有任何一个源网格提供时，合并结果按角点总数分配，缺少该属性的源网格填默认值
+    template<typename T>
+    FORCEINLINE void CopyWedgeAttribute(TArray<T>& Dest, int32 DestWedge, const TArray<T>& Source, int32 SourceWedge, const T& DefaultValue)
+    {
+        if (Dest.Num() > 0)
+            Dest[DestWedge] = Source.IsValidIndex(SourceWedge) ? Source[SourceWedge] : DefaultValue;
+    }
+
+    /**
+     * 第二遍：合并一组源网格
+     * 收集组内用到的全部材质，相同材质的三角形归入同一个Section；三角形按Section排列，同一Section内按源网格的顺序排列，
+     * 由此计算每个源网格每个材质槽的三角形在目标中的位置，按总大小一次分配目标RawMesh，再并行拷贝各源网格，拷贝完的源网格随即释放
+     * 返回false表示合并结果超出32位索引的范围
+     */
+    bool AppendSourceMeshes(TArray<FSourceMesh>& Sources, TArrayView<const int32> SourceIndices, FRawMesh& DestRawMesh, TArray<FStaticMaterial>& OutMaterials)
+    {
+        int64 TotalFaceCount = 0;
+        int64 TotalVertexCount = 0;
+        bool bHasTangentX = false, bHasTangentY = false, bHasTangentZ = false, bHasTexCoords = false, bHasColors = false;
+        TMap<UMaterialInterface*, int32> MaterialSections;
+        TArray<int32> SectionFaceCounts;
+        for (int32 SourceIndex : SourceIndices)
+        {
+            FSourceMesh& Source = Sources[SourceIndex];
+            Source.VertexOffset = (int32)TotalVertexCount;
+            TotalFaceCount += Source.NumFaces;
+            TotalVertexCount += Source.NumVertices;
+            if (TotalFaceCount * 3 > MAX_int32 || TotalVertexCount > MAX_int32)
+                return false;
+
+            //材质按首次出现的顺序编为Section，只收集有三角形的材质槽
+            Source.SlotSections.Init(INDEX_NONE, Source.SlotMaterials.Num());
+            for (int32 Slot = 0; Slot < Source.SlotMaterials.Num(); ++Slot)
+            {
+                if (Source.SlotFaceCounts[Slot] == 0)
+                    continue;
+                UMaterialInterface* Material = Source.SlotMaterials[Slot];
+                int32* Section = MaterialSections.Find(Material);
+                if (!Section)
+                {
+                    Section = &MaterialSections.Add(Material, OutMaterials.Num());
+                    //不同包中的材质可能同名，材质槽名称附加Section序号以保证唯一
+                    FName SlotName = FName(*FString::Printf(TEXT("%s_%d"), Material ? *Material->GetName() : TEXT("Default"), OutMaterials.Num()));
+                    OutMaterials.Add(FStaticMaterial(Material, SlotName, SlotName));
+                    SectionFaceCounts.Add(0);
+                }
+                Source.SlotSections[Slot] = *Section;
+                SectionFaceCounts[*Section] += Source.SlotFaceCounts[Slot];
+            }
+
+            bHasTangentX |= Source.RawMesh.WedgeTangentX.Num() > 0;
+            bHasTangentY |= Source.RawMesh.WedgeTangentY.Num() > 0;
+            bHasTangentZ |= Source.RawMesh.WedgeTangentZ.Num() > 0;
+            bHasTexCoords |= Source.RawMesh.WedgeTexCoords[0].Num() > 0;
+            bHasColors |= Source.RawMesh.WedgeColors.Num() > 0;
+        }
+
+        //各Section的起始位置，Section内再按源网格的顺序、源网格内按材质槽的顺序分配位置
+        TArray<int32> SectionCursors;
+        SectionCursors.SetNumUninitialized(SectionFaceCounts.Num());
+        int32 SectionStart = 0;
+        for (int32 Section = 0; Section < SectionFaceCounts.Num(); ++Section)
+        {
+            SectionCursors[Section] = SectionStart;
+            SectionStart += SectionFaceCounts[Section];
+        }
+        for (int32 Section = 0; Section < SectionFaceCounts.Num(); ++Section)
+        {
+            for (int32 SourceIndex : SourceIndices)
+            {
+                FSourceMesh& Source = Sources[SourceIndex];
+                if (Section == 0)
+                {
+                    Source.SlotFaceOffsets.Init(0, Source.SlotMaterials.Num());
+                    Source.SectionRanges.Reset();
+                }
+                for (int32 Slot = 0; Slot < Source.SlotSections.Num(); ++Slot)
+                {
+                    if (Source.SlotSections[Slot] != Section)
+                        continue;
+                    Source.SlotFaceOffsets[Slot] = SectionCursors[Section];
+                    int32 FaceCount = Source.SlotFaceCounts[Slot];
+                    if (Source.SectionRanges.Num() > 0 && Source.SectionRanges.Last().SectionIndex == Section)
+                    {
+                        Source.SectionRanges.Last().FaceCount += FaceCount;
+                    }
+                    else
+                    {
+                        FMeshSectionFaceRange& Range = Source.SectionRanges.AddDefaulted_GetRef();
+                        Range.SectionIndex = Section;
+                        Range.StartFaceIndex = SectionCursors[Section];
+                        Range.FaceCount = FaceCount;
+                    }
+                    SectionCursors[Section] += FaceCount;
+                }
+            }
+        }
+
+        const int32 NumWedges = (int32)TotalFaceCount * 3;
+        DestRawMesh.FaceMaterialIndices.SetNumUninitialized((int32)TotalFaceCount);
+        DestRawMesh.FaceSmoothingMasks.SetNumUninitialized((int32)TotalFaceCount);
+        DestRawMesh.WedgeIndices.SetNumUninitialized(NumWedges);
+        DestRawMesh.VertexPositions.SetNumUninitialized((int32)TotalVertexCount);
+        DestRawMesh.WedgeTangentX.SetNumUninitialized(bHasTangentX ? NumWedges : 0);
+        DestRawMesh.WedgeTangentY.SetNumUninitialized(bHasTangentY ? NumWedges : 0);
+        DestRawMesh.WedgeTangentZ.SetNumUninitialized(bHasTangentZ ? NumWedges : 0);
+        DestRawMesh.WedgeTexCoords[0].SetNumUninitialized(bHasTexCoords ? NumWedges : 0);
+        DestRawMesh.WedgeColors.SetNumUninitialized(bHasColors ? NumWedges : 0);
+
+        //各源网格写入目标中互不重叠的位置
+        ParallelFor(SourceIndices.Num(), [&Sources, SourceIndices, &DestRawMesh](int32 i) {
+            FSourceMesh& Source = Sources[SourceIndices[i]];
+            FRawMesh& RawMesh = Source.RawMesh;
+
+            //顶点坐标直接拷贝
+            FMemory::Memcpy(DestRawMesh.VertexPositions.GetData() + Source.VertexOffset, RawMesh.VertexPositions.GetData(), Source.NumVertices * sizeof(FVector3f));
+
+            TArray<int32, TInlineAllocator<16>> SlotCursors(Source.SlotFaceOffsets);
+            for (int32 Face = 0; Face < Source.NumFaces; ++Face)
+            {
+                int32 Slot = RawMesh.FaceMaterialIndices.IsValidIndex(Face) ? FMath::Max(0, RawMesh.FaceMaterialIndices[Face]) : 0;
+                int32 DestFace = SlotCursors[Slot]++;
+                DestRawMesh.FaceMaterialIndices[DestFace] = Source.SlotSections[Slot];
+                DestRawMesh.FaceSmoothingMasks[DestFace] = RawMesh.FaceSmoothingMasks.IsValidIndex(Face) ? RawMesh.FaceSmoothingMasks[Face] : 0;
+
+                for (int32 Corner = 0; Corner < 3; ++Corner)
+                {
+                    int32 DestWedge = DestFace * 3 + Corner;
+                    int32 SourceWedge = Face * 3 + Corner;
+                    //角点的顶点坐标索引增加偏移量，其他角点信息直接拷贝
+                    DestRawMesh.WedgeIndices[DestWedge] = Source.VertexOffset + RawMesh.WedgeIndices[SourceWedge];
+                    CopyWedgeAttribute(DestRawMesh.WedgeTangentX, DestWedge, RawMesh.WedgeTangentX, SourceWedge, FVector3f::ZeroVector);
+                    CopyWedgeAttribute(DestRawMesh.WedgeTangentY, DestWedge, RawMesh.WedgeTangentY, SourceWedge, FVector3f::ZeroVector);
+                    CopyWedgeAttribute(DestRawMesh.WedgeTangentZ, DestWedge, RawMesh.WedgeTangentZ, SourceWedge, FVector3f::ZeroVector);
+                    CopyWedgeAttribute(DestRawMesh.WedgeTexCoords[0], DestWedge, RawMesh.WedgeTexCoords[0], SourceWedge, FVector2f::ZeroVector);
+                    CopyWedgeAttribute(DestRawMesh.WedgeColors, DestWedge, RawMesh.WedgeColors, SourceWedge, FColor::White);
+                }
+            }
+
+            RawMesh.Empty();
+            });
+        return true;
+    }
+
+    //由合并的RawMesh创建静态网格资产，只设置LOD0，第i个Section使用第i个材质，并生成渲染三角形到源物体的对应表
+    UStaticMesh* CreateCombinedStaticMesh(UObject* Outer, const FString& AssetPath, const FString& AssetName, FRawMesh& RawMesh, const TArray<FStaticMaterial>& Materials,
+        const TArray<int32>& RangeStartFaces, const TArray<int32>& RangeObjects, const TArray<FName>& ObjectIDs)
+    {
+        UPackage* NewMeshPack = CreatePackage(Outer, *AssetPath);
+        UStaticMesh* NewStaticMesh = NewObject<UStaticMesh>(NewMeshPack, FName(*AssetName), RF_Public | RF_Standalone);
+        NewStaticMesh->InitResources();
+        NewStaticMesh->PreEditChange(nullptr);
+        NewStaticMesh->SetStaticMaterials(Materials);
+
+        FStaticMeshSourceModel& AddedSrcModel = NewStaticMesh->AddSourceModel();
+        AddedSrcModel.BuildSettings.bRecomputeNormals = false;
+        AddedSrcModel.BuildSettings.bRecomputeTangents = false;
+        AddedSrcModel.BuildSettings.bRemoveDegenerates = false;
+        AddedSrcModel.BuildSettings.bUseHighPrecisionTangentBasis = false;
+        AddedSrcModel.BuildSettings.bUseFullPrecisionUVs = false;
+        AddedSrcModel.BuildSettings.bGenerateLightmapUVs = false;
+        AddedSrcModel.BuildSettings.SrcLightmapIndex = 0;
+        AddedSrcModel.BuildSettings.DstLightmapIndex = 0;
+        AddedSrcModel.SaveRawMesh(RawMesh);
+        RawMesh.Empty();
+        for (int32 Section = 0; Section < Materials.Num(); ++Section)
+        {
+            NewStaticMesh->GetSectionInfoMap().Set(0, Section, FMeshSectionInfo(Section));
+        }
+
+        //交给编辑器构件静态网格资产
+        TArray<FText> BuildErrors;
+        NewStaticMesh->Build(true, &BuildErrors);
+
+        /* 问题：
+        * 参考 UE::Private::StaticMeshBuilder::BuildVertexBuffer
+        * Build的过程中，输入RawMesh的顶点被重排（合并重合顶点），导致最终渲染（和构建碰撞体）的RenderData的FaceIndex与RawMesh的不同
+        * 因此数据表中的StartFaceIndex/FaceCount只对应输入RawMesh，不能直接用拾取到的FaceIndex查询
+        */
+
+        /* 解决方案B（不修改引擎）:
+        * WedgeMap记录了RawMesh三角形角点序号到RenderData顶点索引的对应关系，结合LOD0的索引数组，
+        * 按顶点索引匹配出RenderData的每一个Face对应到哪个输入的源物体，分段压缩后作为AssetUserData存到静态网格资产上
+        * 拾取查询时用拾取到的FaceIndex二分查找该表得到源物体的ID
+        */
+        UMeshFaceObjectMap* FaceObjectMap = NewObject<UMeshFaceObjectMap>(NewStaticMesh, NAME_None, RF_Public | RF_Transactional);
+        if (FaceObjectMap->Build(NewStaticMesh, RangeStartFaces, RangeObjects, ObjectIDs))
+        {
+            NewStaticMesh->AddAssetUserData(FaceObjectMap);
+        }
+        else
+        {
+            //没有对应表时拾取到的FaceIndex无法查询源物体，需清除本地DDC后重新合并
+            UE_LOG(LogMeshProcessor, Warning, TEXT("%s 未能生成三角形对应表, 拾取时无法查询源物体ID, 请清除DDC后重新合并"), *AssetName);
+        }
+
+        //通知编辑器
+        NewStaticMesh->PostEditChange();
+        FAssetRegistryModule::AssetCreated(NewStaticMesh);
+        NewMeshPack->MarkPackageDirty();
+        return NewStaticMesh;
+    }
+
+    //一次性写入数据表：拼成CSV文本后整表导入，避免逐行AddRow时每行都压缩行表并广播修改通知
+    void FillInfoTable(UDataTable* InfoTable, const TArray<FSourceMesh>& Sources, const TArray<UStaticMesh*>& OutputMeshes)
+    {
+        if (InfoTable->RowStruct == nullptr)
+            InfoTable->RowStruct = FMeshInfoTableRow::StaticStruct();
+        if (InfoTable->RowStruct != FMeshInfoTableRow::StaticStruct())
+        {
+            UE_LOG(LogMeshProcessor, Error, TEXT("数据表%s的行结构不是FMeshInfoTableRow"), *InfoTable->GetName());
+            return;
+        }
+
+        TStringBuilder<256> Csv;
+        Csv.Append(TEXT("---,ID,OutputMesh,StartFaceIndex,FaceCount,SectionRanges\n"));
+        for (const FSourceMesh& Source : Sources)
+        {
+            UStaticMesh* OutputMesh = OutputMeshes.IsValidIndex(Source.OutputIndex) ? OutputMeshes[Source.OutputIndex] : nullptr;
+            if (!OutputMesh)
+                continue;
+
+            //数组按ImportText的格式写入，含逗号的单元格加引号
+            FString SectionRanges;
+            for (const FMeshSectionFaceRange& Range : Source.SectionRanges)
+            {
+                SectionRanges += FString::Printf(TEXT("%s(SectionIndex=%d,StartFaceIndex=%d,FaceCount=%d)"), SectionRanges.IsEmpty() ? TEXT("") : TEXT(","), Range.SectionIndex, Range.StartFaceIndex, Range.FaceCount);
+            }
+            int32 StartFaceIndex = Source.SectionRanges.Num() > 0 ? Source.SectionRanges[0].StartFaceIndex : 0;
+            Csv.Appendf(TEXT("%s,%s,%s,%d,%d,\"(%s)\"\n"), *Source.ID.ToString(), *Source.ID.ToString(), *FSoftObjectPath(OutputMesh).ToString(), StartFaceIndex, Source.NumFaces, *SectionRanges);
+        }
+
+        InfoTable->Modify();
+        TArray<FString> Problems = InfoTable->CreateTableFromCSVString(Csv.ToString());
+        for (const FString& Problem : Problems)
+        {
+            UE_LOG(LogMeshProcessor, Warning, TEXT("%s"), *Problem);
+        }
+        InfoTable->MarkPackageDirty();
+    }
+}
+
+void CombineStaticMeshes(UObject* Outer, FString OutAssetName, class UDataTable* OutInfoTable, int32 MaxTrianglesPerMesh, int32 MaxVerticesPerMesh)
 {
     if (!Outer)
         return;
@@ -32,15 +413,15 @@ void CombineStaticMeshes(UObject* Outer, FString OutAssetName, class UDataTable*
         return;
 
     //获取选中的静态网格资产
-    FString AssetPath;
+    FString AssetDir;
     TArray<FAssetData> StaticMesheAssetArray;
     TArray<FAssetData> SelectedAssetDataArray = UEditorUtilityLibrary::GetSelectedAssetData();
     for (FAssetData& AssetData : SelectedAssetDataArray)
     {
         if (AssetData.GetClass() == UStaticMesh::StaticClass())
             StaticMesheAssetArray.Emplace(AssetData);
-        if (AssetPath.IsEmpty())
-            AssetPath = AssetData.PackagePath.ToString() + TEXT("/") + OutAssetName;
+        if (AssetDir.IsEmpty())
+            AssetDir = AssetData.PackagePath.ToString();
     }
     if (StaticMesheAssetArray.Num() == 0)
         return;
@@ -50,119 +431,78 @@ void CombineStaticMeshes(UObject* Outer, FString OutAssetName, class UDataTable*
         [](const FAssetData& A, const FAssetData& B) {return A.AssetName.ToString() < B.AssetName.ToString(); }
     );
 
-    //遍历所有待合并的静态网格资产，取其RawMesh，合并为目标RawMesh，并记录各个源RawMesh的信息
-    FRawMesh DestRawMesh;
-    int32 TotalFaceCount = 0;
-    int32 TotalWedgeCount = 0;
-    int32 TotalVertexCount = 0;
-    for (FAssetData& AssetData : StaticMesheAssetArray)
-    {
-        UStaticMesh* StaticMesh = Cast<UStaticMesh>(AssetData.GetAsset());
-        const TArray<FStaticMeshSourceModel>& SrcModelArray = StaticMesh->GetSourceModels();
-        check(SrcModelArray.Num() == 1);
-        const FStaticMeshSourceModel& SrcModel = SrcModelArray[0];
-        FRawMesh RawMesh;
-        SrcModel.LoadRawMesh(RawMesh);
-
-        int32 NumWedges = RawMesh.WedgeIndices.Num();
-        int32 NumFaces = NumWedges / 3;
-        int32 NumVertices = RawMesh.VertexPositions.Num();
-
-        //置为0
-        DestRawMesh.FaceMaterialIndices.AddZeroed(NumFaces);
-        DestRawMesh.FaceSmoothingMasks.AddZeroed(NumFaces);
+    //分两遍合并：先并行读取全部源网格并统计大小，再按总大小一次分配目标RawMesh并行拷贝，避免逐个追加时的反复扩容
+    double BeginTime = FPlatformTime::Seconds();
+    double PhaseTime = BeginTime;
+    auto EndPhase = [&PhaseTime]() {
+        double Now = FPlatformTime::Seconds();
+        double Elapsed = (Now - PhaseTime) * 1000.0;
+        PhaseTime = Now;
+        return Elapsed;
+    };
 
-        //角点信息直接追加
-        DestRawMesh.WedgeTangentX.Append(RawMesh.WedgeTangentX);
-        DestRawMesh.WedgeTangentY.Append(RawMesh.WedgeTangentY);
-        DestRawMesh.WedgeTangentZ.Append(RawMesh.WedgeTangentZ);
-        DestRawMesh.WedgeTexCoords[0].Append(RawMesh.WedgeTexCoords[0]);
-        DestRawMesh.WedgeColors.Append(RawMesh.WedgeColors);
+    TArray<FSourceMesh> Sources;
+    LoadSourceMeshes(StaticMesheAssetArray, Sources);
+    double LoadTime = EndPhase();
 
-        //顶点坐标直接追加
-        DestRawMesh.VertexPositions.Append(RawMesh.VertexPositions);
+    //按空间位置分组，每组输出一个静态网格，便于视锥剔除并限制单个网格的大小
+    TArray<TArray<int32>> Groups;
+    PartitionSources(Sources, MaxTrianglesPerMesh, MaxVerticesPerMesh, Groups);
 
-        //角点的顶点坐标索引增加偏移量
-        DestRawMesh.WedgeIndices.AddUninitialized(NumWedges);
-        for (int32 i = 0; i < NumWedges; ++i)
+    double CopyTime = 0;
+    double BuildTime = 0;
+    int32 TotalFaceCount = 0;
+    int32 TotalSectionCount = 0;
+    TArray<UStaticMesh*> OutputMeshes;
+    for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); ++GroupIndex)
+    {
+        const TArray<int32>& Group = Groups[GroupIndex];
+        FRawMesh DestRawMesh;
+        TArray<FStaticMaterial> Materials;
+        if (!AppendSourceMeshes(Sources, Group, DestRawMesh, Materials))
         {
-            DestRawMesh.WedgeIndices[TotalWedgeCount + i] = TotalVertexCount + RawMesh.WedgeIndices[i];
+            UE_LOG(LogMeshProcessor, Error, TEXT("合并结果超出32位索引的范围: %d个源网格, 请设置三角形数和顶点数的上限"), Group.Num());
+            continue;
         }
+        CopyTime += EndPhase();
+        if (!DestRawMesh.IsValid())
+            continue;
 
-        //记录到数据表
-        FMeshInfoTableRow RowData;
-        RowData.ID = AssetData.AssetName;
-        RowData.StartFaceIndex = TotalFaceCount;
-        RowData.FaceCount = NumFaces;
-        OutInfoTable->AddRow(AssetData.AssetName, RowData);
+        //三角形按Section排列，一个源网格可能有多段三角形，按起始位置排序后交给对应表
+        TArray<TPair<int32, int32>> Ranges;
+        TArray<FName> SourceIDs;
+        for (int32 SourceIndex : Group)
+        {
+            Sources[SourceIndex].OutputIndex = OutputMeshes.Num();
+            for (const FMeshSectionFaceRange& Range : Sources[SourceIndex].SectionRanges)
+            {
+                Ranges.Emplace(Range.StartFaceIndex, SourceIDs.Num());
+            }
+            SourceIDs.Add(Sources[SourceIndex].ID);
+        }
+        Ranges.Sort([](const TPair<int32, int32>& A, const TPair<int32, int32>& B) { return A.Key < B.Key; });
+        TArray<int32> RangeStartFaces;
+        TArray<int32> RangeObjects;
+        for (const TPair<int32, int32>& Range : Ranges)
+        {
+            RangeStartFaces.Add(Range.Key);
+            RangeObjects.Add(Range.Value);
+        }
+        TotalFaceCount += DestRawMesh.FaceMaterialIndices.Num();
+        TotalSectionCount += Materials.Num();
 
-        TotalFaceCount += NumFaces;
-        TotalWedgeCount += NumWedges;
-        TotalVertexCount += NumVertices;
+        //只有一个输出时沿用指定的名称，否则按空间分组的顺序加序号
+        FString AssetName = Groups.Num() == 1 ? OutAssetName : FString::Printf(TEXT("%s_%d"), *OutAssetName, GroupIndex);
+        OutputMeshes.Add(CreateCombinedStaticMesh(Outer, AssetDir / AssetName, AssetName, DestRawMesh, Materials, RangeStartFaces, RangeObjects, SourceIDs));
+        BuildTime += EndPhase();
     }
-
-    if (!DestRawMesh.IsValid())
+    if (OutputMeshes.Num() == 0)
         return;
 
-    //创建静态网格资产
-    UPackage* NewMeshPack = CreatePackage(Outer, *AssetPath);
-    UStaticMesh* NewStaticMesh = NewObject<UStaticMesh>(NewMeshPack, FName(*OutAssetName), RF_Public | RF_Standalone);
-    NewStaticMesh->InitResources();
-    NewStaticMesh->PreEditChange(nullptr);
-
-    //合并的RawMesh设置给新建的静态网格资产，只设置LOD0
-    FStaticMeshSourceModel& AddedSrcModel = NewStaticMesh->AddSourceModel();
-    AddedSrcModel.BuildSettings.bRecomputeNormals = false;
-    AddedSrcModel.BuildSettings.bRecomputeTangents = false;
-    AddedSrcModel.BuildSettings.bRemoveDegenerates = false;
-    AddedSrcModel.BuildSettings.bUseHighPrecisionTangentBasis = false;
-    AddedSrcModel.BuildSettings.bUseFullPrecisionUVs = false;
-    AddedSrcModel.BuildSettings.bGenerateLightmapUVs = false;
-    AddedSrcModel.BuildSettings.SrcLightmapIndex = 0;
-    AddedSrcModel.BuildSettings.DstLightmapIndex = 0;
-    AddedSrcModel.SaveRawMesh(DestRawMesh);
-
-    //交给编辑器构件静态网格资产
-    TArray<FText> BuildErrors;
-    NewStaticMesh->Build(true, &BuildErrors); 
-    
-    //通知编辑器
-    NewStaticMesh->PostEditChange();
-    FAssetRegistryModule::AssetCreated(NewStaticMesh);
-    NewMeshPack->MarkPackageDirty();
-
-    /* 问题： 
-    * 参考 UE::Private::StaticMeshBuilder::BuildVertexBuffer
-    * Build的过程中，输入RawMesh的顶点被重排（合并重合顶点），导致最终渲染（和构建碰撞体）的RenderData的FaceIndex与RawMesh的不同
-    */
-
-    /* 解决方案A:
-    * 修改引擎将BuildVertexBuffer中合并重合顶点的逻辑屏蔽掉，即可使构造的RenderData与输入RawMesh的FaceIndex一致
-    * 拾取查询仍按原方案使用FaceIndex查询DataTable
-    */
-    //引擎StaticMeshBuilder.cpp文件中，BuildVertexBuffer函数，注释掉以下一段代码：
-    /*
-            for (int32 k = 0; k < DupVerts.Num(); k++)
-            {
-                if (DupVerts[k] >= WedgeIndex)
-                {
-                    break;
-                }
-                int32 Location = RemapVerts.IsValidIndex(DupVerts[k]) ? RemapVerts[DupVerts[k]] : INDEX_NONE;
-                if (Location != INDEX_NONE && AreVerticesEqual(StaticMeshVertex, StaticMeshBuildVertices[Location], VertexComparisonThreshold))
-                {
-                    Index = Location;
-                    break;
-                }
-            }
-    */
-
-    /* 解决方案B:
-    * WedgeMap记录了RawMesh三角形角点序号到RenderData顶点索引的对应关系
-    * 要得到RawMesh三角形对应到RenderData的FaceIndex，除了WedgeMap外还需要RenderData的索引数组(SectionIndices)
-    * 需要做如下处理：
-    * 1. 修改引擎将SectionIndices存到FStaticMeshSection中
-    * 2. 在Build后，利用WedgeMap和SectionIndices计算出RenderData的每一个Face对应到哪个输入的RawMesh（FaceObjectIndexArray）
-    * 3. 在拾取查询时，用拾取到的FaceIndex查FaceObjectIndexArray表获取到对应的ObjectIndex，再到DataTable中查其ID
-    */
-}
\ No newline at end of file
+    //全部输出共用一个数据表，记录各源网格所在的输出网格和各Section中的三角形区间
+    FillInfoTable(OutInfoTable, Sources, OutputMeshes);
+    double TableTime = EndPhase();
+
+    UE_LOG(LogMeshProcessor, Display, TEXT("合并静态网格: %s, %d个源网格, 输出%d个网格, %d个Section, %d个三角形, 总耗时%.1fms (加载%.1fms, 拷贝%.1fms, 构建%.1fms, 数据表%.1fms)"),
+        *OutAssetName, Sources.Num(), OutputMeshes.Num(), TotalSectionCount, TotalFaceCount, (FPlatformTime::Seconds() - BeginTime) * 1000.0, LoadTime, CopyTime, BuildTime, TableTime);
+}
@@ -4,7 +4,7 @@
 #include "MyAssetActionUtility.h"
 #include "MeshProcessor.h"
 
-void UMyAssetActionUtility::CombineStaticMeshes(FString OutAssetName, class UDataTable* OutInfoTable)
+void UMyAssetActionUtility::CombineStaticMeshes(FString OutAssetName, class UDataTable* OutInfoTable, int32 MaxTrianglesPerMesh, int32 MaxVerticesPerMesh)
 {
-    ::CombineStaticMeshes(this, OutAssetName, OutInfoTable);
+    ::CombineStaticMeshes(this, OutAssetName, OutInfoTable, MaxTrianglesPerMesh, MaxVerticesPerMesh);
 }
\ No newline at end of file
@@ -6,5 +6,5 @@
 
 void UMyEditorUtilityWidget::CombineStaticMeshes()
 {
-    ::CombineStaticMeshes(this, AssetName, InfoTable);
+    ::CombineStaticMeshes(this, AssetName, InfoTable, MaxTrianglesPerMesh, MaxVerticesPerMesh);
 }
\ No newline at end of file
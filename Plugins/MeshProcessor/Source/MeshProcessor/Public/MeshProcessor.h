@@ -15,4 +15,5 @@ public:
 };
 
 //合并选中的静态网格资源
-void CombineStaticMeshes(UObject* Outer, FString OutAssetName, class UDataTable* OutInfoTable);
\ No newline at end of file
+//按空间位置分组输出多个静态网格，每个输出的三角形数和顶点数不超过上限（0表示不限制，只输出一个），各源网格所在的输出和三角形区间记录在OutInfoTable中
+void CombineStaticMeshes(UObject* Outer, FString OutAssetName, class UDataTable* OutInfoTable, int32 MaxTrianglesPerMesh = 0, int32 MaxVerticesPerMesh = 0);
\ No newline at end of file
@@ -16,5 +16,5 @@ class MESHPROCESSOR_API UMyAssetActionUtility : public UAssetActionUtility
 
 public:
 	UFUNCTION(CallInEditor)
-	void CombineStaticMeshes(FString OutAssetName, class UDataTable* OutInfoTable);	
+	void CombineStaticMeshes(FString OutAssetName, class UDataTable* OutInfoTable, int32 MaxTrianglesPerMesh = 1000000, int32 MaxVerticesPerMesh = 1000000);
 };
@@ -23,4 +23,12 @@ public:
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "CombineStaticMeshes")
 	class UDataTable* InfoTable;
+
+	//每个输出网格的三角形数上限，超出时按空间位置拆分为多个输出，0表示不限制
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "CombineStaticMeshes")
+	int32 MaxTrianglesPerMesh = 1000000;
+
+	//每个输出网格的顶点数上限，0表示不限制
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "CombineStaticMeshes")
+	int32 MaxVerticesPerMesh = 1000000;
 };
@@ -0,0 +1,132 @@
+#include "MeshFaceObjectMap.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+#include "Algo/BinarySearch.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMeshFaceObjectMap, Log, All);
+
+#if WITH_EDITOR
+namespace
+{
+    //三角形的三个顶点索引，旋转到最小索引在前，保持绕序，使同一个三角形得到同一个键
+    FIntVector MakeTriangleKey(int32 V0, int32 V1, int32 V2)
+    {
+        if (V1 < V0 && V1 < V2)
+            return FIntVector(V1, V2, V0);
+        if (V2 < V0 && V2 < V1)
+            return FIntVector(V2, V0, V1);
+        return FIntVector(V0, V1, V2);
+    }
+}
+
+bool UMeshFaceObjectMap::Build(const UStaticMesh* StaticMesh, const TArray<int32>& SourceRangeStartFaces, const TArray<int32>& SourceRangeObjects, const TArray<FName>& SourceIDs)
+{
+    RangeStartFaces.Reset();
+    RangeObjects.Reset();
+    ObjectIDs = SourceIDs;
+    NumFaces = 0;
+
+    const FStaticMeshRenderData* RenderData = StaticMesh ? StaticMesh->GetRenderData() : nullptr;
+    if (!RenderData || RenderData->LODResources.Num() == 0 || SourceRangeStartFaces.Num() != SourceRangeObjects.Num())
+    {
+        UE_LOG(LogMeshFaceObjectMap, Error, TEXT("三角形对应表构建失败: %s, 没有渲染数据或区间数据不一致(%d个起始序号, %d个源物体序号)"),
+            StaticMesh ? *StaticMesh->GetName() : TEXT("None"), SourceRangeStartFaces.Num(), SourceRangeObjects.Num());
+        return false;
+    }
+
+    //WedgeMap记录输入三角形的每个角点在RenderData中的顶点索引，合并重合顶点后顶点序号和三角形序号都与输入不同
+    const FStaticMeshLODResources& LODResource = RenderData->LODResources[0];
+    const TArray<int32>& WedgeMap = LODResource.WedgeMap;
+    TArray<uint32> Indices;
+    LODResource.IndexBuffer.GetCopy(Indices);
+    if (WedgeMap.Num() == 0 || Indices.Num() == 0)
+    {
+        //WedgeMap只在本地构建时生成，不存入DDC；渲染数据取自DDC时为空
+        UE_LOG(LogMeshFaceObjectMap, Error, TEXT("三角形对应表构建失败: %s, WedgeMap为空(%d)或索引为空(%d), 渲染数据可能取自DDC而非本地构建"),
+            *StaticMesh->GetName(), WedgeMap.Num(), Indices.Num());
+        return false;
+    }
+
+    //渲染三角形的序号与碰撞体一致：按Section顺序，每个Section内按索引顺序
+    TArray<FIntVector> RenderFaceKeys;
+    for (const FStaticMeshSection& Section : LODResource.Sections)
+    {
+        for (uint32 i = 0; i < Section.NumTriangles; ++i)
+        {
+            uint32 Index = Section.FirstIndex + i * 3;
+            RenderFaceKeys.Add(MakeTriangleKey(Indices[Index], Indices[Index + 1], Indices[Index + 2]));
+        }
+    }
+    const int32 NumRenderFaces = RenderFaceKeys.Num();
+    NumFaces = NumRenderFaces;
+
+    //顶点相同的渲染三角形按序号升序串成链表，重复的三角形依次分配给输入三角形
+    TMap<FIntVector, int32> FirstFaces;
+    FirstFaces.Reserve(NumRenderFaces);
+    TArray<int32> NextFaces;
+    NextFaces.Init(INDEX_NONE, NumRenderFaces);
+    for (int32 Face = NumRenderFaces - 1; Face >= 0; --Face)
+    {
+        int32& First = FirstFaces.FindOrAdd(RenderFaceKeys[Face], INDEX_NONE);
+        NextFaces[Face] = First;
+        First = Face;
+    }
+
+    TArray<int32> FaceObjects;
+    FaceObjects.Init(INDEX_NONE, NumRenderFaces);
+    int32 NumUnmatched = 0;
+    int32 SourceRange = INDEX_NONE;
+    const int32 NumSourceFaces = WedgeMap.Num() / 3;
+    for (int32 SourceFace = 0; SourceFace < NumSourceFaces; ++SourceFace)
+    {
+        //输入三角形按序号递增，所属的区间也递增
+        while (SourceRange + 1 < SourceRangeStartFaces.Num() && SourceRangeStartFaces[SourceRange + 1] <= SourceFace)
+        {
+            SourceRange++;
+        }
+
+        int32 V0 = WedgeMap[SourceFace * 3 + 0];
+        int32 V1 = WedgeMap[SourceFace * 3 + 1];
+        int32 V2 = WedgeMap[SourceFace * 3 + 2];
+        int32* First = (V0 != INDEX_NONE && V1 != INDEX_NONE && V2 != INDEX_NONE) ? FirstFaces.Find(MakeTriangleKey(V0, V1, V2)) : nullptr;
+        if (!First || *First == INDEX_NONE)
+        {
+            //构建时被移除的三角形
+            NumUnmatched++;
+            continue;
+        }
+        FaceObjects[*First] = SourceRangeObjects.IsValidIndex(SourceRange) && SourceIDs.IsValidIndex(SourceRangeObjects[SourceRange]) ? SourceRangeObjects[SourceRange] : INDEX_NONE;
+        *First = NextFaces[*First];
+    }
+
+    //相邻且属于同一源物体的三角形合为一段
+    for (int32 Face = 0; Face < NumRenderFaces; ++Face)
+    {
+        if (RangeObjects.Num() == 0 || RangeObjects.Last() != FaceObjects[Face])
+        {
+            RangeStartFaces.Add(Face);
+            RangeObjects.Add(FaceObjects[Face]);
+        }
+    }
+
+    UE_LOG(LogMeshFaceObjectMap, Display, TEXT("三角形对应表: %s, 渲染三角形%d个, 输入三角形%d个(%d个未对应), 源物体%d个, 分段%d个"),
+        *StaticMesh->GetName(), NumRenderFaces, NumSourceFaces, NumUnmatched, SourceIDs.Num(), RangeStartFaces.Num());
+    return true;
+}
+#endif
+
+int32 UMeshFaceObjectMap::FindObjectIndex(int32 FaceIndex) const
+{
+    if (FaceIndex < 0 || FaceIndex >= NumFaces)
+        return INDEX_NONE;
+
+    //最后一个起始序号不大于FaceIndex的段
+    int32 Range = Algo::UpperBound(RangeStartFaces, FaceIndex) - 1;
+    return RangeObjects.IsValidIndex(Range) ? RangeObjects[Range] : INDEX_NONE;
+}
+
+FName UMeshFaceObjectMap::FindObjectID(int32 FaceIndex) const
+{
+    int32 ObjectIndex = FindObjectIndex(FaceIndex);
+    return ObjectIDs.IsValidIndex(ObjectIndex) ? ObjectIDs[ObjectIndex] : NAME_None;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/AssetUserData.h"
+#include "MeshFaceObjectMap.generated.h"
+
+class UStaticMesh;
+
+//合并的静态网格中渲染(及碰撞)三角形序号到源物体的对应表，挂在静态网格资产上
+//按三角形序号分段存储，相邻且属于同一源物体的三角形合为一段，查询时二分查找
+UCLASS()
+class MESHUTILS_API UMeshFaceObjectMap : public UAssetUserData
+{
+    GENERATED_BODY()
+
+public:
+#if WITH_EDITOR
+    //在Build之后调用，由LOD0的WedgeMap和索引数组计算每个渲染三角形对应的源物体
+    //输入RawMesh按源物体的三角形区间划分，一个源物体可以有多个区间（如分属不同Section）
+    //SourceRangeStartFaces为各区间的起始三角形序号（升序），SourceRangeObjects为各区间所属源物体在SourceIDs中的序号
+    bool Build(const UStaticMesh* StaticMesh, const TArray<int32>& SourceRangeStartFaces, const TArray<int32>& SourceRangeObjects, const TArray<FName>& SourceIDs);
+#endif
+
+    //查询三角形所属源物体的序号，找不到时返回INDEX_NONE
+    int32 FindObjectIndex(int32 FaceIndex) const;
+
+    //查询三角形所属源物体的ID，找不到时返回NAME_None
+    FName FindObjectID(int32 FaceIndex) const;
+
+    int32 GetNumRanges() const { return RangeStartFaces.Num(); }
+
+private:
+    //各段的起始三角形序号，升序
+    UPROPERTY()
+    TArray<int32> RangeStartFaces;
+
+    //各段对应的源物体序号，INDEX_NONE表示未能对应到源物体的三角形
+    UPROPERTY()
+    TArray<int32> RangeObjects;
+
+    UPROPERTY(VisibleAnywhere, Category = "Mesh Info")
+    TArray<FName> ObjectIDs;
+
+    //渲染三角形总数
+    UPROPERTY(VisibleAnywhere, Category = "Mesh Info")
+    int32 NumFaces = 0;
+};
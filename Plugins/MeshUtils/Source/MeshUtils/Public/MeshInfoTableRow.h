@@ -4,6 +4,25 @@
 #include "Engine/DataTable.h"
 #include "MeshInfoTableRow.generated.h"
 
+class UStaticMesh;
+
+//源网格在输出网格一个Section中的三角形区间
+USTRUCT(BlueprintType)
+struct FMeshSectionFaceRange
+{
+    GENERATED_USTRUCT_BODY()
+
+public:
+    UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh Info")
+    int32 SectionIndex = 0;
+
+    UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh Info")
+    int32 StartFaceIndex = 0;
+
+    UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh Info")
+    int32 FaceCount = 0;
+};
+
 //记录原始StaticMesh信息的表格数据结构
 USTRUCT(BlueprintType)
 struct FMeshInfoTableRow : public FTableRowBase
@@ -16,9 +35,18 @@ public:
     UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh Info")
     FName ID;
 
+    //源网格被合并到的输出网格，输出网格的三角形按Section（材质）排列，源网格的三角形在每个用到的Section中各占一段，见SectionRanges
+    //StartFaceIndex为第一段的起点，FaceCount为源网格的三角形总数，源网格只用一个材质时即是其三角形区间
+    UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh Info")
+    TSoftObjectPtr<UStaticMesh> OutputMesh;
+
     UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh Info")
     int32 StartFaceIndex;
 
     UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh Info")
     int32 FaceCount;
+
+    //按StartFaceIndex升序
+    UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh Info")
+    TArray<FMeshSectionFaceRange> SectionRanges;
 };
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "XSPBoundsBVH.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+#include "ConvexVolume.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPBVHBenchmark, Log, All);
+
+/**
+ * 节点空间索引的基准测试
+ * 生成随机分布的包围盒,测量BVH的构建耗时,并与逐个测试全部包围盒比较视锥/球/包围盒/射线查询的耗时,同时校验两者的结果一致
+ */
+namespace
+{
+    //随机视锥:视点和朝向随机,90度视角,远平面为场景尺寸的一半
+    FConvexVolume MakeRandomFrustum(FRandomStream& Random, float SceneSize)
+    {
+        FVector Origin(Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize * 0.1f));
+        FRotator Rotation(Random.FRandRange(-30, 30), Random.FRandRange(0, 360), 0);
+        FMatrix ViewMatrix = FTranslationMatrix(-Origin) * FInverseRotationMatrix(Rotation) * FMatrix(
+            FPlane(0, 0, 1, 0),
+            FPlane(1, 0, 0, 0),
+            FPlane(0, 1, 0, 0),
+            FPlane(0, 0, 0, 1));
+        FMatrix ProjMatrix = FPerspectiveMatrix(HALF_PI * 0.5f, 16.0f, 9.0f, 10.0f, SceneSize * 0.5f);
+        FConvexVolume Frustum;
+        GetViewFrustumBounds(Frustum, ViewMatrix * ProjMatrix, true);
+        return Frustum;
+    }
+
+    //结果排序后比较,两种查找输出的顺序不同
+    bool SameResult(TArray<int32>& Lhs, TArray<int32>& Rhs)
+    {
+        Lhs.Sort();
+        Rhs.Sort();
+        return Lhs == Rhs;
+    }
+
+    void BenchmarkBVH(const TArray<FString>& Args)
+    {
+        int32 NumBoxes = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1000000;
+        int32 NumQueries = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 100;
+
+        //场景尺寸随包围盒个数增长,使包围盒的密度大致不变
+        FRandomStream Random(12345);
+        float SceneSize = 100.0f * FMath::Sqrt((float)NumBoxes) * 10.0f;
+        TArray<FBox3f> Bounds;
+        Bounds.SetNumUninitialized(NumBoxes);
+        for (FBox3f& Box : Bounds)
+        {
+            FVector3f Center(Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize * 0.1f));
+            FVector3f Extent(Random.FRandRange(10, 500), Random.FRandRange(10, 500), Random.FRandRange(10, 500));
+            Box = FBox3f(Center - Extent, Center + Extent);
+        }
+
+        double BeginTime = FPlatformTime::Seconds();
+        FXSPBoundsBVH BVH;
+        BVH.Build(Bounds);
+        double BuildTime = FPlatformTime::Seconds() - BeginTime;
+        UE_LOG(LogXSPBVHBenchmark, Display, TEXT("BVH测试: %d个包围盒, %d个BVH节点, 构建耗时%.2fms, 每种查询%d次"), NumBoxes, BVH.NumNodes(), BuildTime * 1000.0, NumQueries);
+
+        double BruteForceTime = 0;
+        double BVHTime = 0;
+        int64 NumResults = 0;
+        bool bMatch = true;
+        TArray<int32> BruteForceResult;
+        TArray<int32> BVHResult;
+        auto Report = [&](const TCHAR* Name) {
+            UE_LOG(LogXSPBVHBenchmark, Display, TEXT("\t%s: 逐个测试%.3fms/次, BVH %.3fms/次, 平均命中%lld个%s"), Name,
+                BruteForceTime * 1000.0 / NumQueries, BVHTime * 1000.0 / NumQueries, NumResults / NumQueries, bMatch ? TEXT("") : TEXT(", 结果不一致!"));
+            BruteForceTime = 0;
+            BVHTime = 0;
+            NumResults = 0;
+            bMatch = true;
+        };
+
+        for (int32 q = 0; q < NumQueries; ++q)
+        {
+            FConvexVolume Frustum = MakeRandomFrustum(Random, SceneSize);
+            BruteForceResult.Reset();
+            BeginTime = FPlatformTime::Seconds();
+            for (int32 i = 0; i < NumBoxes; ++i)
+            {
+                if (Frustum.IntersectBox(FVector(Bounds[i].GetCenter()), FVector(Bounds[i].GetExtent())))
+                    BruteForceResult.Add(i);
+            }
+            BruteForceTime += FPlatformTime::Seconds() - BeginTime;
+
+            BVHResult.Reset();
+            BeginTime = FPlatformTime::Seconds();
+            BVH.QueryConvex(Frustum.Planes, BVHResult);
+            BVHTime += FPlatformTime::Seconds() - BeginTime;
+            NumResults += BVHResult.Num();
+            bMatch &= SameResult(BruteForceResult, BVHResult);
+        }
+        Report(TEXT("视锥"));
+
+        for (int32 q = 0; q < NumQueries; ++q)
+        {
+            FVector3f Center(Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize * 0.1f));
+            float Radius = SceneSize * 0.05f;
+            BruteForceResult.Reset();
+            BeginTime = FPlatformTime::Seconds();
+            for (int32 i = 0; i < NumBoxes; ++i)
+            {
+                if (Bounds[i].ComputeSquaredDistanceToPoint(Center) <= Radius * Radius)
+                    BruteForceResult.Add(i);
+            }
+            BruteForceTime += FPlatformTime::Seconds() - BeginTime;
+
+            BVHResult.Reset();
+            BeginTime = FPlatformTime::Seconds();
+            BVH.QuerySphere(Center, Radius, BVHResult);
+            BVHTime += FPlatformTime::Seconds() - BeginTime;
+            NumResults += BVHResult.Num();
+            bMatch &= SameResult(BruteForceResult, BVHResult);
+        }
+        Report(TEXT("球"));
+
+        for (int32 q = 0; q < NumQueries; ++q)
+        {
+            FVector3f Center(Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize * 0.1f));
+            FBox3f QueryBox = FBox3f(Center, Center).ExpandBy(SceneSize * 0.05f);
+            BruteForceResult.Reset();
+            BeginTime = FPlatformTime::Seconds();
+            for (int32 i = 0; i < NumBoxes; ++i)
+            {
+                if (Bounds[i].Intersect(QueryBox))
+                    BruteForceResult.Add(i);
+            }
+            BruteForceTime += FPlatformTime::Seconds() - BeginTime;
+
+            BVHResult.Reset();
+            BeginTime = FPlatformTime::Seconds();
+            BVH.QueryBox(QueryBox, BVHResult);
+            BVHTime += FPlatformTime::Seconds() - BeginTime;
+            NumResults += BVHResult.Num();
+            bMatch &= SameResult(BruteForceResult, BVHResult);
+        }
+        Report(TEXT("包围盒"));
+
+        TArray<FXSPBVHRayHit> RayHits;
+        for (int32 q = 0; q < NumQueries; ++q)
+        {
+            FVector3f Origin(Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize * 0.1f));
+            FVector3f Direction = FVector3f(Random.VRand()).GetSafeNormal();
+            float MaxDistance = SceneSize;
+            BruteForceResult.Reset();
+            BeginTime = FPlatformTime::Seconds();
+            for (int32 i = 0; i < NumBoxes; ++i)
+            {
+                if (FMath::LineBoxIntersection(FBox(Bounds[i]), FVector(Origin), FVector(Origin + Direction * MaxDistance), FVector(Direction * MaxDistance)))
+                    BruteForceResult.Add(i);
+            }
+            BruteForceTime += FPlatformTime::Seconds() - BeginTime;
+
+            RayHits.Reset();
+            BeginTime = FPlatformTime::Seconds();
+            BVH.QueryRay(Origin, Direction, MaxDistance, RayHits);
+            BVHTime += FPlatformTime::Seconds() - BeginTime;
+            NumResults += RayHits.Num();
+            //射线与包围盒相切时两种算法的浮点误差可能不同,只比较命中个数
+            bMatch &= FMath::Abs(BruteForceResult.Num() - RayHits.Num()) <= 1;
+        }
+        Report(TEXT("射线"));
+    }
+}
+
+static FAutoConsoleCommand CmdXSPBenchmarkBVH(
+    TEXT("XSP.BenchmarkBVH"),
+    TEXT("Measure build time and query throughput of the node bounds BVH against testing every box.\n")
+    TEXT("Usage: XSP.BenchmarkBVH [NumBoxes=1000000] [NumQueries=100]"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkBVH)
+);
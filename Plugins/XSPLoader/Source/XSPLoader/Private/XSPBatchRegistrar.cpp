@@ -0,0 +1,32 @@
+#include "XSPBatchRegistrar.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+
+int32 FXSPBatchRegistrar::Flush()
+{
+    check(IsInGameThread());
+
+    //相邻的同一World的组件共用一个上下文,通常只有一个World
+    int32 NumRegistered = 0;
+    int32 Begin = 0;
+    while (Begin < Components.Num())
+    {
+        UWorld* World = Components[Begin]->GetWorld();
+        FRegisterComponentContext Context(World);
+        int32 End = Begin;
+        for (; End < Components.Num() && Components[End]->GetWorld() == World; ++End)
+        {
+            UPrimitiveComponent* Component = Components[End];
+            if (nullptr != World && !Component->IsRegistered())
+            {
+                Component->RegisterComponentWithWorld(World, &Context);
+                NumRegistered++;
+            }
+        }
+        //本组的图元一次性加入场景
+        Context.Process();
+        Begin = End;
+    }
+    Components.Reset();
+    return NumRegistered;
+}
@@ -0,0 +1,503 @@
+#include "XSPBoundsBVH.h"
+#include "Async/ParallelFor.h"
+#include "Serialization/Archive.h"
+
+namespace
+{
+    const int32 BuildChunkSize = 16384;
+    const uint32 CacheMagic = 0x48564258; // 'XBVH'
+    const int32 CacheVersion = 1;
+
+    //将10位整数的各位间隔两位展开
+    uint32 ExpandBits(uint32 V)
+    {
+        V = (V * 0x00010001u) & 0xFF0000FFu;
+        V = (V * 0x00000101u) & 0x0F00F00Fu;
+        V = (V * 0x00000011u) & 0xC30C30C3u;
+        V = (V * 0x00000005u) & 0x49249249u;
+        return V;
+    }
+
+    uint32 MortonCode(const FVector3f& Position)
+    {
+        uint32 X = (uint32)FMath::Clamp(Position.X, 0.0f, 1023.0f);
+        uint32 Y = (uint32)FMath::Clamp(Position.Y, 0.0f, 1023.0f);
+        uint32 Z = (uint32)FMath::Clamp(Position.Z, 0.0f, 1023.0f);
+        return (ExpandBits(X) << 2) | (ExpandBits(Y) << 1) | ExpandBits(Z);
+    }
+
+    //按高32位(Morton码)做稳定的基数排序,低32位为图元位置
+    void RadixSortByHighWord(TArray<uint64>& Keys)
+    {
+        TArray<uint64> Temp;
+        Temp.SetNumUninitialized(Keys.Num());
+        uint64* Src = Keys.GetData();
+        uint64* Dst = Temp.GetData();
+        for (int32 Pass = 0; Pass < 4; ++Pass)
+        {
+            int32 Shift = 32 + Pass * 8;
+            int32 Offsets[256] = {};
+            for (int32 i = 0; i < Keys.Num(); ++i)
+            {
+                Offsets[(Src[i] >> Shift) & 0xFF]++;
+            }
+            int32 Sum = 0;
+            for (int32 b = 0; b < 256; ++b)
+            {
+                int32 Count = Offsets[b];
+                Offsets[b] = Sum;
+                Sum += Count;
+            }
+            for (int32 i = 0; i < Keys.Num(); ++i)
+            {
+                Dst[Offsets[(Src[i] >> Shift) & 0xFF]++] = Src[i];
+            }
+            Swap(Src, Dst);
+        }
+        //偶数趟后结果回到Keys中
+        check(Src == Keys.GetData());
+    }
+
+    struct FNodeBounds
+    {
+        VectorRegister4Float MinX, MinY, MinZ, MaxX, MaxY, MaxZ;
+    };
+}
+
+void FXSPBoundsBVH::Empty()
+{
+    Nodes.Empty();
+    LevelOffsets.Empty();
+    PrimIndices.Empty();
+    SourceCount = 0;
+}
+
+void FXSPBoundsBVH::Build(TArrayView<const FBox3f> Bounds)
+{
+    Empty();
+    SourceCount = Bounds.Num();
+
+    TArray<int32> ValidIndices;
+    ValidIndices.Reserve(Bounds.Num());
+    for (int32 i = 0; i < Bounds.Num(); ++i)
+    {
+        if (Bounds[i].IsValid)
+        {
+            ValidIndices.Add(i);
+        }
+    }
+    const int32 NumPrims = ValidIndices.Num();
+    if (NumPrims == 0)
+        return;
+
+    //包围盒中心的范围,用于量化Morton码
+    const int32 NumChunks = FMath::DivideAndRoundUp(NumPrims, BuildChunkSize);
+    TArray<FBox3f> ChunkCentroidBounds;
+    ChunkCentroidBounds.Init(FBox3f(ForceInit), NumChunks);
+    ParallelFor(NumChunks, [&](int32 ChunkIndex) {
+        int32 End = FMath::Min(NumPrims, (ChunkIndex + 1) * BuildChunkSize);
+        for (int32 i = ChunkIndex * BuildChunkSize; i < End; ++i)
+        {
+            ChunkCentroidBounds[ChunkIndex] += Bounds[ValidIndices[i]].GetCenter();
+        }
+        });
+    FBox3f CentroidBounds(ForceInit);
+    for (const FBox3f& ChunkBounds : ChunkCentroidBounds)
+    {
+        CentroidBounds += ChunkBounds;
+    }
+    FVector3f CentroidSize = CentroidBounds.GetSize();
+    FVector3f Scale(
+        CentroidSize.X > 0 ? 1023.0f / CentroidSize.X : 0.0f,
+        CentroidSize.Y > 0 ? 1023.0f / CentroidSize.Y : 0.0f,
+        CentroidSize.Z > 0 ? 1023.0f / CentroidSize.Z : 0.0f);
+
+    TArray<uint64> Keys;
+    Keys.SetNumUninitialized(NumPrims);
+    ParallelFor(NumChunks, [&](int32 ChunkIndex) {
+        int32 End = FMath::Min(NumPrims, (ChunkIndex + 1) * BuildChunkSize);
+        for (int32 i = ChunkIndex * BuildChunkSize; i < End; ++i)
+        {
+            uint32 Code = MortonCode((Bounds[ValidIndices[i]].GetCenter() - CentroidBounds.Min) * Scale);
+            Keys[i] = ((uint64)Code << 32) | (uint32)i;
+        }
+        });
+    RadixSortByHighWord(Keys);
+
+    PrimIndices.SetNumUninitialized(NumPrims);
+    ParallelFor(NumChunks, [&](int32 ChunkIndex) {
+        int32 End = FMath::Min(NumPrims, (ChunkIndex + 1) * BuildChunkSize);
+        for (int32 i = ChunkIndex * BuildChunkSize; i < End; ++i)
+        {
+            PrimIndices[i] = ValidIndices[(int32)(Keys[i] & 0xFFFFFFFFu)];
+        }
+        });
+
+    //自底向上逐层构建,每层内并行
+    int32 NumTotalNodes = 0;
+    for (int32 NumLevelNodes = FMath::DivideAndRoundUp(NumPrims, BranchFactor); ; NumLevelNodes = FMath::DivideAndRoundUp(NumLevelNodes, BranchFactor))
+    {
+        LevelOffsets.Add(NumTotalNodes);
+        NumTotalNodes += NumLevelNodes;
+        if (NumLevelNodes == 1)
+            break;
+    }
+    Nodes.SetNumZeroed(NumTotalNodes);
+
+    int32 NumLeafNodes = FMath::DivideAndRoundUp(NumPrims, BranchFactor);
+    ParallelFor(NumLeafNodes, [&](int32 NodeIndex) {
+        FNode& Node = Nodes[NodeIndex];
+        Node.FirstChild = NodeIndex * BranchFactor;
+        Node.NumChildren = FMath::Min(BranchFactor, NumPrims - Node.FirstChild);
+        Node.Level = 0;
+        for (int32 j = 0; j < Node.NumChildren; ++j)
+        {
+            const FBox3f& Box = Bounds[PrimIndices[Node.FirstChild + j]];
+            Node.MinX[j] = Box.Min.X;
+            Node.MinY[j] = Box.Min.Y;
+            Node.MinZ[j] = Box.Min.Z;
+            Node.MaxX[j] = Box.Max.X;
+            Node.MaxY[j] = Box.Max.Y;
+            Node.MaxZ[j] = Box.Max.Z;
+        }
+        });
+
+    for (int32 Level = 1; Level < LevelOffsets.Num(); ++Level)
+    {
+        int32 ChildOffset = LevelOffsets[Level - 1];
+        int32 NumChildNodes = LevelOffsets[Level] - ChildOffset;
+        int32 NumLevelNodes = (Level + 1 < LevelOffsets.Num() ? LevelOffsets[Level + 1] : NumTotalNodes) - LevelOffsets[Level];
+        ParallelFor(NumLevelNodes, [&](int32 LocalIndex) {
+            FNode& Node = Nodes[LevelOffsets[Level] + LocalIndex];
+            Node.FirstChild = ChildOffset + LocalIndex * BranchFactor;
+            Node.NumChildren = FMath::Min(BranchFactor, NumChildNodes - LocalIndex * BranchFactor);
+            Node.Level = Level;
+            for (int32 j = 0; j < Node.NumChildren; ++j)
+            {
+                //子节点的包围盒为其全部子节点包围盒的并集
+                const FNode& Child = Nodes[Node.FirstChild + j];
+                FBox3f ChildBox(ForceInit);
+                for (int32 k = 0; k < Child.NumChildren; ++k)
+                {
+                    ChildBox += FBox3f(FVector3f(Child.MinX[k], Child.MinY[k], Child.MinZ[k]), FVector3f(Child.MaxX[k], Child.MaxY[k], Child.MaxZ[k]));
+                }
+                Node.MinX[j] = ChildBox.Min.X;
+                Node.MinY[j] = ChildBox.Min.Y;
+                Node.MinZ[j] = ChildBox.Min.Z;
+                Node.MaxX[j] = ChildBox.Max.X;
+                Node.MaxY[j] = ChildBox.Max.Y;
+                Node.MaxZ[j] = ChildBox.Max.Z;
+            }
+            }, NumLevelNodes < 64 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+    }
+}
+
+void FXSPBoundsBVH::GetChildPrimRange(const FNode& Node, int32 ChildIndex, int32& OutBegin, int32& OutEnd) const
+{
+    if (Node.Level == 0)
+    {
+        OutBegin = Node.FirstChild + ChildIndex;
+        OutEnd = OutBegin + 1;
+        return;
+    }
+
+    //第L-1层的第c个节点覆盖排序后的图元[c * 4^L, (c + 1) * 4^L)
+    int64 LocalChild = Node.FirstChild + ChildIndex - LevelOffsets[Node.Level - 1];
+    int64 Span = (int64)1 << (2 * Node.Level);
+    OutBegin = (int32)(LocalChild * Span);
+    OutEnd = (int32)FMath::Min<int64>((LocalChild + 1) * Span, PrimIndices.Num());
+}
+
+template<typename TestFuncType>
+void FXSPBoundsBVH::Traverse(TestFuncType&& TestFunc, TArray<int32>& OutIndices) const
+{
+    if (Nodes.Num() == 0)
+        return;
+
+    TArray<int32, TInlineAllocator<64>> Stack;
+    Stack.Push(Nodes.Num() - 1);
+    while (Stack.Num() > 0)
+    {
+        const FNode& Node = Nodes[Stack.Pop(false)];
+        int32 IntersectMask = 0;
+        int32 ContainMask = 0;
+        TestFunc(Node, IntersectMask, ContainMask);
+        IntersectMask &= (1 << Node.NumChildren) - 1;
+        ContainMask &= IntersectMask;
+
+        for (int32 j = 0; j < Node.NumChildren; ++j)
+        {
+            if ((IntersectMask & (1 << j)) == 0)
+                continue;
+
+            if (Node.Level == 0)
+            {
+                OutIndices.Add(PrimIndices[Node.FirstChild + j]);
+            }
+            else if (ContainMask & (1 << j))
+            {
+                //子树完全在查询范围内,直接输出整段图元
+                int32 Begin, End;
+                GetChildPrimRange(Node, j, Begin, End);
+                OutIndices.Append(PrimIndices.GetData() + Begin, End - Begin);
+            }
+            else
+            {
+                Stack.Push(Node.FirstChild + j);
+            }
+        }
+    }
+}
+
+static FORCEINLINE FNodeBounds LoadNodeBounds(const float* MinX, const float* MinY, const float* MinZ, const float* MaxX, const float* MaxY, const float* MaxZ)
+{
+    FNodeBounds Result;
+    Result.MinX = VectorLoadAligned(MinX);
+    Result.MinY = VectorLoadAligned(MinY);
+    Result.MinZ = VectorLoadAligned(MinZ);
+    Result.MaxX = VectorLoadAligned(MaxX);
+    Result.MaxY = VectorLoadAligned(MaxY);
+    Result.MaxZ = VectorLoadAligned(MaxZ);
+    return Result;
+}
+
+#define XSP_LOAD_NODE_BOUNDS(Node) LoadNodeBounds(Node.MinX, Node.MinY, Node.MinZ, Node.MaxX, Node.MaxY, Node.MaxZ)
+
+void FXSPBoundsBVH::QueryConvex(TArrayView<const FPlane> Planes, TArray<int32>& OutIndices) const
+{
+    struct FPlaneSplat
+    {
+        VectorRegister4Float NX, NY, NZ, W, AbsNX, AbsNY, AbsNZ;
+    };
+    TArray<FPlaneSplat, TInlineAllocator<8>> PlaneSplats;
+    for (const FPlane& Plane : Planes)
+    {
+        FPlaneSplat& Splat = PlaneSplats.AddDefaulted_GetRef();
+        Splat.NX = VectorSetFloat1((float)Plane.X);
+        Splat.NY = VectorSetFloat1((float)Plane.Y);
+        Splat.NZ = VectorSetFloat1((float)Plane.Z);
+        Splat.W = VectorSetFloat1((float)Plane.W);
+        Splat.AbsNX = VectorAbs(Splat.NX);
+        Splat.AbsNY = VectorAbs(Splat.NY);
+        Splat.AbsNZ = VectorAbs(Splat.NZ);
+    }
+
+    const VectorRegister4Float Half = VectorSetFloat1(0.5f);
+    Traverse([&](const FNode& Node, int32& OutIntersectMask, int32& OutContainMask) {
+        FNodeBounds B = XSP_LOAD_NODE_BOUNDS(Node);
+        VectorRegister4Float CX = VectorMultiply(VectorAdd(B.MinX, B.MaxX), Half);
+        VectorRegister4Float CY = VectorMultiply(VectorAdd(B.MinY, B.MaxY), Half);
+        VectorRegister4Float CZ = VectorMultiply(VectorAdd(B.MinZ, B.MaxZ), Half);
+        VectorRegister4Float EX = VectorMultiply(VectorSubtract(B.MaxX, B.MinX), Half);
+        VectorRegister4Float EY = VectorMultiply(VectorSubtract(B.MaxY, B.MinY), Half);
+        VectorRegister4Float EZ = VectorMultiply(VectorSubtract(B.MaxZ, B.MinZ), Half);
+
+        //包围盒中心到平面的距离大于包围盒在法线方向的半径时位于平面外侧,小于其相反数时完全位于内侧
+        int32 OutsideMask = 0;
+        int32 InsideMask = 0xF;
+        for (const FPlaneSplat& Splat : PlaneSplats)
+        {
+            VectorRegister4Float Distance = VectorSubtract(VectorMultiplyAdd(Splat.NX, CX, VectorMultiplyAdd(Splat.NY, CY, VectorMultiply(Splat.NZ, CZ))), Splat.W);
+            VectorRegister4Float PushOut = VectorMultiplyAdd(Splat.AbsNX, EX, VectorMultiplyAdd(Splat.AbsNY, EY, VectorMultiply(Splat.AbsNZ, EZ)));
+            OutsideMask |= VectorMaskBits(VectorCompareGT(Distance, PushOut));
+            InsideMask &= VectorMaskBits(VectorCompareLE(Distance, VectorNegate(PushOut)));
+        }
+        OutIntersectMask = ~OutsideMask & 0xF;
+        OutContainMask = InsideMask;
+        }, OutIndices);
+}
+
+void FXSPBoundsBVH::QuerySphere(const FVector3f& Center, float Radius, TArray<int32>& OutIndices) const
+{
+    const VectorRegister4Float SX = VectorSetFloat1(Center.X);
+    const VectorRegister4Float SY = VectorSetFloat1(Center.Y);
+    const VectorRegister4Float SZ = VectorSetFloat1(Center.Z);
+    const VectorRegister4Float RadiusSquared = VectorSetFloat1(Radius * Radius);
+    const VectorRegister4Float Zero = VectorZeroFloat();
+
+    Traverse([&](const FNode& Node, int32& OutIntersectMask, int32& OutContainMask) {
+        FNodeBounds B = XSP_LOAD_NODE_BOUNDS(Node);
+
+        //球心到包围盒的最近距离
+        VectorRegister4Float DX = VectorMax(VectorMax(VectorSubtract(B.MinX, SX), VectorSubtract(SX, B.MaxX)), Zero);
+        VectorRegister4Float DY = VectorMax(VectorMax(VectorSubtract(B.MinY, SY), VectorSubtract(SY, B.MaxY)), Zero);
+        VectorRegister4Float DZ = VectorMax(VectorMax(VectorSubtract(B.MinZ, SZ), VectorSubtract(SZ, B.MaxZ)), Zero);
+        VectorRegister4Float NearSquared = VectorMultiplyAdd(DX, DX, VectorMultiplyAdd(DY, DY, VectorMultiply(DZ, DZ)));
+
+        //球心到包围盒的最远距离
+        VectorRegister4Float FX = VectorMax(VectorAbs(VectorSubtract(SX, B.MinX)), VectorAbs(VectorSubtract(SX, B.MaxX)));
+        VectorRegister4Float FY = VectorMax(VectorAbs(VectorSubtract(SY, B.MinY)), VectorAbs(VectorSubtract(SY, B.MaxY)));
+        VectorRegister4Float FZ = VectorMax(VectorAbs(VectorSubtract(SZ, B.MinZ)), VectorAbs(VectorSubtract(SZ, B.MaxZ)));
+        VectorRegister4Float FarSquared = VectorMultiplyAdd(FX, FX, VectorMultiplyAdd(FY, FY, VectorMultiply(FZ, FZ)));
+
+        OutIntersectMask = VectorMaskBits(VectorCompareLE(NearSquared, RadiusSquared));
+        OutContainMask = VectorMaskBits(VectorCompareLE(FarSquared, RadiusSquared));
+        }, OutIndices);
+}
+
+void FXSPBoundsBVH::QueryBox(const FBox3f& Box, TArray<int32>& OutIndices) const
+{
+    const VectorRegister4Float QMinX = VectorSetFloat1(Box.Min.X);
+    const VectorRegister4Float QMinY = VectorSetFloat1(Box.Min.Y);
+    const VectorRegister4Float QMinZ = VectorSetFloat1(Box.Min.Z);
+    const VectorRegister4Float QMaxX = VectorSetFloat1(Box.Max.X);
+    const VectorRegister4Float QMaxY = VectorSetFloat1(Box.Max.Y);
+    const VectorRegister4Float QMaxZ = VectorSetFloat1(Box.Max.Z);
+
+    Traverse([&](const FNode& Node, int32& OutIntersectMask, int32& OutContainMask) {
+        FNodeBounds B = XSP_LOAD_NODE_BOUNDS(Node);
+        OutIntersectMask =
+            VectorMaskBits(VectorCompareLE(B.MinX, QMaxX)) & VectorMaskBits(VectorCompareGE(B.MaxX, QMinX)) &
+            VectorMaskBits(VectorCompareLE(B.MinY, QMaxY)) & VectorMaskBits(VectorCompareGE(B.MaxY, QMinY)) &
+            VectorMaskBits(VectorCompareLE(B.MinZ, QMaxZ)) & VectorMaskBits(VectorCompareGE(B.MaxZ, QMinZ));
+        OutContainMask =
+            VectorMaskBits(VectorCompareGE(B.MinX, QMinX)) & VectorMaskBits(VectorCompareLE(B.MaxX, QMaxX)) &
+            VectorMaskBits(VectorCompareGE(B.MinY, QMinY)) & VectorMaskBits(VectorCompareLE(B.MaxY, QMaxY)) &
+            VectorMaskBits(VectorCompareGE(B.MinZ, QMinZ)) & VectorMaskBits(VectorCompareLE(B.MaxZ, QMaxZ));
+        }, OutIndices);
+}
+
+void FXSPBoundsBVH::QueryRay(const FVector3f& Origin, const FVector3f& Direction, float MaxDistance, TArray<FXSPBVHRayHit>& OutHits) const
+{
+    if (Nodes.Num() == 0)
+        return;
+
+    //方向分量为0时用同号的极大值代替倒数,避免产生NaN
+    auto SafeInverse = [](float V) { return FMath::Abs(V) > SMALL_NUMBER ? 1.0f / V : (V < 0 ? -1e30f : 1e30f); };
+    FVector3f Dir = Direction.GetSafeNormal();
+    const VectorRegister4Float OX = VectorSetFloat1(Origin.X);
+    const VectorRegister4Float OY = VectorSetFloat1(Origin.Y);
+    const VectorRegister4Float OZ = VectorSetFloat1(Origin.Z);
+    const VectorRegister4Float InvDX = VectorSetFloat1(SafeInverse(Dir.X));
+    const VectorRegister4Float InvDY = VectorSetFloat1(SafeInverse(Dir.Y));
+    const VectorRegister4Float InvDZ = VectorSetFloat1(SafeInverse(Dir.Z));
+    const VectorRegister4Float Zero = VectorZeroFloat();
+    const VectorRegister4Float MaxT = VectorSetFloat1(MaxDistance);
+
+    TArray<int32, TInlineAllocator<64>> Stack;
+    Stack.Push(Nodes.Num() - 1);
+    alignas(16) float EntryDistances[BranchFactor];
+    while (Stack.Num() > 0)
+    {
+        const FNode& Node = Nodes[Stack.Pop(false)];
+        FNodeBounds B = XSP_LOAD_NODE_BOUNDS(Node);
+
+        //slab法求射线与包围盒的进入和离开距离
+        VectorRegister4Float T1X = VectorMultiply(VectorSubtract(B.MinX, OX), InvDX);
+        VectorRegister4Float T2X = VectorMultiply(VectorSubtract(B.MaxX, OX), InvDX);
+        VectorRegister4Float T1Y = VectorMultiply(VectorSubtract(B.MinY, OY), InvDY);
+        VectorRegister4Float T2Y = VectorMultiply(VectorSubtract(B.MaxY, OY), InvDY);
+        VectorRegister4Float T1Z = VectorMultiply(VectorSubtract(B.MinZ, OZ), InvDZ);
+        VectorRegister4Float T2Z = VectorMultiply(VectorSubtract(B.MaxZ, OZ), InvDZ);
+        VectorRegister4Float TEnter = VectorMax(VectorMax(VectorMin(T1X, T2X), VectorMin(T1Y, T2Y)), VectorMax(VectorMin(T1Z, T2Z), Zero));
+        VectorRegister4Float TExit = VectorMin(VectorMin(VectorMax(T1X, T2X), VectorMax(T1Y, T2Y)), VectorMin(VectorMax(T1Z, T2Z), MaxT));
+        int32 HitMask = VectorMaskBits(VectorCompareLE(TEnter, TExit)) & ((1 << Node.NumChildren) - 1);
+        if (HitMask == 0)
+            continue;
+
+        VectorStoreAligned(TEnter, EntryDistances);
+        for (int32 j = 0; j < Node.NumChildren; ++j)
+        {
+            if ((HitMask & (1 << j)) == 0)
+                continue;
+
+            if (Node.Level == 0)
+            {
+                OutHits.Add({ PrimIndices[Node.FirstChild + j], EntryDistances[j] });
+            }
+            else
+            {
+                Stack.Push(Node.FirstChild + j);
+            }
+        }
+    }
+
+    OutHits.Sort([](const FXSPBVHRayHit& Lhs, const FXSPBVHRayHit& Rhs) { return Lhs.Distance < Rhs.Distance; });
+}
+
+#undef XSP_LOAD_NODE_BOUNDS
+
+bool FXSPBoundsBVH::Serialize(FArchive& Ar)
+{
+    uint32 Magic = CacheMagic;
+    int32 Version = CacheVersion;
+    Ar << Magic;
+    Ar << Version;
+    if (Ar.IsLoading() && (Magic != CacheMagic || Version != CacheVersion))
+    {
+        Empty();
+        return false;
+    }
+
+    Ar << SourceCount;
+    Ar << LevelOffsets;
+    Ar << PrimIndices;
+
+    int32 NumSerializedNodes = Nodes.Num();
+    Ar << NumSerializedNodes;
+    if (Ar.IsLoading())
+    {
+        if (NumSerializedNodes < 0 || Ar.IsError())
+        {
+            Empty();
+            return false;
+        }
+        Nodes.SetNumUninitialized(NumSerializedNodes);
+    }
+    Ar.Serialize(Nodes.GetData(), (int64)Nodes.Num() * sizeof(FNode));
+
+    //读入的数据需要与构建的结果结构一致,否则视为无效缓存,避免截断或损坏的文件使查询越界
+    if (Ar.IsLoading() && (Ar.IsError() || !IsConsistent()))
+    {
+        Empty();
+        return false;
+    }
+    return !Ar.IsError();
+}
+
+bool FXSPBoundsBVH::IsConsistent() const
+{
+    const int32 NumPrims = PrimIndices.Num();
+    if (SourceCount < NumPrims)
+        return false;
+    if (Nodes.Num() == 0 || NumPrims == 0)
+        return Nodes.Num() == 0 && NumPrims == 0 && LevelOffsets.Num() == 0;
+
+    for (int32 PrimIndex : PrimIndices)
+    {
+        if (PrimIndex < 0 || PrimIndex >= SourceCount)
+            return false;
+    }
+
+    //每层的节点数与Build中的计算一致:第0层为图元数/4,之后每层为下一层节点数/4,最后一层只有根节点
+    int32 ExpectedOffset = 0;
+    int32 NumLevelNodes = FMath::DivideAndRoundUp(NumPrims, BranchFactor);
+    for (int32 Level = 0; Level < LevelOffsets.Num(); ++Level)
+    {
+        if (LevelOffsets[Level] != ExpectedOffset)
+            return false;
+        const bool bLastLevel = Level + 1 == LevelOffsets.Num();
+        if (bLastLevel != (NumLevelNodes == 1))
+            return false;
+        ExpectedOffset += NumLevelNodes;
+        NumLevelNodes = FMath::DivideAndRoundUp(NumLevelNodes, BranchFactor);
+    }
+    if (ExpectedOffset != Nodes.Num())
+        return false;
+
+    //子节点区间必须位于下一层(第0层为图元数组)之内
+    for (int32 Level = 0; Level < LevelOffsets.Num(); ++Level)
+    {
+        const int32 ChildBegin = Level == 0 ? 0 : LevelOffsets[Level - 1];
+        const int32 ChildEnd = Level == 0 ? NumPrims : LevelOffsets[Level];
+        const int32 LevelEnd = Level + 1 < LevelOffsets.Num() ? LevelOffsets[Level + 1] : Nodes.Num();
+        for (int32 NodeIndex = LevelOffsets[Level]; NodeIndex < LevelEnd; ++NodeIndex)
+        {
+            const FNode& Node = Nodes[NodeIndex];
+            if (Node.Level != Level || Node.NumChildren < 1 || Node.NumChildren > BranchFactor
+                || Node.FirstChild < ChildBegin || Node.FirstChild > ChildEnd - Node.NumChildren)
+                return false;
+        }
+    }
+    return true;
+}
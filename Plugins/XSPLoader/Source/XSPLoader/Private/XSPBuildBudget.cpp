@@ -0,0 +1,124 @@
+#include "XSPBuildBudget.h"
+#include "HAL/Event.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/ScopeLock.h"
+
+static int32 GXSPMaxInFlightBuilds = 16;
+FAutoConsoleVariableRef CVarXSPMaxInFlightBuilds(
+    TEXT("r.XSP.MaxInFlightBuilds"),
+    GXSPMaxInFlightBuilds,
+    TEXT("Max number of static mesh build tasks in flight.\n")
+    TEXT(" 16: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPMaxInFlightTriangles = 2000000;
+FAutoConsoleVariableRef CVarXSPMaxInFlightTriangles(
+    TEXT("r.XSP.MaxInFlightTriangles"),
+    GXSPMaxInFlightTriangles,
+    TEXT("Max estimated triangles of static mesh build tasks in flight.\n")
+    TEXT(" 2000000: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPMaxInFlightMB = 512;
+FAutoConsoleVariableRef CVarXSPMaxInFlightMB(
+    TEXT("r.XSP.MaxInFlightMB"),
+    GXSPMaxInFlightMB,
+    TEXT("Max estimated memory (MB) of static mesh build tasks in flight.\n")
+    TEXT(" 512: default\n"),
+    ECVF_Default
+);
+
+FXSPBuildBudget::FXSPBuildBudget()
+    : Limits(GetLimitsFromConsoleVariables())
+    , ReleasedEvent(FPlatformProcess::GetSynchEventFromPool(true))
+{
+}
+
+FXSPBuildBudget::~FXSPBuildBudget()
+{
+    FPlatformProcess::ReturnSynchEventToPool(ReleasedEvent);
+    ReleasedEvent = nullptr;
+}
+
+FXSPBuildBudget::FLimits FXSPBuildBudget::GetLimitsFromConsoleVariables()
+{
+    FLimits Result;
+    Result.MaxInFlight = FMath::Max(1, GXSPMaxInFlightBuilds);
+    Result.MaxTriangles = FMath::Max(1, GXSPMaxInFlightTriangles);
+    Result.MaxBytes = (int64)FMath::Max(1, GXSPMaxInFlightMB) * 1024 * 1024;
+    return Result;
+}
+
+void FXSPBuildBudget::SetLimits(const FLimits& InLimits)
+{
+    {
+        FScopeLock Lock(&CS);
+        if (Limits.MaxInFlight == InLimits.MaxInFlight && Limits.MaxTriangles == InLimits.MaxTriangles && Limits.MaxBytes == InLimits.MaxBytes)
+            return;
+        Limits = InLimits;
+    }
+    //上限可能被放宽
+    WakeWaiters();
+}
+
+bool FXSPBuildBudget::TryAcquire(const FXSPBuildCost& Cost)
+{
+    FScopeLock Lock(&CS);
+    return TryAcquireNoLock(Cost);
+}
+
+bool FXSPBuildBudget::TryAcquireNoLock(const FXSPBuildCost& Cost)
+{
+    if (NumInFlight > 0)
+    {
+        if (NumInFlight + 1 > Limits.MaxInFlight)
+            return false;
+        if (NumTrianglesInFlight + Cost.NumTriangles > Limits.MaxTriangles)
+            return false;
+        if (NumBytesInFlight + Cost.NumBytes > Limits.MaxBytes)
+            return false;
+    }
+
+    NumInFlight += 1;
+    NumTrianglesInFlight += Cost.NumTriangles;
+    NumBytesInFlight += Cost.NumBytes;
+    return true;
+}
+
+bool FXSPBuildBudget::Acquire(const FXSPBuildCost& Cost, TFunctionRef<bool()> ShouldAbort)
+{
+    while (true)
+    {
+        {
+            FScopeLock Lock(&CS);
+            if (TryAcquireNoLock(Cost))
+                return true;
+            //准入失败时才在锁内复位,之后的归还必定在复位之后触发,不会丢失唤醒
+            ReleasedEvent->Reset();
+        }
+        if (ShouldAbort())
+            return false;
+        //请求过期等放弃条件的变化不会触发事件,等待设有上限,到时重新检查
+        ReleasedEvent->Wait(AbortCheckIntervalMs);
+    }
+}
+
+void FXSPBuildBudget::Release(const FXSPBuildCost& Cost)
+{
+    {
+        FScopeLock Lock(&CS);
+        check(NumInFlight > 0);
+        NumInFlight -= 1;
+        NumTrianglesInFlight -= Cost.NumTriangles;
+        NumBytesInFlight -= Cost.NumBytes;
+    }
+    ReleasedEvent->Trigger();
+}
+
+void FXSPBuildBudget::WakeWaiters()
+{
+    ReleasedEvent->Trigger();
+}
@@ -0,0 +1,72 @@
+#include "XSPComponentPool.h"
+#include "GameFramework/Actor.h"
+#include "Components/StaticMeshComponent.h"
+
+void FXSPComponentPool::Init(AActor* InOwner)
+{
+    if (Owner.Get() == InOwner)
+        return;
+
+    Reset();
+    Owner = InOwner;
+}
+
+void FXSPComponentPool::Reset()
+{
+    //组件由Owner持有,随Owner一起销毁
+    Owner.Reset();
+    Components.Empty();
+    FreeComponents.Empty();
+    NumCreated = 0;
+}
+
+UStaticMeshComponent* FXSPComponentPool::Acquire()
+{
+    check(IsInGameThread());
+    AActor* OwnerActor = Owner.Get();
+    if (nullptr == OwnerActor)
+        return nullptr;
+
+    while (FreeComponents.Num() > 0)
+    {
+        UStaticMeshComponent* Component = FreeComponents.Pop(false);
+        if (IsValid(Component))
+        {
+            Component->SetVisibility(true);
+            return Component;
+        }
+    }
+
+    //名称只用于调试,由引擎保证唯一
+    UStaticMeshComponent* Component = NewObject<UStaticMeshComponent>(OwnerActor, MakeUniqueObjectName(OwnerActor, UStaticMeshComponent::StaticClass(), TEXT("XSPMesh")));
+    Component->SetMobility(EComponentMobility::Movable);
+    if (USceneComponent* RootComponent = OwnerActor->GetRootComponent())
+    {
+        //组件尚未注册,只记录挂接关系,注册时才真正挂接
+        Component->SetupAttachment(RootComponent);
+    }
+    Components.Add(Component);
+    NumCreated++;
+    return Component;
+}
+
+void FXSPComponentPool::Release(UStaticMeshComponent* Component)
+{
+    check(IsInGameThread());
+    if (nullptr == Component)
+        return;
+
+    //先注销再清空,避免清空网格体时重建渲染状态;复用时与新建的组件一样批量注册
+    if (Component->IsRegistered())
+    {
+        Component->UnregisterComponent();
+    }
+    Component->SetStaticMesh(nullptr);
+    Component->SetMaterial(0, nullptr);
+    FreeComponents.Add(Component);
+}
+
+void FXSPComponentPool::AddReferencedObjects(FReferenceCollector& Collector)
+{
+    Collector.AddReferencedObjects(Components);
+}
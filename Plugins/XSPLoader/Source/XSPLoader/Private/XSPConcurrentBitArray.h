@@ -0,0 +1,88 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/UniquePtr.h"
+#include <atomic>
+
+/**
+ * 定长的并发位数组
+ * 长度在Init时确定,之后Set/Test均为无锁的O(1)操作,可由任意线程同时访问
+ * Init/Empty/Serialize不是线程安全的,只能在没有其他线程访问时调用
+ */
+class FXSPConcurrentBitArray
+{
+public:
+	void Init(int32 InNumBits)
+	{
+		check(InNumBits >= 0);
+		NumBits = InNumBits;
+		NumWords = FMath::DivideAndRoundUp(InNumBits, 64);
+		Words = MakeUnique<std::atomic<uint64>[]>(NumWords);
+		for (int32 i = 0; i < NumWords; ++i)
+		{
+			Words[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void Empty()
+	{
+		Words.Reset();
+		NumBits = 0;
+		NumWords = 0;
+	}
+
+	int32 Num() const { return NumBits; }
+
+	//越界的索引视为未置位
+	bool Test(int32 Index) const
+	{
+		if (Index < 0 || Index >= NumBits)
+			return false;
+		return (Words[Index >> 6].load(std::memory_order_relaxed) & (1ull << (Index & 63))) != 0;
+	}
+
+	//置位,返回该位之前是否已被置位
+	bool Set(int32 Index)
+	{
+		check(Index >= 0 && Index < NumBits);
+		const uint64 Mask = 1ull << (Index & 63);
+		return (Words[Index >> 6].fetch_or(Mask) & Mask) != 0;
+	}
+
+	int32 CountSetBits() const
+	{
+		int32 Count = 0;
+		for (int32 i = 0; i < NumWords; ++i)
+		{
+			Count += FMath::CountBits(Words[i].load(std::memory_order_relaxed));
+		}
+		return Count;
+	}
+
+	//按64位字序列化,读取时长度必须与当前长度一致
+	bool Serialize(FArchive& Ar)
+	{
+		int32 SerializedNumBits = NumBits;
+		Ar << SerializedNumBits;
+		if (Ar.IsLoading() && SerializedNumBits != NumBits)
+			return false;
+
+		for (int32 i = 0; i < NumWords; ++i)
+		{
+			uint64 Word = Words[i].load(std::memory_order_relaxed);
+			Ar << Word;
+			if (Ar.IsLoading())
+			{
+				Words[i].store(Word, std::memory_order_relaxed);
+			}
+		}
+		return !Ar.IsError();
+	}
+
+private:
+	TUniquePtr<std::atomic<uint64>[]> Words;
+	int32 NumBits = 0;
+	int32 NumWords = 0;
+};
@@ -3,9 +3,222 @@
 #include "MeshDescriptionBuilder.h"
 #include "StaticMeshAttributes.h"
 #include "Math/UnrealMathUtility.h"
+#include "Async/ParallelFor.h"
+#include "Stats/Stats.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Paths.h"
+#include "Misc/QueuedThreadPool.h"
+#include "Misc/SecureHash.h"
+#include "Serialization/Archive.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogXSPLoader, Log, All);
 
+DECLARE_STATS_GROUP(TEXT("XSPLoader"), STATGROUP_XSPLoader, STATCAT_Advanced);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dequeued Requests"), STAT_XSPNumDequeued, STATGROUP_XSPLoader);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Avg Queue Wait (ms)"), STAT_XSPAvgQueueWait, STATGROUP_XSPLoader);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Max Queue Wait (ms)"), STAT_XSPMaxQueueWait, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Released Requests"), STAT_XSPNumReleased, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Live Requests"), STAT_XSPNumLiveRequests, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("In-flight Builds"), STAT_XSPNumInFlightBuilds, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("In-flight Build Triangles"), STAT_XSPNumInFlightTriangles, STATGROUP_XSPLoader);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("In-flight Build Memory (MB)"), STAT_XSPInFlightBuildMB, STATGROUP_XSPLoader);
+DECLARE_CYCLE_STAT(TEXT("Submit Requests"), STAT_XSPSubmitRequests, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Submitted Requests"), STAT_XSPNumSubmitted, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("New Requests"), STAT_XSPNumNewRequests, STATGROUP_XSPLoader);
+DECLARE_CYCLE_STAT(TEXT("Dispatch New Requests"), STAT_XSPDispatchNewRequests, STATGROUP_XSPLoader);
+DECLARE_CYCLE_STAT(TEXT("Merge Create Material"), STAT_XSPMergeCreateMaterial, STATGROUP_XSPLoader);
+DECLARE_CYCLE_STAT(TEXT("Merge SetStaticMesh"), STAT_XSPMergeSetStaticMesh, STATGROUP_XSPLoader);
+DECLARE_CYCLE_STAT(TEXT("Merge RegisterComponent"), STAT_XSPMergeRegisterComponent, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Merges This Frame"), STAT_XSPNumMerged, STATGROUP_XSPLoader);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Merge Budget (ms)"), STAT_XSPMergeBudget, STATGROUP_XSPLoader);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Avg Merge Cost (ms)"), STAT_XSPAvgMergeCost, STATGROUP_XSPLoader);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Merge Frame Impact p50 (ms)"), STAT_XSPMergeImpactP50, STATGROUP_XSPLoader);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Merge Frame Impact p99 (ms)"), STAT_XSPMergeImpactP99, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Load Threads"), STAT_XSPNumLoadThreads, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Stolen Requests"), STAT_XSPNumStolen, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Build Threads"), STAT_XSPNumBuildThreads, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Build Queue Depth"), STAT_XSPBuildQueueDepth, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Busy Build Threads"), STAT_XSPNumBusyBuildThreads, STATGROUP_XSPLoader);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Build Pool Utilization (%)"), STAT_XSPBuildPoolUtilization, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Completed Requests"), STAT_XSPNumCompleted, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Completed Triangles"), STAT_XSPNumCompletedTriangles, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Dropped Requests (Queue Full)"), STAT_XSPNumDropped, STATGROUP_XSPLoader);
+DECLARE_CYCLE_STAT(TEXT("Evict Meshes"), STAT_XSPEvictMeshes, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Resident Meshes"), STAT_XSPNumResident, STATGROUP_XSPLoader);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Resident Memory (MB)"), STAT_XSPResidentMB, STATGROUP_XSPLoader);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Memory Budget (MB)"), STAT_XSPMemoryBudgetMB, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Evicted Meshes"), STAT_XSPNumEvicted, STATGROUP_XSPLoader);
+DECLARE_CYCLE_STAT(TEXT("Acquire Component"), STAT_XSPAcquireComponent, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pooled Components (In Use)"), STAT_XSPNumPooledInUse, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pooled Components (Free)"), STAT_XSPNumPooledFree, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pooled Meshes (Free)"), STAT_XSPNumPooledMeshesFree, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pooled Meshes (Releasing)"), STAT_XSPNumPooledMeshesReleasing, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pooled Meshes (Created)"), STAT_XSPNumPooledMeshesCreated, STATGROUP_XSPLoader);
+DECLARE_CYCLE_STAT(TEXT("Tick Mesh Pool"), STAT_XSPTickMeshPool, STATGROUP_XSPLoader);
+DECLARE_CYCLE_STAT(TEXT("Pick"), STAT_XSPPick, STATGROUP_XSPLoader);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pick Meshes"), STAT_XSPNumPickMeshes, STATGROUP_XSPLoader);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Pick Cache (MB)"), STAT_XSPPickCacheMB, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cancelled Requests (Load)"), STAT_XSPNumCancelledLoad, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cancelled Requests (Build)"), STAT_XSPNumCancelledBuild, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cancelled Requests (Merge)"), STAT_XSPNumCancelledMerge, STATGROUP_XSPLoader);
+
+static int32 GXSPPersistBlacklist = 0;
+FAutoConsoleVariableRef CVarXSPPersistBlacklist(
+    TEXT("r.XSP.PersistBlacklist"),
+    GXSPPersistBlacklist,
+    TEXT("Persist the blacklist of empty nodes to Saved/XSPLoader so later sessions skip them.\n")
+    TEXT(" 0: off(default)\n"),
+    ECVF_Default
+);
+
+static int32 GXSPCacheBVH = 1;
+FAutoConsoleVariableRef CVarXSPCacheBVH(
+    TEXT("r.XSP.CacheBVH"),
+    GXSPCacheBVH,
+    TEXT("Cache the bounding volume hierarchy of node bounds in Saved/XSPLoader so later sessions skip the build.\n")
+    TEXT(" 1: on(default)\n"),
+    ECVF_Default
+);
+
+static int32 GXSPHLODMinDescendants = 16;
+FAutoConsoleVariableRef CVarXSPHLODMinDescendants(
+    TEXT("r.XSP.HLODMinDescendants"),
+    GXSPHLODMinDescendants,
+    TEXT("Nodes with at least this many descendants get an HLOD proxy of their subtree, takes effect on Init.\n")
+    TEXT(" 16: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPHLODMaxDescendants = 4096;
+FAutoConsoleVariableRef CVarXSPHLODMaxDescendants(
+    TEXT("r.XSP.HLODMaxDescendants"),
+    GXSPHLODMaxDescendants,
+    TEXT("Nodes with more descendants than this get no HLOD proxy, bounds the cost of building one, takes effect on Init.\n")
+    TEXT(" 4096: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPHLODResolution = 64;
+FAutoConsoleVariableRef CVarXSPHLODResolution(
+    TEXT("r.XSP.HLODResolution"),
+    GXSPHLODResolution,
+    TEXT("HLOD proxies are simplified by clustering vertices in a grid of this many cells along the longest side of the subtree bounds, takes effect on Init.\n")
+    TEXT(" 64: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPCacheHLOD = 1;
+FAutoConsoleVariableRef CVarXSPCacheHLOD(
+    TEXT("r.XSP.CacheHLOD"),
+    GXSPCacheHLOD,
+    TEXT("Cache simplified HLOD proxies in Saved/XSPLoader so each proxy is built only once.\n")
+    TEXT(" 1: on(default)\n"),
+    ECVF_Default
+);
+
+static int32 GXSPBatchMerge = 1;
+FAutoConsoleVariableRef CVarXSPBatchMerge(
+    TEXT("r.XSP.BatchMerge"),
+    GXSPBatchMerge,
+    TEXT("Register the components merged in a frame together after all of them are set up, so their render states are created in one pass.\n")
+    TEXT(" 1: on(default)\n"),
+    ECVF_Default
+);
+
+static int32 GXSPMeshPoolSize = 0;
+FAutoConsoleVariableRef CVarXSPMeshPoolSize(
+    TEXT("r.XSP.MeshPoolSize"),
+    GXSPMeshPoolSize,
+    TEXT("Number of free static mesh objects kept ready for new builds, 0 uses twice r.XSP.MaxInFlightBuilds.\n")
+    TEXT(" 0: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPMeshPoolRefillPerFrame = 8;
+FAutoConsoleVariableRef CVarXSPMeshPoolRefillPerFrame(
+    TEXT("r.XSP.MeshPoolRefillPerFrame"),
+    GXSPMeshPoolRefillPerFrame,
+    TEXT("Maximum number of static mesh objects created per frame to refill the pool.\n")
+    TEXT(" 8: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPPickCacheMB = 256;
+FAutoConsoleVariableRef CVarXSPPickCacheMB(
+    TEXT("r.XSP.PickCacheMB"),
+    GXSPPickCacheMB,
+    TEXT("Memory budget (MB) of the per-node triangle BVHs built for ray picking, the least recently picked are dropped beyond it.\n")
+    TEXT(" 256: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPParentBodyCacheMB = 256;
+FAutoConsoleVariableRef CVarXSPParentBodyCacheMB(
+    TEXT("r.XSP.ParentBodyCacheMB"),
+    GXSPParentBodyCacheMB,
+    TEXT("Memory budget (MB) of the parent node data kept for material inheritance, the least recently used are dropped beyond it.\n")
+    TEXT(" 256: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPPickMaxBuildsPerQuery = 8;
+FAutoConsoleVariableRef CVarXSPPickMaxBuildsPerQuery(
+    TEXT("r.XSP.PickMaxBuildsPerQuery"),
+    GXSPPickMaxBuildsPerQuery,
+    TEXT("Maximum number of node triangle BVH builds a single pick issues for the nearest nodes along the ray that are not cached yet.\n")
+    TEXT(" 8: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPPickRetryFrames = 30;
+FAutoConsoleVariableRef CVarXSPPickRetryFrames(
+    TEXT("r.XSP.PickRetryFrames"),
+    GXSPPickRetryFrames,
+    TEXT("Frames to wait before rebuilding a node triangle BVH whose source read failed, doubling with each further failure up to 64 times as long.\n")
+    TEXT(" 30: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPLoadThreads = 0;
+FAutoConsoleVariableRef CVarXSPLoadThreads(
+    TEXT("r.XSP.LoadThreads"),
+    GXSPLoadThreads,
+    TEXT("Number of load worker threads shared by all source files, takes effect on the next Init.\n")
+    TEXT(" 0: half of the cores, clamped to [1, 8](default)\n"),
+    ECVF_Default
+);
+
+static int32 GXSPBuildThreads = 0;
+FAutoConsoleVariableRef CVarXSPBuildThreads(
+    TEXT("r.XSP.BuildThreads"),
+    GXSPBuildThreads,
+    TEXT("Number of threads in the static mesh build thread pool, takes effect on the next Init.\n")
+    TEXT(" 0: half of the engine worker threads, at least 1(default)\n"),
+    ECVF_Default
+);
+
+static int32 GXSPBuildThreadPriority = TPri_SlightlyBelowNormal;
+FAutoConsoleVariableRef CVarXSPBuildThreadPriority(
+    TEXT("r.XSP.BuildThreadPriority"),
+    GXSPBuildThreadPriority,
+    TEXT("EThreadPriority of the static mesh build threads, takes effect on the next Init.\n")
+    TEXT(" 0: normal\n")
+    TEXT(" 2: below normal\n")
+    TEXT(" 4: lowest\n")
+    TEXT(" 5: slightly below normal(default)\n"),
+    ECVF_Default
+);
+
+static int32 GXSPBuildThreadStackSize = 256;
+FAutoConsoleVariableRef CVarXSPBuildThreadStackSize(
+    TEXT("r.XSP.BuildThreadStackSize"),
+    GXSPBuildThreadStackSize,
+    TEXT("Stack size (KB) of the static mesh build threads, takes effect on the next Init.\n")
+    TEXT(" 256: default\n"),
+    ECVF_Default
+);
+
 namespace
 {
     void read_header_info(std::fstream& file, Header_info& info)
@@ -31,7 +244,55 @@ namespace
         }
     }
 
-    void read_body_info(std::fstream& file, const Header_info& header, bool is_fragment, Body_info& body)
+    //读取全部节点的包围盒,并转换到引擎坐标系(与网格体顶点一致:交换xy,米转厘米)
+    void read_node_bounds(std::fstream& file, const TArray<Header_info>& header_list, TArray<FBox3f>& bounds_list)
+    {
+        int32 NumNodes = header_list.Num();
+        bounds_list.SetNumUninitialized(NumNodes);
+        for (int32 i = 0; i < NumNodes; i++)
+        {
+            float box[6];
+            file.seekg(header_list[i].startbox, std::ios::beg);
+            file.read((char*)box, sizeof(box));
+            bounds_list[i] = FBox3f(FVector3f(box[1], box[0], box[2]) * 100, FVector3f(box[4], box[3], box[5]) * 100);
+        }
+    }
+
+    //按fragment头信息预估全部节点的三角形数:Mesh的vertices每9个float一个三角形,其余类型参数很少,按细分后最多的36个计,预估不小于实际构建的三角形数
+    void read_node_triangle_estimates(std::fstream& file, const TArray<Header_info>& header_list, TArray<int32>& num_triangles_list)
+    {
+        int32 NumNodes = header_list.Num();
+        num_triangles_list.SetNumUninitialized(NumNodes);
+        TArray<Header_info> fragment_headerList;
+        for (int32 i = 0; i < NumNodes; i++)
+        {
+            int64 NumTriangles = 0;
+            if (header_list[i].verticeslength > 0)
+            {
+                file.seekg(header_list[i].startvertices, std::ios::beg);
+                read_header_info(file, header_list[i].verticeslength / 50, fragment_headerList);
+                for (const Header_info& fragment_header : fragment_headerList)
+                {
+                    NumTriangles += FMath::Max(fragment_header.verticeslength / 36, 36);
+                }
+            }
+            num_triangles_list[i] = (int32)FMath::Min<int64>(NumTriangles, MAX_int32);
+        }
+    }
+
+    //源文件路径/大小/修改时间共同决定的摘要,任何源文件变化都会使以此命名的缓存文件失效
+    FString compute_source_hash(const TArray<FString>& file_path_name_array)
+    {
+        FString SourceSignature;
+        for (const FString& FilePathName : file_path_name_array)
+        {
+            SourceSignature += FString::Printf(TEXT("%s|%lld|%s;"), *FPaths::ConvertRelativePathToFull(FilePathName), IFileManager::Get().FileSize(*FilePathName), *IFileManager::Get().GetTimeStamp(*FilePathName).ToString());
+        }
+        return FMD5::HashAnsiString(*SourceSignature);
+    }
+
+    //读取节点数据,在各fragment之间检查取消令牌,被取消时返回false(此时body数据不完整)
+    bool read_body_info(std::fstream& file, const Header_info& header, bool is_fragment, Body_info& body, const FXSPCancellationToken* cancellation_token = nullptr)
     {
         body.parentdbid = header.parentdbid;
         body.level = header.level;
@@ -77,10 +338,13 @@ namespace
                 int num_fragments = fragment_headerList.Num();
                 body.fragment.SetNum(num_fragments);
                 for (int k = 0; k < num_fragments; k++) {
+                    if (cancellation_token && cancellation_token->IsCancelled())
+                        return false;
                     read_body_info(file, fragment_headerList[k], true, body.fragment[k]);
                 }
             }
         }
+        return true;
     }
 
     void ComputeNormal(const TArray<FVector>& VertexList, TArray<FVector>& NormalList)
@@ -254,10 +518,14 @@ namespace
         NormalList.Append(CylinderMeshNormals);
     }
 
-    void AppendNodeMesh(const Body_info& Node, TArray<FVector>& VertexList, TArray<FVector>& NormalList)
+    //细分节点的全部fragment,在各fragment之间检查取消令牌,被取消时返回false
+    bool AppendNodeMesh(const Body_info& Node, TArray<FVector>& VertexList, TArray<FVector>& NormalList, const FXSPCancellationToken* CancellationToken = nullptr)
     {
         for (int32 i = 0, i_len = Node.fragment.Num(); i < i_len; i++)
         {
+            if (CancellationToken && CancellationToken->IsCancelled())
+                return false;
+
             if (Node.fragment[i].name == "Mesh")
             {
                 AppendRawMesh(Node.fragment[i].vertices, VertexList, NormalList);
@@ -271,14 +539,14 @@ namespace
                 AppendCylinderMesh(Node.fragment[i].vertices, VertexList, NormalList);
             }
         }
+        return true;
     }
 
-    void BuildStaticMesh(UStaticMesh* StaticMesh, const TArray<FVector>& VertexList, const TArray<FVector>& NormalList)
+    //构建静态网格,在生成网格描述之后、提交引擎构建之前检查取消令牌,被取消时静态网格对象保持不变
+    bool BuildStaticMesh(UStaticMesh* StaticMesh, const TArray<FVector>& VertexList, const TArray<FVector>& NormalList, const FXSPCancellationToken& CancellationToken)
     {
         check(VertexList.Num() == NormalList.Num());
 
-        StaticMesh->GetStaticMaterials().Add(FStaticMaterial());
-
         FMeshDescription MeshDesc;
         FStaticMeshAttributes Attributes(MeshDesc);
         Attributes.Register();
@@ -316,22 +584,30 @@ namespace
         TArray<const FMeshDescription*> MeshDescPtrs;
         MeshDescPtrs.Emplace(&MeshDesc);
 
+        if (CancellationToken.IsCancelled())
+            return false;
+
+        StaticMesh->GetStaticMaterials().Add(FStaticMaterial());
         StaticMesh->BuildFromMeshDescriptions(MeshDescPtrs, BuildParams);
+        return true;
     }
 
-    void BuildStaticMesh(UStaticMesh* StaticMesh, const Body_info& Node)
+    //节点细分后没有有效的三角形时返回false并置bOutEmpty,与子树中没有网格体的代理一样丢弃请求并加入黑名单
+    bool BuildStaticMesh(UStaticMesh* StaticMesh, const Body_info& Node, const FXSPCancellationToken& CancellationToken, bool& bOutEmpty)
     {
         TArray<FVector> VertexList, NormalList;
-        AppendNodeMesh(Node, VertexList, NormalList);
+        if (!AppendNodeMesh(Node, VertexList, NormalList, &CancellationToken))
+            return false;
         if (VertexList.Num() < 3 || VertexList.Num() != NormalList.Num())
         {
             checkNoEntry();
-            return;
+            bOutEmpty = true;
+            return false;
         }
-        BuildStaticMesh(StaticMesh, VertexList, NormalList);
+        return BuildStaticMesh(StaticMesh, VertexList, NormalList, CancellationToken);
     }
 
-    bool IsValidMaterial(float material[4])
+    bool IsValidMaterial(const float material[4])
     {
         if (!FMath::IsFinite(material[0]) || !FMath::IsFinite(material[1]) || !FMath::IsFinite(material[2]) || !FMath::IsFinite(material[3]))
             return false;
@@ -367,15 +643,26 @@ namespace
         Roughness = 1.f;
     }
 
-    void InheritMaterial(Body_info& Node, Body_info& Parent)
+    void InheritMaterial(Body_info& Node, const float ParentMaterial[4])
+    {
+        if (IsValidMaterial(ParentMaterial))
+        {
+            Node.material[0] = ParentMaterial[0];
+            Node.material[1] = ParentMaterial[1];
+            Node.material[2] = ParentMaterial[2];
+            Node.material[3] = ParentMaterial[3];
+        }
+    }
+
+    //节点数据占用的内存,用于上级节点缓存的预算
+    SIZE_T GetBodyAllocatedSize(const Body_info& Node)
     {
-        if (IsValidMaterial(Parent.material))
+        SIZE_T NumBytes = sizeof(Body_info) + Node.name.capacity() + Node.property.capacity() + Node.vertices.capacity() * sizeof(float);
+        for (const Body_info& Fragment : Node.fragment)
         {
-            Node.material[0] = Parent.material[0];
-            Node.material[1] = Parent.material[1];
-            Node.material[2] = Parent.material[2];
-            Node.material[3] = Parent.material[3];
+            NumBytes += GetBodyAllocatedSize(Fragment);
         }
+        return NumBytes + Node.fragment.GetSlack() * sizeof(Body_info);
     }
 
     UMaterialInstanceDynamic* CreateMaterialInstanceDynamic(UMaterialInterface* SourceMaterial, const FLinearColor& Color, float Roughness)
@@ -386,6 +673,23 @@ namespace
         return MaterialInstanceDynamic;
     }
 
+    //按fragment类型预估构建开销,与AppendNodeMesh的细分方式一致
+    FXSPBuildCost EstimateBuildCost(const Body_info& Node)
+    {
+        int64 NumTriangles = 0;
+        for (int32 i = 0, i_len = Node.fragment.Num(); i < i_len; i++)
+        {
+            const Body_info& Fragment = Node.fragment[i];
+            if (Fragment.name == "Mesh")
+                NumTriangles += Fragment.vertices.size() / 9;
+            else if (Fragment.name == "Elliptical")
+                NumTriangles += 18;
+            else if (Fragment.name == "Cylinder")
+                NumTriangles += 36;
+        }
+        return FXSPBuildCost::FromTriangles(NumTriangles);
+    }
+
     bool CheckNode(const Body_info& Node)
     {
         bool bValid = false;
@@ -410,417 +714,1970 @@ namespace
         return bValid;
     }
 
-}
-
-void FStaticMeshRequest::Invalidate()
-{
-    bValid = false;
-}
-
-bool FStaticMeshRequest::IsRequestCurrent(uint64 FrameNumber)
-{
-    return bValid && (FrameNumber - LastUpdateFrameNumber < 10);
-}
-
-void FRequestQueue::Add(FStaticMeshRequest* Request)
-{
-    FScopeLock Lock(&RequestListCS);
-    AddNoLock(Request);
-}
-
-void FRequestQueue::AddNoLock(FStaticMeshRequest* Request)
-{
-    RequestList.Emplace(Request);
-}
-
-void FRequestQueue::TakeFirst(FStaticMeshRequest*& Request)
-{
-    FScopeLock Lock(&RequestListCS);
-
-    Request = nullptr;
-    if (!RequestList.IsEmpty())
+    /**
+     * 顶点聚类简化
+     * 顶点按边长为CellSize的网格归入所在的格子,同一格子的顶点合并为其平均位置;
+     * 合并后退化的三角形和重复的三角形被丢弃。逐节点输入,不保留原始顶点,内存只与简化后的规模有关
+     */
+    struct FVertexClusterSimplifier
     {
-        FSortRequestFunctor HighPriority;
+        explicit FVertexClusterSimplifier(double InCellSize)
+            : CellSize(FMath::Max(InCellSize, 1.0))
+        {}
 
-        uint64 FrameNumber = Loader->FrameNumber.load();
-
-        for (FRequestList::TIterator Itr(RequestList); Itr; ++Itr)
+        //输入三角形顶点列表(每3个顶点一个三角形)
+        void AddTriangles(const TArray<FVector>& VertexList)
         {
-            FScopeLock RequestLock(&Loader->RequestCS);
-            if ((*Itr)->IsRequestCurrent(FrameNumber))
+            int32 NumTriangles = VertexList.Num() / 3;
+            NumInputTriangles += NumTriangles;
+            for (int32 i = 0; i < NumTriangles; ++i)
             {
-                if (nullptr == Request || HighPriority(*Itr, Request))
+                int32 Clusters[3];
+                for (int32 j = 0; j < 3; ++j)
+                {
+                    Clusters[j] = FindOrAddCluster(VertexList[i * 3 + j]);
+                }
+                if (Clusters[0] == Clusters[1] || Clusters[1] == Clusters[2] || Clusters[0] == Clusters[2])
+                    continue;
+
+                //轮换到序号最小的顶点在前,保持环绕方向,使同一三角形只有一种表示
+                int32 First = Clusters[0] < Clusters[1] ? (Clusters[0] < Clusters[2] ? 0 : 2) : (Clusters[1] < Clusters[2] ? 1 : 2);
+                FIntVector Triangle(Clusters[First], Clusters[(First + 1) % 3], Clusters[(First + 2) % 3]);
+                bool bAlreadyInSet = false;
+                TriangleSet.Add(Triangle, &bAlreadyInSet);
+                if (!bAlreadyInSet)
                 {
-                    Request = *Itr;
+                    Triangles.Add(Triangle);
                 }
             }
-            else
-            {
-                FStaticMeshRequest* TheRequest = *Itr;
+        }
 
-                //过期请求,标记为失效,并从队列中移除
-                (*Itr)->Invalidate();
-                (*Itr)->SetReleasable();
-                Itr.RemoveCurrent();
+        //输出简化后的三角形顶点列表
+        void GetResult(TArray<FVector>& OutVertexList) const
+        {
+            OutVertexList.SetNumUninitialized(Triangles.Num() * 3);
+            for (int32 i = 0; i < Triangles.Num(); ++i)
+            {
+                for (int32 j = 0; j < 3; ++j)
+                {
+                    int32 Cluster = Triangles[i][j];
+                    OutVertexList[i * 3 + j] = ClusterSums[Cluster] / ClusterCounts[Cluster];
+                }
             }
         }
 
-        if (Request != nullptr)
+        int64 NumInputTriangles = 0;
+
+    private:
+        int32 FindOrAddCluster(const FVector& Vertex)
         {
-            RequestList.Remove(Request);
+            FIntVector Cell((int32)FMath::FloorToDouble(Vertex.X / CellSize), (int32)FMath::FloorToDouble(Vertex.Y / CellSize), (int32)FMath::FloorToDouble(Vertex.Z / CellSize));
+            int32 Cluster;
+            if (const int32* Found = CellToCluster.Find(Cell))
+            {
+                Cluster = *Found;
+            }
+            else
+            {
+                Cluster = ClusterSums.Add(FVector::ZeroVector);
+                ClusterCounts.Add(0);
+                CellToCluster.Add(Cell, Cluster);
+            }
+            ClusterSums[Cluster] += Vertex;
+            ClusterCounts[Cluster]++;
+            return Cluster;
         }
-    }
+
+        double CellSize;
+        TMap<FIntVector, int32> CellToCluster;
+        TArray<FVector> ClusterSums;
+        TArray<int32> ClusterCounts;
+        TSet<FIntVector> TriangleSet;
+        TArray<FIntVector> Triangles;
+    };
+
+    //代理缓存文件的格式
+    const uint32 ProxyCacheMagic = 0x444C4858; // 'XHLD'
+    const int32 ProxyCacheVersion = 1;
+
 }
 
-bool FRequestQueue::IsEmpty()
+void FStaticMeshRequest::Invalidate()
 {
-    FScopeLock Lock(&RequestListCS);
-    return RequestList.IsEmpty();
+    bValid = false;
 }
 
-void FRequestQueue::Empty()
+bool FStaticMeshRequest::IsRequestCurrent(uint64 FrameNumber)
 {
-    FScopeLock Lock(&RequestListCS);
-    RequestList.Empty();
+    return bValid && !ShouldCancel(FrameNumber);
 }
 
-void FRequestQueue::Swap(FRequestList& OutRequestList)
+void FRequestQueue::Add(FStaticMeshRequest* Request)
 {
-    FScopeLock Lock(&RequestListCS);
-    OutRequestList = MoveTemp(RequestList);
+    //先记录所在的堆再读取排序键,Game线程写入排序键后检查所在的堆,两者之一必然看到对方的写入
+    Request->OwnerQueue.store(this);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int32 Index = RequestList.Add(Request);
+    Request->HeapIndex = Index;
+    SiftUp(Index);
 }
 
-void FBuildStaticMeshTask::DoWork()
+void FRequestQueue::Place(int32 Index, FStaticMeshRequest* Request)
 {
-    BuildStaticMesh(Request->StaticMesh.Get(), *NodeData);
-    MergeRequestQueue.Add(Request);
+    RequestList[Index] = Request;
+    Request->HeapIndex = Index;
 }
 
-FXSPFileLoadRunnalbe::~FXSPFileLoadRunnalbe()
+bool FRequestQueue::SiftUp(int32 Index)
 {
-    for (auto Pair : BodyMap)
+    FSortRequestFunctor HighPriority;
+    FStaticMeshRequest* Request = RequestList[Index];
+    int32 StartIndex = Index;
+    while (Index > 0)
     {
-        delete Pair.Value;
+        int32 ParentIndex = (Index - 1) / 2;
+        if (!HighPriority(Request, RequestList[ParentIndex]))
+            break;
+        Place(Index, RequestList[ParentIndex]);
+        Index = ParentIndex;
     }
+    Place(Index, Request);
+    return Index != StartIndex;
 }
 
-uint32 FXSPFileLoadRunnalbe::Run()
+void FRequestQueue::SiftDown(int32 Index)
 {
-    //读节点头信息
-    FileStream.seekg(0, std::ios::beg);
-    int NumNodes;
-    FileStream.read((char*)&NumNodes, sizeof(NumNodes));
-    check(Count == NumNodes);
-    short headlength;
-    FileStream.read((char*)&headlength, sizeof(headlength));
-    read_header_info(FileStream, Count, HeaderList);
-    check(HeaderList.Num() == Count);
-
-    //循环等待并执行加载请求
-    while (!bStopRequested)
+    FSortRequestFunctor HighPriority;
+    FStaticMeshRequest* Request = RequestList[Index];
+    int32 Num = RequestList.Num();
+    while (true)
     {
-        FStaticMeshRequest* Request = nullptr;
-        LoadRequestQueue.TakeFirst(Request);
-        if (nullptr != Request)
-        {
-            //计算全局dbid在本文件中的局部dbid
-            int32 LocalDbid = Request->Dbid - StartDbid;
-            check(LocalDbid >= 0 && LocalDbid < Count);
-
-            //读取Body数据
-            bool bHasCache = true;
-            Body_info* NodeDataPtr = nullptr;
-            if (!BodyMap.Contains(LocalDbid))
-            {
-                bHasCache = false;
-                //读过的节点数据就缓存在内存中
-                NodeDataPtr = new Body_info;
-                read_body_info(FileStream, HeaderList[LocalDbid], false, *NodeDataPtr);
-                BodyMap.Emplace(LocalDbid, NodeDataPtr);
-            }
-            else
-            {
-                NodeDataPtr = BodyMap[LocalDbid];
-            }
-
-            if (CheckNode(*NodeDataPtr))
-            {
-                //新读入的节点需要尝试继承上级节点的材质数据
-                int32 LocalParentDbid = NodeDataPtr->parentdbid < 0 ? -1 : NodeDataPtr->parentdbid - StartDbid;
-                if (LocalParentDbid >= 0 && LocalParentDbid < Count)
-                {
-                    Body_info* ParentNodeDataPtr = nullptr;
-                    if (!BodyMap.Contains(LocalParentDbid))
-                    {
-                        ParentNodeDataPtr = new Body_info;
-                        read_body_info(FileStream, HeaderList[LocalParentDbid], false, *ParentNodeDataPtr);
-                        BodyMap.Emplace(LocalParentDbid, ParentNodeDataPtr);
-                    }
-                    else
-                    {
-                        ParentNodeDataPtr = BodyMap[LocalParentDbid];
-                    }
-
-                    InheritMaterial(*NodeDataPtr, *ParentNodeDataPtr);
-                }
-
-                GetMaterial(*NodeDataPtr, Request->Color, Request->Roughness);
-
-                //分发构建网格体的任务到线程池
-                (new FAutoDeleteAsyncTask<FBuildStaticMeshTask>(Request, NodeDataPtr, MergeRequestQueue))->StartBackgroundTask();
-            }
-            else
-            {
-                //无网格体的节点请求,置为无效,并加入黑名单
-                {
-                    FScopeLock Lock(&Loader->RequestCS);
-                    Request->Invalidate();
-                }
-                Loader->AddToBlacklist(Request->Dbid);
-                //置为可释放
-                Request->SetReleasable();
-            }
-        }
-
-        if (LoadRequestQueue.IsEmpty())
-            FPlatformProcess::SleepNoStats(1.0f);
+        int32 ChildIndex = Index * 2 + 1;
+        if (ChildIndex >= Num)
+            break;
+        if (ChildIndex + 1 < Num && HighPriority(RequestList[ChildIndex + 1], RequestList[ChildIndex]))
+            ChildIndex++;
+        if (!HighPriority(RequestList[ChildIndex], Request))
+            break;
+        Place(Index, RequestList[ChildIndex]);
+        Index = ChildIndex;
     }
-
-    return 0;
+    Place(Index, Request);
 }
 
-FXSPLoader::FXSPLoader()
+void FRequestQueue::Reorder(FStaticMeshRequest* Request)
 {
-    MergeRequestQueue.Loader = this;
+    check(Request->OwnerQueue.load() == this && RequestList.IsValidIndex(Request->HeapIndex) && RequestList[Request->HeapIndex] == Request);
+    if (!SiftUp(Request->HeapIndex))
+    {
+        SiftDown(Request->HeapIndex);
+    }
 }
 
-FXSPLoader::~FXSPLoader()
+FStaticMeshRequest* FRequestQueue::PopTop()
 {
-    Reset();
+    FStaticMeshRequest* TopRequest = RequestList[0];
+    FStaticMeshRequest* LastRequest = RequestList.Pop(false);
+    if (RequestList.Num() > 0)
+    {
+        Place(0, LastRequest);
+        SiftDown(0);
+    }
+    TopRequest->HeapIndex = INDEX_NONE;
+    TopRequest->OwnerQueue.store(nullptr);
+    return TopRequest;
 }
 
-bool FXSPLoader::Init(const TArray<FString>& FilePathNameArray)
+void FRequestQueue::SweepStale(uint64 FrameNumber)
 {
-    if (bInitialized)
-        return false;
-
-    int32 NumFiles = FilePathNameArray.Num();
-    if (NumFiles < 1)
-        return false;
-
-    int32 TotalNumNodes = 0;
-    bool bFail = false;
-    SourceDataList.SetNum(NumFiles);
-    for (int32 i = 0; i < NumFiles; ++i)
+    int32 NumKept = 0;
+    for (FStaticMeshRequest* Request : RequestList)
     {
-        SourceDataList[i] = new FSourceData;
-        SourceDataList[i]->LoadRequestQueue.Loader = this;
-        std::fstream& FileStream = SourceDataList[i]->FileStream;
-        FileStream.open(std::wstring(*FilePathNameArray[i]), std::ios::in | std::ios::binary);
-        if (!FileStream.is_open())
+        if (Request->IsRequestCurrent(FrameNumber))
         {
-            bFail = true;
-            break;
+            RequestList[NumKept++] = Request;
+            continue;
         }
 
-        //读取源文件的节点数
-        FileStream.seekg(0, std::ios::beg);
-        int NumNodes;
-        FileStream.read((char*)&NumNodes, sizeof(NumNodes));
+        //过期请求,标记为失效,并从队列中移除
+        Request->HeapIndex = INDEX_NONE;
+        Request->OwnerQueue.store(nullptr);
+        Request->Invalidate();
+        Loader->RecordCancelled(Stage);
+        Loader->MarkReleasable(Request);
+    }
+    RequestList.SetNum(NumKept, false);
 
-        SourceDataList[i]->StartDbid = TotalNumNodes;
-        SourceDataList[i]->Count = NumNodes;
-        TotalNumNodes += NumNodes;
+    for (int32 Index = 0; Index < NumKept; ++Index)
+    {
+        RequestList[Index]->HeapIndex = Index;
     }
-    if (bFail)
+    for (int32 Index = NumKept / 2 - 1; Index >= 0; --Index)
     {
-        ResetInternal();
-        return false;
+        SiftDown(Index);
     }
+}
 
-    SourceMaterial = TStrongObjectPtr(Cast<UMaterialInterface>(StaticLoadObject(UMaterialInterface::StaticClass(), nullptr, L"/XSPLoader/M_MainOpaque")));
+void FRequestQueue::TakeFirst(FStaticMeshRequest*& Request)
+{
+    Request = nullptr;
+    if (RequestList.IsEmpty())
+        return;
 
-    //为每个源文件创建一个读取线程
-    for (int32 i = 0; i < NumFiles; ++i)
+    uint64 FrameNumber = Loader->FrameNumber.load();
+
+    //过期请求的时间戳最旧,平时沉在堆底,取出时才丢弃;每NumFramesToStale帧整体剔除一次,及时释放不再需要的请求
+    if (FrameNumber - SweepFrameNumber >= FStaticMeshRequest::NumFramesToStale)
     {
-        FString ThreadName = FString::Printf(TEXT("XSPFileLoader_%d"), i);
-        SourceDataList[i]->FileLoadRunnable = new FXSPFileLoadRunnalbe(this, SourceDataList[i]->FileStream, SourceDataList[i]->StartDbid, SourceDataList[i]->Count, SourceDataList[i]->LoadRequestQueue, MergeRequestQueue);
-        SourceDataList[i]->LoadThread = FRunnableThread::Create(SourceDataList[i]->FileLoadRunnable, *ThreadName, 8 * 1024, TPri_Normal);
+        SweepStale(FrameNumber);
+        SweepFrameNumber = FrameNumber;
     }
 
-    bInitialized = true;
-    FrameNumber.store(0);
+    while (!RequestList.IsEmpty())
+    {
+        FStaticMeshRequest* TopRequest = PopTop();
+        if (TopRequest->IsRequestCurrent(FrameNumber))
+        {
+            Request = TopRequest;
+            break;
+        }
 
-    return true;
+        TopRequest->Invalidate();
+        Loader->RecordCancelled(Stage);
+        Loader->MarkReleasable(TopRequest);
+    }
 }
 
-void FXSPLoader::Reset()
+void FRequestQueue::Empty()
 {
-    if (!bInitialized)
-        return;
+    for (FStaticMeshRequest* Request : RequestList)
+    {
+        Request->HeapIndex = INDEX_NONE;
+        Request->OwnerQueue.store(nullptr);
+    }
+    RequestList.Empty();
+}
 
-    ResetInternal();
+void FBuildStaticMeshTask::DoWork()
+{
+    Loader->NumQueuedBuilds.fetch_sub(1);
+    Loader->NumBusyBuildThreads.fetch_add(1);
+    uint64 StartCycles = FPlatformTime::Cycles64();
+
+    FXSPCancellationToken CancellationToken(*Request, Loader->FrameNumber);
+    bool bEmpty = false;
+    bool bReady = nullptr != NodeData || BuildProxyNodeData(CancellationToken, bEmpty);
+    if (bReady && BuildStaticMesh(Request->StaticMesh, *NodeData, CancellationToken, bEmpty))
+    {
+        //待合并队列满时放入溢出列表,由Game线程下一帧一并取走,不在此等待
+        if (!Loader->MergeRing.TryEnqueue(Request))
+        {
+            FScopeLock Lock(&Loader->MergeOverflowCS);
+            Loader->MergeOverflow.Add(Request);
+            Loader->NumMergeOverflow.fetch_add(1);
+        }
+    }
+    else if (bEmpty)
+    {
+        //子树中没有网格体,或节点没有有效的三角形
+        Loader->DiscardEmptyRequest(Request);
+    }
+    else
+    {
+        //构建过程中被取消,放弃已生成的中间数据
+        Loader->CancelRequest(Request, EXSPLoadStage::Build);
+    }
+    Loader->BuildBudget.Release(Cost);
 
-    SourceMaterial.Reset();
-    MergeRequestQueue.Empty();
-    for (TMap<int32, FStaticMeshRequest*>::TIterator Itr(AllRequestMap); Itr; ++Itr)
-        delete Itr.Value();
-    AllRequestMap.Empty();
+    Loader->BuildBusyCycles.fetch_add(FPlatformTime::Cycles64() - StartCycles);
+    Loader->NumBusyBuildThreads.fetch_sub(1);
+    Loader->NumInFlightBuilds.fetch_sub(1);
+}
 
-    bInitialized = false;
+bool FBuildStaticMeshTask::BuildProxyNodeData(const FXSPCancellationToken& CancellationToken, bool& bOutEmpty)
+{
+    int32 ProxyDbid = Request->Dbid - Loader->TotalNumNodes;
+    NodeData = new Body_info;
+    if (!Loader->BuildProxyBody(ProxyDbid, *NodeData, CancellationToken))
+        return false;
+    Loader->SaveProxyCache(ProxyDbid, *NodeData);
+
+    if (!CheckNode(*NodeData))
+    {
+        bOutEmpty = true;
+        return false;
+    }
+    GetMaterial(*NodeData, Request->Color, Request->Roughness);
+    return true;
 }
 
-void FXSPLoader::RequestStaticMesh(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent)
+void FBuildPickMeshTask::DoWork()
 {
+    //与构建网格体的细分方式一致,三角形序号与网格体中的三角形对应
+    TUniquePtr<FXSPTriangleBVH> BVH = MakeUnique<FXSPTriangleBVH>();
+    std::fstream FileStream;
+    FileStream.open(std::wstring(*FilePathName), std::ios::in | std::ios::binary);
+    Body_info Node;
+    bool bBuilt = false;
+    bool bEmpty = false;
+    if (!FileStream.is_open())
     {
-        FScopeLock Lock(&BlacklistCS);
-        if (Blacklist.Contains(Dbid))
-            return;
+        UE_LOG(LogXSPLoader, Error, TEXT("打开源文件失败: %s"), *FilePathName);
+    }
+    else if (!read_body_info(FileStream, Header, false, Node))
+    {
+        UE_LOG(LogXSPLoader, Error, TEXT("读取节点失败: %d, %s"), Dbid, *FilePathName);
+    }
+    else if (CheckNode(Node))
+    {
+        TArray<FVector> VertexList, NormalList;
+        AppendNodeMesh(Node, VertexList, NormalList);
+        TArray<FVector3f> Vertices;
+        Vertices.SetNumUninitialized(VertexList.Num());
+        for (int32 i = 0; i < VertexList.Num(); ++i)
+        {
+            Vertices[i] = FVector3f(VertexList[i]);
+        }
+        BVH->Build(Vertices);
+        bBuilt = true;
+    }
+    else
+    {
+        //读取成功但没有网格体的节点,同时避免之后再请求其网格体
+        Loader->AddToBlacklist(Dbid);
+        bEmpty = true;
     }
 
+    if (bBuilt)
+    {
+        Loader->FinishPickMesh(Dbid, MoveTemp(BVH));
+    }
+    else if (bEmpty)
+    {
+        //没有网格体的节点已在黑名单中,不会再被构建
+        Loader->RemovePickMesh(Dbid);
+    }
+    else
     {
-        FScopeLock Lock(&CachedRequestArrayCS);
-        CachedRequestArray.Emplace(new FStaticMeshRequest(Dbid, Priority, TargetMeshComponent));
+        //读取失败可能是暂时的,退避若干帧后才可重新构建
+        Loader->FailPickMesh(Dbid);
     }
+    Loader->NumInFlightPickBuilds.fetch_sub(1);
 }
 
-void FXSPLoader::Tick(float DeltaTime)
+FXSPLoadWorker::~FXSPLoadWorker()
 {
-    if (!bInitialized)
-        return;
+    OpenFiles.Empty();
 
-    uint64 CurrentFrameNumber = FrameNumber.fetch_add(1);
+    FPlatformProcess::ReturnSynchEventToPool(WakeupEvent);
+    WakeupEvent = nullptr;
+}
 
-    int64 BeginTicks = FDateTime::Now().GetTicks();
-    DispatchNewRequests(CurrentFrameNumber);
-    float UsedTime = (float)(FDateTime::Now().GetTicks() - BeginTicks) / ETimespan::TicksPerSecond;
+void FXSPLoadWorker::Stop()
+{
+    bStopRequested = true;
+    Wakeup();
+    //可能正等待构建预算或静态网格对象
+    Loader->BuildBudget.WakeWaiters();
+    Loader->MeshPool.WakeWaiters();
+}
 
-    float AvailableTime = 0.1f - UsedTime;
-    ProcessMergeRequests(AvailableTime);
+void FXSPLoadWorker::Wakeup()
+{
+    WakeupEvent->Trigger();
+}
 
-    ReleaseRequests();
+int32 FXSPLoadWorker::DrainInbox()
+{
+    if (Inbox.IsEmpty())
+        return 0;
+
+    FScopeLock Lock(&QueueCS);
+    int32 NumAdded = RequestQueue.AddFrom(Inbox);
+    NumQueued.store(RequestQueue.RequestList.Num(), std::memory_order_relaxed);
+    return NumAdded;
 }
 
-void FXSPLoader::ResetInternal()
+FStaticMeshRequest* FXSPLoadWorker::TakeFirst()
 {
-    for (auto SourceDataPtr : SourceDataList)
-    {
-        if (nullptr != SourceDataPtr->LoadThread)
-        {
-            SourceDataPtr->LoadThread->Kill(true);
-            delete SourceDataPtr->LoadThread;
-        }
-        if (nullptr != SourceDataPtr->FileLoadRunnable)
-        {
-            delete SourceDataPtr->FileLoadRunnable;
-        }
-        if (SourceDataPtr->FileStream.is_open())
-        {
-            SourceDataPtr->FileStream.close();
-        }
-        delete SourceDataPtr;
-    }
-    SourceDataList.Empty();
+    FScopeLock Lock(&QueueCS);
+    FStaticMeshRequest* Request = nullptr;
+    RequestQueue.TakeFirst(Request);
+    NumQueued.store(RequestQueue.RequestList.Num(), std::memory_order_relaxed);
+    return Request;
 }
 
-void FXSPLoader::AddToBlacklist(int32 Dbid)
+FStaticMeshRequest* FXSPLoadWorker::Steal()
 {
-    FScopeLock Lock(&BlacklistCS);
-    if (Blacklist.Contains(Dbid))
-        return;
-    Blacklist.Add(Dbid);
+    //窃取方取走的是本队列中优先级最高的请求,与本线程自己取出的顺序一致
+    return TakeFirst();
 }
 
-void FXSPLoader::DispatchNewRequests(uint64 InFrameNumber)
+std::fstream* FXSPLoadWorker::GetFileStream(const FXSPSourceData* SourceData)
 {
-    TArray<FStaticMeshRequest*> NewRequestArray;
+    FileUseTick++;
+    if (FOpenFile* OpenFile = OpenFiles.Find(SourceData))
     {
-        FScopeLock Lock(&CachedRequestArrayCS);
-        NewRequestArray = MoveTemp(CachedRequestArray);
+        OpenFile->LastUseTick = FileUseTick;
+        return OpenFile->FileStream.Get();
     }
 
-    auto DispatchToRequestQueue = [this](int32 Dbid, FStaticMeshRequest* Request) {
-        for (auto SourceDataPtr : SourceDataList)
+    if (OpenFiles.Num() >= MaxOpenFiles)
+    {
+        //关闭最久未用的文件
+        const FXSPSourceData* OldestSourceData = nullptr;
+        uint64 OldestTick = MAX_uint64;
+        for (const auto& Pair : OpenFiles)
         {
-            if (Dbid >= SourceDataPtr->StartDbid && Dbid < SourceDataPtr->StartDbid + SourceDataPtr->Count)
+            if (Pair.Value.LastUseTick < OldestTick)
             {
-                SourceDataPtr->LoadRequestQueue.Add(Request);
-                break;
+                OldestTick = Pair.Value.LastUseTick;
+                OldestSourceData = Pair.Key;
             }
         }
-        };
+        OpenFiles.Remove(OldestSourceData);
+    }
 
-    for (auto& TempRequest : NewRequestArray)
+    TUniquePtr<std::fstream> FileStream = MakeUnique<std::fstream>();
+    FileStream->open(std::wstring(*SourceData->FilePathName), std::ios::in | std::ios::binary);
+    if (!FileStream->is_open())
     {
-        int32 Dbid = TempRequest->Dbid;
-        if (AllRequestMap.Contains(Dbid))
-        {
-            //已有请求
-            FStaticMeshRequest* Request = AllRequestMap[Dbid];
-            {
-                //更新时间戳
-                FScopeLock Lock(&RequestCS);
-                Request->bValid = true;
-                Request->LastUpdateFrameNumber = InFrameNumber;
-                //Request->Priority = TempRequest->Priority;
-                //Request->TargetComponent = TempRequest->TargetComponent;
-            }
-            if (Request->IsReleasable())
-            {
-                //重置并重新分发到请求队列
-                Request->ResetReleasable();
-                DispatchToRequestQueue(Dbid, Request);
-            }
-            delete TempRequest;
+        UE_LOG(LogXSPLoader, Error, TEXT("打开源文件失败: %s"), *SourceData->FilePathName);
+        return nullptr;
+    }
+
+    FOpenFile& OpenFile = OpenFiles.Add(SourceData);
+    OpenFile.FileStream = MoveTemp(FileStream);
+    OpenFile.LastUseTick = FileUseTick;
+    return OpenFile.FileStream.Get();
+}
+
+void FXSPLoadWorker::ProcessRequest(FStaticMeshRequest* Request)
+{
+    Loader->RecordQueueWait(FPlatformTime::Cycles64() - Request->QueuedCycles);
+
+    if (Loader->IsProxySlot(Request->Dbid))
+    {
+        ProcessProxyRequest(Request);
+        return;
+    }
+
+    const FXSPSourceData* SourceData = Loader->FindSourceData(Request->Dbid);
+    check(nullptr != SourceData);
+    std::fstream* FileStream = GetFileStream(SourceData);
+    if (nullptr == FileStream)
+    {
+        Loader->CancelRequest(Request, EXSPLoadStage::Load);
+        return;
+    }
+
+    //计算全局dbid在所属文件中的局部dbid
+    int32 LocalDbid = Request->Dbid - SourceData->StartDbid;
+
+    FXSPCancellationToken CancellationToken(*Request, Loader->FrameNumber);
+
+    //读取Body数据,请求节点的数据由构建任务持有,任务结束(完成或取消)后即释放
+    Body_info* NodeDataPtr = nullptr;
+    if (FXSPLoader::FBodyRef CachedNodeData = Loader->FindParentBody(Request->Dbid))
+    {
+        NodeDataPtr = new Body_info(*CachedNodeData);
+    }
+    else
+    {
+        NodeDataPtr = new Body_info;
+        if (!read_body_info(*FileStream, SourceData->HeaderList[LocalDbid], false, *NodeDataPtr, &CancellationToken))
+        {
+            delete NodeDataPtr;
+            NodeDataPtr = nullptr;
+        }
+    }
+
+    if (nullptr == NodeDataPtr)
+    {
+        //读取过程中被取消
+        Loader->CancelRequest(Request, EXSPLoadStage::Load);
+    }
+    else if (CheckNode(*NodeDataPtr))
+    {
+        Loader->InheritParentMaterial(SourceData, *NodeDataPtr, *FileStream);
+        GetMaterial(*NodeDataPtr, Request->Color, Request->Roughness);
+        DispatchBuild(Request, NodeDataPtr, EstimateBuildCost(*NodeDataPtr), CancellationToken);
+    }
+    else
+    {
+        delete NodeDataPtr;
+        Loader->DiscardEmptyRequest(Request);
+    }
+}
+
+void FXSPLoadWorker::ProcessProxyRequest(FStaticMeshRequest* Request)
+{
+    int32 ProxyDbid = Request->Dbid - Loader->TotalNumNodes;
+    FXSPCancellationToken CancellationToken(*Request, Loader->FrameNumber);
+
+    //优先读取缓存
+    Body_info* NodeDataPtr = new Body_info;
+    if (Loader->LoadProxyCache(ProxyDbid, *NodeDataPtr))
+    {
+        if (CheckNode(*NodeDataPtr))
+        {
+            GetMaterial(*NodeDataPtr, Request->Color, Request->Roughness);
+            DispatchBuild(Request, NodeDataPtr, EstimateBuildCost(*NodeDataPtr), CancellationToken);
+        }
+        else
+        {
+            //子树中没有网格体
+            delete NodeDataPtr;
+            Loader->DiscardEmptyRequest(Request);
+        }
+        return;
+    }
+    delete NodeDataPtr;
+
+    const FXSPLoader::FProxyInfo* ProxyInfo = Loader->ProxyInfos.Find(ProxyDbid);
+    if (nullptr == ProxyInfo)
+    {
+        Loader->CancelRequest(Request, EXSPLoadStage::Load);
+        return;
+    }
+
+    //没有缓存时读取子树的全部节点并简化合并,可能读取上千个节点,交由构建任务在线程池中进行,不阻塞本线程的请求队列
+    //读取前不知道子树的三角形数,按简化结果的预估三角形数占用构建预算
+    DispatchBuild(Request, nullptr, FXSPBuildCost::FromTriangles(ProxyInfo->EstimatedNumTriangles), CancellationToken);
+}
+
+void FXSPLoadWorker::DispatchBuild(FStaticMeshRequest* Request, Body_info* NodeDataPtr, const FXSPBuildCost& BuildCost, const FXSPCancellationToken& CancellationToken)
+{
+    //构建预算用尽时在此等待(背压),等待期间本线程队列中的请求可被其他线程窃取,请求也可能过期
+    bool bAdmitted = !CancellationToken.IsCancelled() && Loader->BuildBudget.Acquire(BuildCost, [this, &CancellationToken]() {
+        return bStopRequested || CancellationToken.IsCancelled();
+        });
+
+    if (bAdmitted)
+    {
+        //构建开始前才取出静态网格对象,池为空时等待Game线程补充;取出的对象在请求释放时归还
+        Request->StaticMesh = Loader->MeshPool.Acquire([this, &CancellationToken]() {
+            return bStopRequested || CancellationToken.IsCancelled();
+            });
+        if (nullptr == Request->StaticMesh)
+        {
+            Loader->BuildBudget.Release(BuildCost);
+            bAdmitted = false;
+        }
+    }
+
+    if (!bAdmitted)
+    {
+        delete NodeDataPtr;
+        Loader->CancelRequest(Request, EXSPLoadStage::Load);
+    }
+    else
+    {
+        //分发构建网格体的任务到专用线程池
+        Loader->NumInFlightBuilds.fetch_add(1);
+        Loader->NumQueuedBuilds.fetch_add(1);
+        (new FAutoDeleteAsyncTask<FBuildStaticMeshTask>(Loader, Request, NodeDataPtr, BuildCost))->StartBackgroundTask(Loader->BuildThreadPool);
+    }
+}
+
+uint32 FXSPLoadWorker::Run()
+{
+    //循环等待并执行加载请求
+    while (!bStopRequested)
+    {
+        //批量取出Game线程分发来的新请求,本线程积压了多个请求时唤醒其他线程来窃取
+        if (DrainInbox() > 0 && GetNumQueued() > 1)
+        {
+            Loader->WakeLoadWorkers(this);
+        }
+
+        FStaticMeshRequest* Request = TakeFirst();
+        if (nullptr == Request)
+        {
+            Request = Loader->StealRequest(this);
+        }
+
+        if (nullptr != Request)
+        {
+            ProcessRequest(Request);
+        }
+        else if (Inbox.IsEmpty() && !bStopRequested)
+        {
+            //无请求可做时阻塞等待,直到有新请求分发进来、其他线程有积压或线程被要求退出
+            //自动重置的事件在无人等待时被触发会保持信号状态,因此判空与等待之间的唤醒不会丢失
+            WakeupEvent->Wait();
+        }
+    }
+
+    return 0;
+}
+
+FStaticMeshRequest* FXSPLoader::StealRequest(const FXSPLoadWorker* Thief)
+{
+    //按排队数从多到少依次尝试
+    TArray<FXSPLoadWorker*, TInlineAllocator<16>> Victims;
+    for (FXSPLoadWorker* Worker : LoadWorkers)
+    {
+        if (Worker != Thief && Worker->GetNumQueued() > 0)
+        {
+            Victims.Add(Worker);
+        }
+    }
+    Victims.Sort([](const FXSPLoadWorker& Lhs, const FXSPLoadWorker& Rhs) { return Lhs.GetNumQueued() > Rhs.GetNumQueued(); });
+
+    for (FXSPLoadWorker* Victim : Victims)
+    {
+        if (FStaticMeshRequest* Request = Victim->Steal())
+        {
+            NumStolenRequests.fetch_add(1);
+            return Request;
+        }
+    }
+    return nullptr;
+}
+
+void FXSPLoader::WakeLoadWorkers(const FXSPLoadWorker* Source)
+{
+    for (FXSPLoadWorker* Worker : LoadWorkers)
+    {
+        if (Worker != Source)
+        {
+            Worker->Wakeup();
+        }
+    }
+}
+
+FXSPLoader::FBodyRef FXSPLoader::FindParentBody(int32 Dbid)
+{
+    FScopeLock Lock(&ParentBodyCacheCS);
+    FParentBody* ParentBody = ParentBodyCache.Find(Dbid);
+    if (nullptr == ParentBody)
+        return FBodyRef();
+    ParentBody->LastUseFrame = FrameNumber.load(std::memory_order_relaxed);
+    return ParentBody->Body;
+}
+
+FXSPLoader::FBodyRef FXSPLoader::FindOrReadParentBody(const FSourceData* SourceData, int32 ParentDbid, std::fstream& FileStream)
+{
+    if (FBodyRef ParentBody = FindParentBody(ParentDbid))
+        return ParentBody;
+
+    //在锁外读取,多个线程同时读取同一上级节点时只保留先放入的
+    TSharedPtr<Body_info, ESPMode::ThreadSafe> NewParentBody = MakeShared<Body_info, ESPMode::ThreadSafe>();
+    if (!read_body_info(FileStream, SourceData->HeaderList[ParentDbid - SourceData->StartDbid], false, *NewParentBody))
+        return FBodyRef();
+
+    FScopeLock Lock(&ParentBodyCacheCS);
+    if (FParentBody* ExistingParentBody = ParentBodyCache.Find(ParentDbid))
+        return ExistingParentBody->Body;
+
+    FParentBody& ParentBody = ParentBodyCache.Add(ParentDbid);
+    ParentBody.NumBytes = GetBodyAllocatedSize(*NewParentBody);
+    ParentBody.LastUseFrame = FrameNumber.load(std::memory_order_relaxed);
+    ParentBody.Body = NewParentBody;
+    ParentBodyCacheBytes += ParentBody.NumBytes;
+    return ParentBody.Body;
+}
+
+void FXSPLoader::EvictParentBodies()
+{
+    const SIZE_T BudgetBytes = (SIZE_T)FMath::Max(0, GXSPParentBodyCacheMB) * 1024 * 1024;
+    FScopeLock Lock(&ParentBodyCacheCS);
+    if (ParentBodyCacheBytes <= BudgetBytes)
+        return;
+
+    //按最近被查找的帧号从旧到新丢弃,降到预算的3/4以下,避免每帧都排序;正在使用的数据由使用者的共享指针保持
+    TArray<TPair<uint64, int32>> EvictionOrder;
+    EvictionOrder.Reserve(ParentBodyCache.Num());
+    for (const auto& Pair : ParentBodyCache)
+    {
+        EvictionOrder.Emplace(Pair.Value.LastUseFrame, Pair.Key);
+    }
+    EvictionOrder.Sort([](const TPair<uint64, int32>& Lhs, const TPair<uint64, int32>& Rhs) { return Lhs.Key < Rhs.Key; });
+
+    const SIZE_T TargetBytes = BudgetBytes / 4 * 3;
+    for (const TPair<uint64, int32>& Entry : EvictionOrder)
+    {
+        if (ParentBodyCacheBytes <= TargetBytes)
+            break;
+        ParentBodyCacheBytes -= ParentBodyCache.FindChecked(Entry.Value).NumBytes;
+        ParentBodyCache.Remove(Entry.Value);
+    }
+}
+
+void FXSPLoader::InheritParentMaterial(const FSourceData* SourceData, Body_info& Node, std::fstream& FileStream)
+{
+    int32 LocalParentDbid = Node.parentdbid < 0 ? -1 : Node.parentdbid - SourceData->StartDbid;
+    if (LocalParentDbid >= 0 && LocalParentDbid < SourceData->Count)
+    {
+        if (FBodyRef ParentNodeData = FindOrReadParentBody(SourceData, Node.parentdbid, FileStream))
+        {
+            InheritMaterial(Node, ParentNodeData->material);
+        }
+    }
+}
+
+bool FXSPLoader::BuildProxyBody(int32 ProxyDbid, Body_info& OutBody, const FXSPCancellationToken& CancellationToken)
+{
+    const FProxyInfo* ProxyInfo = ProxyInfos.Find(ProxyDbid);
+    if (nullptr == ProxyInfo)
+        return false;
+
+    double BeginTime = FPlatformTime::Seconds();
+    FVertexClusterSimplifier Simplifier(ProxyInfo->CellSize);
+    //材质取各节点按三角形数加权的平均值
+    FLinearColor ColorSum(0, 0, 0, 0);
+    double RoughnessSum = 0;
+    int32 NumNodes = 0;
+
+    //本任务自己的源文件流,不与加载线程共享
+    TMap<const FSourceData*, TUniquePtr<std::fstream>> FileStreams;
+    //子树中已读入节点的原始材质,子节点优先从中继承,子树内部的节点不放入ParentBodyCache
+    TMap<int32, FVector4f> SubtreeMaterials;
+
+    //深度优先遍历子树,上级节点先于下级节点读入,子树的根节点自身的网格体也包含在内
+    TArray<int32> Stack;
+    Stack.Add(ProxyDbid);
+    TArray<FVector> VertexList, NormalList;
+    while (Stack.Num() > 0)
+    {
+        if (CancellationToken.IsCancelled())
+            return false;
+
+        int32 Dbid = Stack.Pop(false);
+        Stack.Append(NodeHierarchy.GetChildren(Dbid));
+        if (Blacklist.Test(Dbid))
+            continue;
+
+        const FSourceData* SourceData = FindSourceData(Dbid);
+        if (nullptr == SourceData)
+            return false;
+        TUniquePtr<std::fstream>& FileStream = FileStreams.FindOrAdd(SourceData);
+        if (!FileStream.IsValid())
+        {
+            FileStream = MakeUnique<std::fstream>();
+            FileStream->open(std::wstring(*SourceData->FilePathName), std::ios::in | std::ios::binary);
+        }
+        if (!FileStream->is_open())
+        {
+            UE_LOG(LogXSPLoader, Error, TEXT("打开源文件失败: %s"), *SourceData->FilePathName);
+            return false;
+        }
+
+        Body_info Node;
+        if (FBodyRef CachedNodeData = FindParentBody(Dbid))
+        {
+            Node = *CachedNodeData;
+        }
+        else if (!read_body_info(*FileStream, SourceData->HeaderList[Dbid - SourceData->StartDbid], false, Node, &CancellationToken))
+        {
+            return false;
+        }
+        SubtreeMaterials.Add(Dbid, FVector4f(Node.material[0], Node.material[1], Node.material[2], Node.material[3]));
+        if (!CheckNode(Node))
+            continue;
+
+        if (const FVector4f* ParentMaterial = SubtreeMaterials.Find(Node.parentdbid))
+        {
+            InheritMaterial(Node, &ParentMaterial->X);
+        }
+        else
+        {
+            InheritParentMaterial(SourceData, Node, *FileStream);
+        }
+        FLinearColor Color;
+        float Roughness;
+        GetMaterial(Node, Color, Roughness);
+
+        VertexList.Reset();
+        NormalList.Reset();
+        if (!AppendNodeMesh(Node, VertexList, NormalList, &CancellationToken))
+            return false;
+        int32 NumTriangles = VertexList.Num() / 3;
+        Simplifier.AddTriangles(VertexList);
+        ColorSum += Color * (float)NumTriangles;
+        RoughnessSum += Roughness * NumTriangles;
+        NumNodes++;
+    }
+
+    TArray<FVector> SimplifiedVertexList;
+    Simplifier.GetResult(SimplifiedVertexList);
+
+    //合并为只有一个"Mesh"图元的节点数据,顶点转换回源数据的坐标系(交换xy,厘米转米),与普通节点走相同的构建流程
+    OutBody.dbid = ProxyDbid;
+    OutBody.parentdbid = -1;
+    OutBody.level = 0;
+    OutBody.name = "HLOD";
+    FLinearColor Color = Simplifier.NumInputTriangles > 0 ? ColorSum / (float)Simplifier.NumInputTriangles : FLinearColor(0.078125f, 0.078125f, 0.078125f);
+    float Roughness = Simplifier.NumInputTriangles > 0 ? (float)(RoughnessSum / Simplifier.NumInputTriangles) : 1.f;
+    OutBody.material[0] = Color.R;
+    OutBody.material[1] = Color.G;
+    OutBody.material[2] = Color.B;
+    OutBody.material[3] = Roughness;
+    FMemory::Memzero(OutBody.box, sizeof(OutBody.box));
+    OutBody.fragment.Reset();
+    if (SimplifiedVertexList.Num() > 0)
+    {
+        Body_info& Fragment = OutBody.fragment.AddDefaulted_GetRef();
+        Fragment.name = "Mesh";
+        FMemory::Memcpy(Fragment.material, OutBody.material, sizeof(Fragment.material));
+        Fragment.vertices.reserve(SimplifiedVertexList.Num() * 3);
+        for (const FVector& Vertex : SimplifiedVertexList)
+        {
+            Fragment.vertices.push_back(Vertex.Y / 100);
+            Fragment.vertices.push_back(Vertex.X / 100);
+            Fragment.vertices.push_back(Vertex.Z / 100);
+        }
+    }
+
+    UE_LOG(LogXSPLoader, Display, TEXT("构建代理: %d, %d个节点, 三角形%lld->%d, 耗时%.1fms"), ProxyDbid, NumNodes, Simplifier.NumInputTriangles, SimplifiedVertexList.Num() / 3, (FPlatformTime::Seconds() - BeginTime) * 1000.0);
+    return true;
+}
+
+void FXSPLoader::DiscardEmptyRequest(FStaticMeshRequest* Request)
+{
+    //无网格体的节点请求,置为无效,并加入黑名单
+    {
+        FScopeLock Lock(&RequestCS);
+        Request->Invalidate();
+    }
+    AddToBlacklist(Request->Dbid);
+    //置为可释放
+    MarkReleasable(Request);
+}
+
+FXSPLoader::FXSPLoader()
+{
+    MergeRequestQueue.Loader = this;
+    MergeRequestQueue.Stage = EXSPLoadStage::Merge;
+    NewRequestRing.Init(NewRequestRingCapacity);
+    MergeRing.Init(MergeRingCapacity);
+}
+
+FXSPLoader::~FXSPLoader()
+{
+    Reset();
+}
+
+bool FXSPLoader::Init(const TArray<FString>& FilePathNameArray)
+{
+    if (bInitialized)
+        return false;
+
+    int32 NumFiles = FilePathNameArray.Num();
+    if (NumFiles < 1)
+        return false;
+
+    TotalNumNodes = 0;
+    bool bFail = false;
+    SourceDataList.SetNum(NumFiles);
+    //只在Init期间用于读取节点头信息,加载工作线程各自打开源文件
+    TArray<TUniquePtr<std::fstream>> FileStreams;
+    FileStreams.SetNum(NumFiles);
+    for (int32 i = 0; i < NumFiles; ++i)
+    {
+        SourceDataList[i] = new FSourceData;
+        SourceDataList[i]->FilePathName = FilePathNameArray[i];
+        FileStreams[i] = MakeUnique<std::fstream>();
+        std::fstream& FileStream = *FileStreams[i];
+        FileStream.open(std::wstring(*FilePathNameArray[i]), std::ios::in | std::ios::binary);
+        if (!FileStream.is_open())
+        {
+            bFail = true;
+            break;
+        }
+
+        //读取源文件的节点数
+        FileStream.seekg(0, std::ios::beg);
+        int NumNodes;
+        FileStream.read((char*)&NumNodes, sizeof(NumNodes));
+
+        SourceDataList[i]->StartDbid = TotalNumNodes;
+        SourceDataList[i]->Count = NumNodes;
+        SourceRouting.AddSource(TotalNumNodes, NumNodes);
+        TotalNumNodes += NumNodes;
+    }
+    if (bFail)
+    {
+        ResetInternal();
+        return false;
+    }
+
+    //并行读取各源文件的节点头信息、包围盒和预估三角形数
+    ParallelFor(NumFiles, [this, &FileStreams](int32 i) {
+        FSourceData* SourceDataPtr = SourceDataList[i];
+        std::fstream& FileStream = *FileStreams[i];
+        FileStream.seekg(sizeof(int), std::ios::beg);
+        short headlength;
+        FileStream.read((char*)&headlength, sizeof(headlength));
+        read_header_info(FileStream, SourceDataPtr->Count, SourceDataPtr->HeaderList);
+        read_node_bounds(FileStream, SourceDataPtr->HeaderList, SourceDataPtr->BoundsList);
+        read_node_triangle_estimates(FileStream, SourceDataPtr->HeaderList, SourceDataPtr->NumTrianglesList);
+        });
+
+    FString SourceHash;
+    if (GXSPPersistBlacklist > 0 || GXSPCacheBVH > 0 || GXSPCacheHLOD > 0)
+    {
+        SourceHash = compute_source_hash(FilePathNameArray);
+    }
+
+    BuildNodeBVH(GXSPCacheBVH > 0 ? SourceHash : FString());
+    BuildNodeHierarchy();
+    if (GXSPCacheHLOD > 0)
+    {
+        ProxyCacheDir = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("XSPLoader"), FString::Printf(TEXT("HLOD_%s_%d"), *SourceHash, FMath::Max(2, GXSPHLODResolution)));
+    }
+
+    RequestSlots.SetNumZeroed(GetNumSlots());
+    Blacklist.Init(GetNumSlots());
+    ResidencyBudget.Init(GetNumSlots());
+    if (GXSPPersistBlacklist > 0)
+    {
+        BlacklistFilePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("XSPLoader"), FString::Printf(TEXT("Blacklist_%s.bin"), *SourceHash));
+        LoadBlacklist();
+    }
+
+    SourceMaterial = TStrongObjectPtr(Cast<UMaterialInterface>(StaticLoadObject(UMaterialInterface::StaticClass(), nullptr, L"/XSPLoader/M_MainOpaque")));
+
+    //预先创建静态网格对象,之后每帧逐步补充
+    MeshPool.Tick(GetMeshPoolTarget(), GetMeshPoolTarget());
+
+    //创建构建网格体的专用线程池,与引擎的GThreadPool隔离,避免与引擎的异步任务互相争抢
+    NumBuildThreads = GXSPBuildThreads > 0 ? GXSPBuildThreads : FMath::Max(1, FPlatformMisc::NumberOfWorkerThreadsToSpawn() / 2);
+    EThreadPriority BuildThreadPriority = (EThreadPriority)FMath::Clamp(GXSPBuildThreadPriority, 0, (int32)TPri_Num - 1);
+    uint32 BuildThreadStackSize = (uint32)FMath::Max(64, GXSPBuildThreadStackSize) * 1024;
+    BuildThreadPool = FQueuedThreadPool::Allocate();
+    verify(BuildThreadPool->Create(NumBuildThreads, BuildThreadStackSize, BuildThreadPriority, TEXT("XSPBuildThreadPool")));
+    LastPublishStatsCycles = FPlatformTime::Cycles64();
+    SET_DWORD_STAT(STAT_XSPNumBuildThreads, NumBuildThreads);
+
+    //创建加载工作线程,个数与源文件数无关,所有线程共同服务全部源文件
+    int32 NumLoadThreads = GXSPLoadThreads > 0 ? GXSPLoadThreads : FMath::Clamp(FPlatformMisc::NumberOfCores() / 2, 1, 8);
+    for (int32 i = 0; i < NumLoadThreads; ++i)
+    {
+        FString ThreadName = FString::Printf(TEXT("XSPLoadWorker_%d"), i);
+        FXSPLoadWorker* Worker = new FXSPLoadWorker(this, i, LoadRingCapacity);
+        LoadWorkers.Add(Worker);
+        LoadThreads.Add(FRunnableThread::Create(Worker, *ThreadName, 8 * 1024, TPri_Normal));
+    }
+    NextLoadWorker = 0;
+    SET_DWORD_STAT(STAT_XSPNumLoadThreads, NumLoadThreads);
+
+    bInitialized = true;
+    FrameNumber.store(0);
+
+    return true;
+}
+
+void FXSPLoader::Reset()
+{
+    if (!bInitialized)
+        return;
+
+    //取消全部请求,停止加载线程,并等待线程池中的构建任务尽快结束,之后才能安全释放请求
+    for (FStaticMeshRequest* Request : RequestSlots)
+    {
+        if (nullptr != Request)
+            Request->Cancel();
+    }
+    ResetInternal();
+    while (NumInFlightBuilds.load() > 0 || NumInFlightPickBuilds.load() > 0)
+    {
+        //及时取走已完成的请求,避免大量请求进入溢出列表
+        DrainMergeRing();
+        FPlatformProcess::SleepNoStats(0.001f);
+    }
+
+    BuildThreadPool->Destroy();
+    delete BuildThreadPool;
+    BuildThreadPool = nullptr;
+    NumBuildThreads = 0;
+    SET_DWORD_STAT(STAT_XSPNumBuildThreads, 0);
+
+    SaveBlacklist();
+    BlacklistFilePath.Empty();
+    Blacklist.Empty();
+    NodeBVH.Empty();
+    NodeHierarchy.Reset();
+    ProxyInfos.Empty();
+    ProxyCacheDir.Empty();
+    ResidencyBudget.Reset();
+    ComponentPool.Reset();
+    {
+        FScopeLock Lock(&PickCS);
+        PickMeshes.Empty();
+        PickRetries.Empty();
+        PickCacheBytes = 0;
+    }
+
+    SourceMaterial.Reset();
+    //队列中的请求仍由槽位持有,只需清空队列
+    DrainMergeRing();
+    MergeRequestQueue.Empty();
+    FXSPMeshRequest PendingRequest;
+    while (NewRequestRing.Dequeue(PendingRequest))
+    {
+    }
+    //可释放链表中的请求可能已不在槽位中(被同dbid的新请求替换),先释放链表再释放槽位
+    ReleaseRequests();
+    for (FStaticMeshRequest*& Request : RequestSlots)
+    {
+        delete Request;
+        Request = nullptr;
+    }
+    RequestSlots.Empty();
+    SET_DWORD_STAT(STAT_XSPNumLiveRequests, 0);
+    MeshPool.Reset();
+
+    TotalNumNodes = 0;
+    bInitialized = false;
+}
+
+void FXSPLoader::RequestStaticMesh(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent)
+{
+    SCOPE_CYCLE_COUNTER(STAT_XSPSubmitRequests);
+    INC_DWORD_STAT(STAT_XSPNumSubmitted);
+
+    if (Dbid < 0 || Dbid >= TotalNumNodes || Blacklist.Test(Dbid))
+        return;
+
+    if (!NewRequestRing.TryEnqueue(FXSPMeshRequest(Dbid, Priority, TargetMeshComponent)))
+    {
+        //队列已满,丢弃本次请求,外部在之后的帧中会重新请求
+        NumDroppedRequests.fetch_add(1);
+    }
+}
+
+void FXSPLoader::RequestStaticMeshes(TArrayView<const FXSPMeshRequest> Requests)
+{
+    SCOPE_CYCLE_COUNTER(STAT_XSPSubmitRequests);
+    INC_DWORD_STAT_BY(STAT_XSPNumSubmitted, Requests.Num());
+
+    //滤掉黑名单中的节点后按块入队,每块只占用一次队列的写入位置
+    FXSPMeshRequest Batch[256];
+    int32 NumInBatch = 0;
+    auto FlushBatch = [this, &Batch, &NumInBatch]() {
+        int32 NumEnqueued = NewRequestRing.TryEnqueueBatch(Batch, NumInBatch);
+        if (NumEnqueued < NumInBatch)
+        {
+            //队列已满,丢弃剩余的请求,外部在之后的帧中会重新请求
+            NumDroppedRequests.fetch_add(NumInBatch - NumEnqueued);
+        }
+        NumInBatch = 0;
+        };
+
+    for (const FXSPMeshRequest& Request : Requests)
+    {
+        if (Request.Dbid < 0 || Request.Dbid >= TotalNumNodes || Blacklist.Test(GetSlotIndex(Request)))
+            continue;
+        if (Request.bProxy && !ProxyInfos.Contains(Request.Dbid))
+            continue;
+
+        Batch[NumInBatch++] = Request;
+        if (NumInBatch == UE_ARRAY_COUNT(Batch))
+        {
+            FlushBatch();
+        }
+    }
+    if (NumInBatch > 0)
+    {
+        FlushBatch();
+    }
+}
+
+void FXSPLoader::RequestProxyMesh(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent)
+{
+    SCOPE_CYCLE_COUNTER(STAT_XSPSubmitRequests);
+    INC_DWORD_STAT(STAT_XSPNumSubmitted);
+
+    FXSPMeshRequest Request(Dbid, Priority, TargetMeshComponent, true);
+    if (!ProxyInfos.Contains(Dbid) || Blacklist.Test(GetSlotIndex(Request)))
+        return;
+
+    if (!NewRequestRing.TryEnqueue(Request))
+    {
+        //队列已满,丢弃本次请求,外部在之后的帧中会重新请求
+        NumDroppedRequests.fetch_add(1);
+    }
+}
+
+bool FXSPLoader::GetProxyInfo(int32 Dbid, FBox& OutBounds, float& OutError) const
+{
+    const FProxyInfo* ProxyInfo = ProxyInfos.Find(Dbid);
+    if (nullptr == ProxyInfo)
+        return false;
+
+    //聚类后的顶点不会离开所在的格子,误差不超过格子的对角线长
+    OutBounds = FBox(ProxyInfo->Bounds);
+    OutError = ProxyInfo->CellSize * UE_SQRT_3;
+    return true;
+}
+
+bool FXSPLoader::GetNodeBoundingBox(int32 Dbid, FBox& OutBox) const
+{
+    FSourceData* SourceDataPtr = FindSourceData(Dbid);
+    if (nullptr == SourceDataPtr)
+        return false;
+
+    OutBox = FBox(SourceDataPtr->BoundsList[Dbid - SourceDataPtr->StartDbid]);
+    return true;
+}
+
+FXSPLoader::FSourceData* FXSPLoader::FindSourceData(int32 Dbid) const
+{
+    int32 SourceIndex = SourceRouting.FindSourceIndex(Dbid);
+    return SourceIndex == INDEX_NONE ? nullptr : SourceDataList[SourceIndex];
+}
+
+void FXSPLoader::Tick(float DeltaTime)
+{
+    if (!bInitialized)
+        return;
+
+    uint64 CurrentFrameNumber = FrameNumber.fetch_add(1);
+
+    BuildBudget.SetLimits(FXSPBuildBudget::GetLimitsFromConsoleVariables());
+
+    {
+        //每帧只新建少量静态网格对象,请求突增时由空闲对象吸收
+        SCOPE_CYCLE_COUNTER(STAT_XSPTickMeshPool);
+        MeshPool.Tick(GetMeshPoolTarget(), GXSPMeshPoolRefillPerFrame);
+    }
+
+    {
+        SCOPE_CYCLE_COUNTER(STAT_XSPDispatchNewRequests);
+        DispatchNewRequests(CurrentFrameNumber);
+    }
+
+    ProcessMergeRequests(DeltaTime);
+
+    EvictMeshes(CurrentFrameNumber);
+
+    EvictPickMeshes();
+
+    EvictParentBodies();
+
+    ReleaseRequests();
+
+    PublishStats();
+}
+
+int32 FXSPLoader::GetMeshPoolTarget() const
+{
+    //同时构建的网格体,加上构建完成等待合并的网格体
+    return GXSPMeshPoolSize > 0 ? GXSPMeshPoolSize : FXSPBuildBudget::GetLimitsFromConsoleVariables().MaxInFlight * 2;
+}
+
+void FXSPLoader::RecordQueueWait(uint64 WaitCycles)
+{
+    QueueWaitCyclesSum.fetch_add(WaitCycles);
+    NumQueueWaits.fetch_add(1);
+
+    uint64 CurrentMax = QueueWaitCyclesMax.load();
+    while (WaitCycles > CurrentMax && !QueueWaitCyclesMax.compare_exchange_weak(CurrentMax, WaitCycles))
+    {
+    }
+}
+
+void FXSPLoader::PublishStats()
+{
+    uint64 WaitCyclesSum = QueueWaitCyclesSum.exchange(0);
+    uint64 WaitCyclesMax = QueueWaitCyclesMax.exchange(0);
+    uint32 NumWaits = NumQueueWaits.exchange(0);
+
+    SET_DWORD_STAT(STAT_XSPNumDequeued, NumWaits);
+    SET_FLOAT_STAT(STAT_XSPAvgQueueWait, NumWaits > 0 ? FPlatformTime::ToMilliseconds64(WaitCyclesSum) / NumWaits : 0.0);
+    SET_FLOAT_STAT(STAT_XSPMaxQueueWait, FPlatformTime::ToMilliseconds64(WaitCyclesMax));
+
+    SET_DWORD_STAT(STAT_XSPNumMerged, MergeBudget.GetNumMergedThisFrame());
+    SET_FLOAT_STAT(STAT_XSPMergeBudget, MergeBudget.GetFrameBudget() * 1000.0);
+    SET_FLOAT_STAT(STAT_XSPAvgMergeCost, MergeBudget.GetAverageMergeCost() * 1000.0);
+    SET_FLOAT_STAT(STAT_XSPMergeImpactP50, MergeBudget.GetFrameImpactPercentile(0.5f));
+    SET_FLOAT_STAT(STAT_XSPMergeImpactP99, MergeBudget.GetFrameImpactPercentile(0.99f));
+
+    SET_DWORD_STAT(STAT_XSPNumInFlightBuilds, BuildBudget.GetNumInFlight());
+    SET_DWORD_STAT(STAT_XSPNumInFlightTriangles, BuildBudget.GetNumTrianglesInFlight());
+    SET_FLOAT_STAT(STAT_XSPInFlightBuildMB, BuildBudget.GetNumBytesInFlight() / (1024.0 * 1024.0));
+
+    //利用率按任务结束时累计的执行时长计算,跨帧的长任务会使单帧数值有波动
+    uint64 CurrentCycles = FPlatformTime::Cycles64();
+    uint64 ElapsedCycles = CurrentCycles - LastPublishStatsCycles;
+    LastPublishStatsCycles = CurrentCycles;
+    uint64 BusyCycles = BuildBusyCycles.exchange(0);
+    SET_DWORD_STAT(STAT_XSPBuildQueueDepth, FMath::Max(0, NumQueuedBuilds.load()));
+    SET_DWORD_STAT(STAT_XSPNumBusyBuildThreads, NumBusyBuildThreads.load());
+    SET_FLOAT_STAT(STAT_XSPBuildPoolUtilization, ElapsedCycles > 0 && NumBuildThreads > 0 ? FMath::Min(100.0, 100.0 * BusyCycles / ((double)ElapsedCycles * NumBuildThreads)) : 0.0);
+
+    {
+        FScopeLock Lock(&PickCS);
+        SET_DWORD_STAT(STAT_XSPNumPickMeshes, PickMeshes.Num());
+        SET_FLOAT_STAT(STAT_XSPPickCacheMB, PickCacheBytes / (1024.0 * 1024.0));
+    }
+
+    INC_DWORD_STAT_BY(STAT_XSPNumCompleted, NumCompletedRequests.exchange(0));
+    INC_DWORD_STAT_BY(STAT_XSPNumDropped, NumDroppedRequests.exchange(0));
+    INC_DWORD_STAT_BY(STAT_XSPNumStolen, NumStolenRequests.exchange(0));
+    INC_DWORD_STAT_BY(STAT_XSPNumCancelledLoad, NumCancelledRequests[(int32)EXSPLoadStage::Load].exchange(0));
+    INC_DWORD_STAT_BY(STAT_XSPNumCancelledBuild, NumCancelledRequests[(int32)EXSPLoadStage::Build].exchange(0));
+    INC_DWORD_STAT_BY(STAT_XSPNumCancelledMerge, NumCancelledRequests[(int32)EXSPLoadStage::Merge].exchange(0));
+}
+
+void FXSPLoader::ResetInternal()
+{
+    for (FRunnableThread* LoadThread : LoadThreads)
+    {
+        LoadThread->Kill(true);
+        delete LoadThread;
+    }
+    LoadThreads.Empty();
+    for (FXSPLoadWorker* Worker : LoadWorkers)
+    {
+        delete Worker;
+    }
+    LoadWorkers.Empty();
+
+    ParentBodyCache.Empty();
+    ParentBodyCacheBytes = 0;
+
+    SourceRouting.Reset();
+    for (auto SourceDataPtr : SourceDataList)
+    {
+        delete SourceDataPtr;
+    }
+    SourceDataList.Empty();
+}
+
+void FXSPLoader::AddToBlacklist(int32 Dbid)
+{
+    Blacklist.Set(Dbid);
+}
+
+void FXSPLoader::LoadBlacklist()
+{
+    if (BlacklistFilePath.IsEmpty())
+        return;
+
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*BlacklistFilePath));
+    if (!Reader)
+        return;
+
+    if (Blacklist.Serialize(*Reader))
+    {
+        UE_LOG(LogXSPLoader, Display, TEXT("读取黑名单: %d个空节点"), Blacklist.CountSetBits());
+    }
+    else
+    {
+        //损坏或不匹配的文件,丢弃已读入的部分
+        Blacklist.Init(GetNumSlots());
+        UE_LOG(LogXSPLoader, Warning, TEXT("黑名单文件无效: %s"), *BlacklistFilePath);
+    }
+}
+
+void FXSPLoader::SaveBlacklist()
+{
+    if (BlacklistFilePath.IsEmpty())
+        return;
+
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*BlacklistFilePath));
+    if (!Writer)
+    {
+        UE_LOG(LogXSPLoader, Warning, TEXT("写入黑名单失败: %s"), *BlacklistFilePath);
+        return;
+    }
+    Blacklist.Serialize(*Writer);
+}
+
+void FXSPLoader::BuildNodeBVH(const FString& SourceHash)
+{
+    double BeginTime = FPlatformTime::Seconds();
+    FString CacheFilePath;
+    if (!SourceHash.IsEmpty())
+    {
+        CacheFilePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("XSPLoader"), FString::Printf(TEXT("BVH_%s.bin"), *SourceHash));
+        TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*CacheFilePath));
+        if (Reader)
+        {
+            if (NodeBVH.Serialize(*Reader) && NodeBVH.GetSourceCount() == TotalNumNodes)
+            {
+                UE_LOG(LogXSPLoader, Display, TEXT("读取节点空间索引: %d个节点, 耗时%.1fms"), NodeBVH.NumPrimitives(), (FPlatformTime::Seconds() - BeginTime) * 1000.0);
+                return;
+            }
+            NodeBVH.Empty();
+            UE_LOG(LogXSPLoader, Warning, TEXT("节点空间索引缓存无效: %s"), *CacheFilePath);
         }
-        else
+    }
+
+    //各源文件的包围盒按dbid顺序首尾相接
+    TArray<FBox3f> NodeBounds;
+    NodeBounds.Reserve(TotalNumNodes);
+    for (const FSourceData* SourceDataPtr : SourceDataList)
+    {
+        NodeBounds.Append(SourceDataPtr->BoundsList);
+    }
+    NodeBVH.Build(NodeBounds);
+    UE_LOG(LogXSPLoader, Display, TEXT("构建节点空间索引: %d个节点, %d个BVH节点, 耗时%.1fms"), NodeBVH.NumPrimitives(), NodeBVH.NumNodes(), (FPlatformTime::Seconds() - BeginTime) * 1000.0);
+
+    if (CacheFilePath.IsEmpty())
+        return;
+
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*CacheFilePath));
+    if (!Writer)
+    {
+        UE_LOG(LogXSPLoader, Warning, TEXT("写入节点空间索引缓存失败: %s"), *CacheFilePath);
+        return;
+    }
+    NodeBVH.Serialize(*Writer);
+}
+
+void FXSPLoader::BuildNodeHierarchy()
+{
+    double BeginTime = FPlatformTime::Seconds();
+
+    TArray<int32> Parents;
+    TArray<FBox3f> SubtreeBounds;
+    Parents.SetNumUninitialized(TotalNumNodes);
+    SubtreeBounds.SetNumUninitialized(TotalNumNodes);
+    for (const FSourceData* SourceDataPtr : SourceDataList)
+    {
+        for (int32 i = 0; i < SourceDataPtr->Count; ++i)
+        {
+            int32 Dbid = SourceDataPtr->StartDbid + i;
+            Parents[Dbid] = SourceDataPtr->HeaderList[i].parentdbid;
+            SubtreeBounds[Dbid] = SourceDataPtr->BoundsList[i];
+        }
+    }
+    NodeHierarchy.Build(MoveTemp(Parents));
+
+    //由根节点广度优先遍历,再按遍历的逆序把每个节点的子树节点数和包围盒累加到上级,子节点总在上级之前处理
+    //不依赖节点头中的level,它不一定与parentdbid给出的深度一致;成环的节点不可从根节点到达,不参与累加
+    TArray<int32> Order;
+    Order.Reserve(TotalNumNodes);
+    for (int32 Dbid = 0; Dbid < TotalNumNodes; ++Dbid)
+    {
+        if (NodeHierarchy.GetParent(Dbid) == INDEX_NONE)
+            Order.Add(Dbid);
+    }
+    for (int32 i = 0; i < Order.Num(); ++i)
+    {
+        Order.Append(NodeHierarchy.GetChildren(Order[i]));
+    }
+    TArray<int32> NumDescendants;
+    NumDescendants.SetNumZeroed(TotalNumNodes);
+    for (int32 i = Order.Num() - 1; i >= 0; --i)
+    {
+        int32 Dbid = Order[i];
+        int32 Parent = NodeHierarchy.GetParent(Dbid);
+        if (Parent != INDEX_NONE)
+        {
+            NumDescendants[Parent] += NumDescendants[Dbid] + 1;
+            SubtreeBounds[Parent] += SubtreeBounds[Dbid];
+        }
+    }
+
+    //子树过小的节点不值得合并,过大的节点构建代理的开销过高
+    int32 MinDescendants = FMath::Max(1, GXSPHLODMinDescendants);
+    int32 MaxDescendants = FMath::Max(MinDescendants, GXSPHLODMaxDescendants);
+    int32 Resolution = FMath::Max(2, GXSPHLODResolution);
+    ProxyInfos.Empty();
+    for (int32 Dbid = 0; Dbid < TotalNumNodes; ++Dbid)
+    {
+        if (NumDescendants[Dbid] < MinDescendants || NumDescendants[Dbid] > MaxDescendants || !SubtreeBounds[Dbid].IsValid)
+            continue;
+
+        FProxyInfo& ProxyInfo = ProxyInfos.Add(Dbid);
+        ProxyInfo.Bounds = SubtreeBounds[Dbid];
+        ProxyInfo.CellSize = FMath::Max(SubtreeBounds[Dbid].GetSize().GetMax() / Resolution, 1.0f);
+        //简化结果大致是包围盒表面上的网格单元,每个单元两个三角形
+        FVector3f NumCells = (SubtreeBounds[Dbid].GetSize() / ProxyInfo.CellSize).ComponentMax(FVector3f::OneVector);
+        ProxyInfo.EstimatedNumTriangles = 4 * (int64)(NumCells.X * NumCells.Y + NumCells.Y * NumCells.Z + NumCells.Z * NumCells.X);
+    }
+    UE_LOG(LogXSPLoader, Display, TEXT("建立节点层级: %d个节点, %d个代理, 耗时%.1fms"), TotalNumNodes, ProxyInfos.Num(), (FPlatformTime::Seconds() - BeginTime) * 1000.0);
+}
+
+bool FXSPLoader::LoadProxyCache(int32 ProxyDbid, Body_info& OutBody) const
+{
+    if (ProxyCacheDir.IsEmpty())
+        return false;
+
+    FString CacheFilePath = FPaths::Combine(ProxyCacheDir, FString::Printf(TEXT("%d.bin"), ProxyDbid));
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*CacheFilePath, FILEREAD_Silent));
+    if (!Reader)
+        return false;
+
+    uint32 Magic = 0;
+    int32 Version = 0;
+    int32 NumFloats = 0;
+    *Reader << Magic;
+    *Reader << Version;
+    if (Magic != ProxyCacheMagic || Version != ProxyCacheVersion)
+    {
+        UE_LOG(LogXSPLoader, Warning, TEXT("代理缓存无效: %s"), *CacheFilePath);
+        return false;
+    }
+    Reader->Serialize(OutBody.material, sizeof(OutBody.material));
+    *Reader << NumFloats;
+    if (Reader->IsError() || NumFloats < 0 || NumFloats % 9 != 0 || (int64)NumFloats * (int64)sizeof(float) > Reader->TotalSize() - Reader->Tell())
+    {
+        UE_LOG(LogXSPLoader, Warning, TEXT("代理缓存无效: %s"), *CacheFilePath);
+        return false;
+    }
+
+    OutBody.dbid = ProxyDbid;
+    OutBody.parentdbid = -1;
+    OutBody.level = 0;
+    OutBody.name = "HLOD";
+    FMemory::Memzero(OutBody.box, sizeof(OutBody.box));
+    OutBody.fragment.Reset();
+    if (NumFloats > 0)
+    {
+        Body_info& Fragment = OutBody.fragment.AddDefaulted_GetRef();
+        Fragment.name = "Mesh";
+        FMemory::Memcpy(Fragment.material, OutBody.material, sizeof(Fragment.material));
+        Fragment.vertices.resize(NumFloats);
+        Reader->Serialize(Fragment.vertices.data(), NumFloats * sizeof(float));
+    }
+    return !Reader->IsError();
+}
+
+void FXSPLoader::SaveProxyCache(int32 ProxyDbid, const Body_info& Body) const
+{
+    if (ProxyCacheDir.IsEmpty())
+        return;
+
+    FString CacheFilePath = FPaths::Combine(ProxyCacheDir, FString::Printf(TEXT("%d.bin"), ProxyDbid));
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*CacheFilePath));
+    if (!Writer)
+    {
+        UE_LOG(LogXSPLoader, Warning, TEXT("写入代理缓存失败: %s"), *CacheFilePath);
+        return;
+    }
+
+    uint32 Magic = ProxyCacheMagic;
+    int32 Version = ProxyCacheVersion;
+    float Material[4];
+    FMemory::Memcpy(Material, Body.material, sizeof(Material));
+    int32 NumFloats = Body.fragment.Num() > 0 ? (int32)Body.fragment[0].vertices.size() : 0;
+    *Writer << Magic;
+    *Writer << Version;
+    Writer->Serialize(Material, sizeof(Material));
+    *Writer << NumFloats;
+    if (NumFloats > 0)
+    {
+        Writer->Serialize(const_cast<float*>(Body.fragment[0].vertices.data()), NumFloats * sizeof(float));
+    }
+}
+
+void FXSPLoader::CancelRequest(FStaticMeshRequest* Request, EXSPLoadStage Stage)
+{
+    {
+        FScopeLock Lock(&RequestCS);
+        Request->Invalidate();
+    }
+    RecordCancelled(Stage);
+    MarkReleasable(Request);
+}
+
+void FXSPLoader::MarkReleasable(FStaticMeshRequest* Request)
+{
+    if (!Request->TrySetReleasable())
+        return;
+
+    //无锁压入可释放链表,压入成功后本线程不再访问Request
+    FStaticMeshRequest* Head = ReleasableListHead.load();
+    do
+    {
+        Request->NextReleasable = Head;
+    } while (!ReleasableListHead.compare_exchange_weak(Head, Request));
+}
+
+void FXSPLoader::DispatchNewRequests(uint64 InFrameNumber)
+{
+    //收到新请求的工作线程,分发结束后将其唤醒
+    TBitArray<> DispatchedWorkers(false, LoadWorkers.Num());
+
+    //轮流分发到各工作线程,与请求所属的源文件无关,负载不均时由工作线程之间的窃取来平衡
+    auto DispatchToRequestQueue = [this, &DispatchedWorkers](int32 Dbid, FStaticMeshRequest* Request) {
+        Request->QueuedCycles = FPlatformTime::Cycles64();
+        for (int32 Attempt = 0; Attempt < LoadWorkers.Num(); ++Attempt)
+        {
+            int32 WorkerIndex = NextLoadWorker;
+            NextLoadWorker = (NextLoadWorker + 1) % LoadWorkers.Num();
+            if (LoadWorkers[WorkerIndex]->Enqueue(Request))
+            {
+                DispatchedWorkers[WorkerIndex] = true;
+                return;
+            }
+        }
+
+        //全部工作线程的队列都已满,放弃该请求,外部在之后的帧中重新请求时会创建新的请求
+        Request->Invalidate();
+        NumDroppedRequests.fetch_add(1);
+        MarkReleasable(Request);
+        };
+
+    //批量取出本帧之前收到的全部请求参数,每批只加一次锁
+    uint32 NumNewRequests = 0;
+    FXSPMeshRequest Batch[256];
+    int32 NumDequeued = 0;
+    while ((NumDequeued = NewRequestRing.DequeueBatch(Batch, UE_ARRAY_COUNT(Batch))) > 0)
+    {
+        FScopeLock Lock(&RequestCS);
+        for (int32 i = 0; i < NumDequeued; ++i)
         {
-            //新请求,为其创建静态网格对象
-            TempRequest->StaticMesh = TStrongObjectPtr<UStaticMesh>(NewObject<UStaticMesh>());
-            TempRequest->LastUpdateFrameNumber = InFrameNumber;
+            const FXSPMeshRequest& Params = Batch[i];
+            if (Params.Dbid < 0 || Params.Dbid >= TotalNumNodes)
+                continue;
+
+            int32 SlotIndex = GetSlotIndex(Params);
+            FStaticMeshRequest*& Slot = RequestSlots[SlotIndex];
+            if (nullptr != Slot && !Slot->IsReleasable())
+            {
+                //已有请求,就地更新时间戳/优先级/目标组件,排队中的请求在其所在的堆中调整位置
+                Slot->bValid = true;
+                Slot->TargetComponent = Params.TargetMeshComponent;
+                UpdateRequestKey(Slot, InFrameNumber, Params.Priority);
+                continue;
+            }
+
+            //槽位中没有活动请求,创建新请求;静态网格对象在构建开始前才从对象池取出,旧请求仍在可释放链表中,由ReleaseRequests释放
+            FStaticMeshRequest* Request = new FStaticMeshRequest(SlotIndex, Params.Priority, Params.TargetMeshComponent);
+            NumNewRequests++;
+            if (nullptr == Slot)
+            {
+                INC_DWORD_STAT(STAT_XSPNumLiveRequests);
+            }
+            Request->LastUpdateFrameNumber = InFrameNumber;
             //根据Dbid分发到相应的请求队列
-            DispatchToRequestQueue(Dbid, TempRequest);
-            //加入到总Map
-            AllRequestMap.Emplace(Dbid, TempRequest);
+            DispatchToRequestQueue(SlotIndex, Request);
+            //放入槽位
+            Slot = Request;
+        }
+    }
+    SET_DWORD_STAT(STAT_XSPNumNewRequests, NumNewRequests);
+
+    for (TConstSetBitIterator<> It(DispatchedWorkers); It; ++It)
+    {
+        LoadWorkers[It.GetIndex()]->Wakeup();
+    }
+}
+
+void FXSPLoader::UpdateRequestKey(FStaticMeshRequest* Request, uint64 InFrameNumber, float Priority)
+{
+    //排序键未变时堆的顺序不受影响
+    if (Request->LastUpdateFrameNumber.load(std::memory_order_relaxed) == InFrameNumber && Request->Priority.load(std::memory_order_relaxed) == Priority)
+        return;
+
+    //在堆中时持有该堆的锁写入并调整位置;出堆也需要这把锁,加锁后再确认仍在该堆中
+    if (FRequestQueue* Queue = Request->OwnerQueue.load())
+    {
+        FRequestQueue::FScopedLock Lock(*Queue);
+        Request->LastUpdateFrameNumber = InFrameNumber;
+        Request->Priority = Priority;
+        if (Request->OwnerQueue.load() == Queue)
+        {
+            Queue->Reorder(Request);
+        }
+        return;
+    }
+
+    Request->LastUpdateFrameNumber = InFrameNumber;
+    Request->Priority = Priority;
+    //写入期间恰好被加载线程入堆时,入堆读到的排序键可能不完整,再调整一次
+    if (FRequestQueue* Queue = Request->OwnerQueue.load())
+    {
+        FRequestQueue::FScopedLock Lock(*Queue);
+        if (Request->OwnerQueue.load() == Queue)
+        {
+            Queue->Reorder(Request);
         }
     }
 }
 
-void FXSPLoader::ProcessMergeRequests(float AvailableTime)
+void FXSPLoader::DrainMergeRing()
 {
-    int64 BeginTicks = FDateTime::Now().GetTicks();
-    while (!MergeRequestQueue.IsEmpty())
+    MergeRequestQueue.AddFrom(MergeRing);
+    if (NumMergeOverflow.load(std::memory_order_relaxed) == 0)
+        return;
+
+    FScopeLock Lock(&MergeOverflowCS);
+    for (FStaticMeshRequest* Request : MergeOverflow)
+    {
+        MergeRequestQueue.Add(Request);
+    }
+    MergeOverflow.Reset();
+    NumMergeOverflow.store(0);
+}
+
+void FXSPLoader::ProcessMergeRequests(float DeltaTime)
+{
+    //合并的个数由帧时间预算根据实测的单次合并耗时自适应决定
+    DrainMergeRing();
+
+    const bool bBatchMerge = GXSPBatchMerge > 0;
+    MergeBudget.BeginFrame(DeltaTime);
+    while (MergeBudget.CanMergeMore() && !MergeRequestQueue.IsEmpty())
     {
         FStaticMeshRequest* Request;
         MergeRequestQueue.TakeFirst(Request);
         if (nullptr != Request)
         {
-            Request->TargetComponent->SetMaterial(0, CreateMaterialInstanceDynamic(SourceMaterial.Get(), Request->Color, Request->Roughness));
-            Request->TargetComponent->SetStaticMesh(Request->StaticMesh.Get());
-            Request->StaticMesh->RemoveFromRoot();
-            Request->TargetComponent->RegisterComponent();
+            double BeginTime = FPlatformTime::Seconds();
 
-            UE_LOG(LogXSPLoader, Display, TEXT("完成加载: %d"), Request->Dbid);
-            GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, FString::Printf(TEXT("完成加载: %d"), Request->Dbid));
+            //未指定目标组件的请求,复用该节点仍常驻的组件,或从组件池中取出
+            bool bPooled = false;
+            if (nullptr == Request->TargetComponent)
+            {
+                const FXSPResidencyBudget::FResidentMesh* Resident = ResidencyBudget.FindResident(Request->Dbid);
+                if (nullptr != Resident && Resident->bPooled && Resident->Component.IsValid())
+                {
+                    Request->TargetComponent = Resident->Component.Get();
+                }
+                else
+                {
+                    SCOPE_CYCLE_COUNTER(STAT_XSPAcquireComponent);
+                    Request->TargetComponent = ComponentPool.Acquire();
+                }
+                bPooled = true;
+            }
+            if (nullptr == Request->TargetComponent)
+            {
+                //没有设置组件池的Owner
+                CancelRequest(Request, EXSPLoadStage::Merge);
+                continue;
+            }
+
+            {
+                SCOPE_CYCLE_COUNTER(STAT_XSPMergeCreateMaterial);
+                Request->TargetComponent->SetMaterial(0, CreateMaterialInstanceDynamic(SourceMaterial.Get(), Request->Color, Request->Roughness));
+            }
+            {
+                SCOPE_CYCLE_COUNTER(STAT_XSPMergeSetStaticMesh);
+                Request->TargetComponent->SetStaticMesh(Request->StaticMesh);
+                Request->StaticMesh->RemoveFromRoot();
+            }
+            if (bBatchMerge)
+            {
+                //未注册的组件上述设置只修改属性,注册推迟到本帧全部合并之后
+                MergeRegistrar.Add(Request->TargetComponent);
+                MergeBudget.RecordPendingMerge(FPlatformTime::Seconds() - BeginTime);
+            }
+            else
+            {
+                {
+                    SCOPE_CYCLE_COUNTER(STAT_XSPMergeRegisterComponent);
+                    if (!Request->TargetComponent->IsRegistered())
+                        Request->TargetComponent->RegisterComponent();
+                }
+                MergeBudget.RecordMerge(FPlatformTime::Seconds() - BeginTime);
+            }
+
+            NumCompletedRequests.fetch_add(1);
+            INC_DWORD_STAT_BY(STAT_XSPNumCompletedTriangles, Request->StaticMesh->GetNumTriangles(0));
+            //同一节点已常驻的旧网格体不再被其组件使用时归还到对象池
+            if (const FXSPResidencyBudget::FResidentMesh* Resident = ResidencyBudget.FindResident(Request->Dbid))
+            {
+                UStaticMesh* OldMesh = Resident->StaticMesh.Get();
+                UStaticMeshComponent* OldComponent = Resident->Component.Get();
+                if (nullptr != OldMesh && OldMesh != Request->StaticMesh && (nullptr == OldComponent || OldComponent->GetStaticMesh() != OldMesh))
+                    MeshPool.Release(OldMesh);
+            }
+            ResidencyBudget.AddResident(Request->Dbid, Request->TargetComponent, Request->StaticMesh, FXSPResidencyBudget::EstimateMeshBytes(Request->StaticMesh), FrameNumber.load(), bPooled);
+            //逐个合并的日志只在Verbose时格式化,完成数见stat XSPLoader的Completed Requests
+            if (IsProxySlot(Request->Dbid))
+                UE_LOG(LogXSPLoader, Verbose, TEXT("完成加载代理: %d"), Request->Dbid - TotalNumNodes);
+            else
+                UE_LOG(LogXSPLoader, Verbose, TEXT("完成加载: %d"), Request->Dbid);
 
+            //网格体已交给组件,释放请求时不归还
+            Request->StaticMesh = nullptr;
             //标记为可释放
-            Request->SetReleasable();
+            MarkReleasable(Request);
+        }
+    }
+    if (MergeRegistrar.Num() > 0)
+    {
+        double BeginTime = FPlatformTime::Seconds();
+        {
+            SCOPE_CYCLE_COUNTER(STAT_XSPMergeRegisterComponent);
+            MergeRegistrar.Flush();
+        }
+        MergeBudget.RecordBatch(FPlatformTime::Seconds() - BeginTime);
+    }
+    MergeBudget.EndFrame();
+}
+
+void FXSPLoader::MarkNodesVisible(TArrayView<const int32> Dbids)
+{
+    check(IsInGameThread());
+    uint64 CurrentFrameNumber = FrameNumber.load();
+    for (int32 Dbid : Dbids)
+    {
+        ResidencyBudget.MarkVisible(Dbid, CurrentFrameNumber);
+    }
+}
+
+void FXSPLoader::SetComponentOwner(AActor* Owner)
+{
+    check(IsInGameThread());
+    ComponentPool.Init(Owner);
+}
+
+UStaticMeshComponent* FXSPLoader::GetNodeComponent(int32 Dbid) const
+{
+    if (Dbid < 0 || Dbid >= TotalNumNodes)
+        return nullptr;
+    const FXSPResidencyBudget::FResidentMesh* Resident = ResidencyBudget.FindResident(Dbid);
+    return nullptr != Resident ? Resident->Component.Get() : nullptr;
+}
+
+UStaticMeshComponent* FXSPLoader::GetProxyComponent(int32 Dbid) const
+{
+    if (Dbid < 0 || Dbid >= TotalNumNodes)
+        return nullptr;
+    const FXSPResidencyBudget::FResidentMesh* Resident = ResidencyBudget.FindResident(TotalNumNodes + Dbid);
+    return nullptr != Resident ? Resident->Component.Get() : nullptr;
+}
+
+bool FXSPLoader::PickNode(const FVector& Origin, const FVector& Direction, float MaxDistance, FXSPPickHit& OutHit)
+{
+    SCOPE_CYCLE_COUNTER(STAT_XSPPick);
+
+    OutHit = FXSPPickHit();
+    if (!bInitialized)
+        return false;
+
+    const FVector3f RayOrigin(Origin);
+    const FVector3f RayDirection(Direction.GetSafeNormal());
+    if (RayDirection.IsZero())
+        return false;
+
+    //射线经过的节点,按进入包围盒的距离从近到远排序
+    TArray<FXSPBVHRayHit> Candidates;
+    NodeBVH.QueryRay(RayOrigin, RayDirection, MaxDistance, Candidates);
+
+    const uint64 CurrentFrameNumber = FrameNumber.load(std::memory_order_relaxed);
+    float BestDistance = MaxDistance;
+    FVector3f BestNormal = FVector3f::ZeroVector;
+    int32 NumBuildsIssued = 0;
+
+    FScopeLock Lock(&PickCS);
+    for (const FXSPBVHRayHit& Candidate : Candidates)
+    {
+        //之后的节点都比已有的命中远
+        if (Candidate.Distance > BestDistance)
+            break;
+        if (Blacklist.Test(Candidate.Index))
+            continue;
+
+        FPickMesh* PickMesh = PickMeshes.Find(Candidate.Index);
+        if (nullptr == PickMesh || !PickMesh->BVH.IsValid())
+        {
+            //较近的节点尚无三角形数据,本次结果可能不是最近的命中;每次拾取只为最近的若干个节点分发构建,拾取的响应优先于网格体的构建
+            OutHit.bPending = true;
+            if (nullptr == PickMesh && NumBuildsIssued < GXSPPickMaxBuildsPerQuery && CanRetryPickMeshBuild(Candidate.Index, CurrentFrameNumber))
+            {
+                IssuePickMeshBuild(Candidate.Index, EQueuedWorkPriority::High);
+                NumBuildsIssued++;
+            }
+            continue;
+        }
+
+        PickMesh->LastPickFrame = CurrentFrameNumber;
+        int32 Triangle;
+        float Distance;
+        FVector3f Normal;
+        if (PickMesh->BVH->RayCast(RayOrigin, RayDirection, BestDistance, Triangle, Distance, &Normal))
+        {
+            BestDistance = Distance;
+            BestNormal = Normal;
+            OutHit.Dbid = Candidate.Index;
+            OutHit.TriangleIndex = Triangle;
         }
+    }
+
+    if (OutHit.Dbid == INDEX_NONE)
+        return false;
+
+    OutHit.Distance = BestDistance;
+    OutHit.Location = Origin + FVector(RayDirection) * BestDistance;
+    OutHit.Normal = FVector(BestNormal);
+    return true;
+}
+
+bool FXSPLoader::VisitNodeTriangles(int32 Dbid, int32 MaxTriangles, int32& InOutNumBuilds, TFunctionRef<void(TArrayView<const FVector3f>)> Visitor)
+{
+    if (!bInitialized || Dbid < 0 || Dbid >= TotalNumNodes || Blacklist.Test(Dbid))
+        return false;
+
+    //预估不小于实际的三角形数,超出上限的节点不必读取源文件构建
+    const FSourceData* SourceData = FindSourceData(Dbid);
+    if (SourceData->NumTrianglesList[Dbid - SourceData->StartDbid] > MaxTriangles)
+        return false;
+
+    FScopeLock Lock(&PickCS);
+    FPickMesh* PickMesh = PickMeshes.Find(Dbid);
+    if (nullptr == PickMesh)
+    {
+        //遮挡体只是减少请求的优化,构建排在网格体构建之后
+        if (InOutNumBuilds > 0 && CanRetryPickMeshBuild(Dbid, FrameNumber.load(std::memory_order_relaxed)))
+        {
+            IssuePickMeshBuild(Dbid, EQueuedWorkPriority::Low);
+            InOutNumBuilds--;
+        }
+        return false;
+    }
+    if (!PickMesh->BVH.IsValid() || PickMesh->BVH->IsEmpty() || PickMesh->BVH->GetVertices().Num() / 3 > MaxTriangles)
+        return false;
+
+    //被访问的三角形与被拾取的一样计入最近使用,避免每帧用到的遮挡体被淘汰后反复构建
+    PickMesh->LastPickFrame = FrameNumber.load(std::memory_order_relaxed);
+    Visitor(PickMesh->BVH->GetVertices());
+    return true;
+}
+
+void FXSPLoader::IssuePickMeshBuild(int32 Dbid, EQueuedWorkPriority Priority)
+{
+    const FSourceData* SourceData = FindSourceData(Dbid);
+    check(nullptr != SourceData);
+
+    //先占住缓存中的位置,构建完成前再次拾取不会重复分发
+    PickMeshes.Add(Dbid);
+    NumInFlightPickBuilds.fetch_add(1);
+    (new FAutoDeleteAsyncTask<FBuildPickMeshTask>(this, Dbid, SourceData->FilePathName, SourceData->HeaderList[Dbid - SourceData->StartDbid]))
+        ->StartBackgroundTask(BuildThreadPool, Priority);
+}
+
+void FXSPLoader::FinishPickMesh(int32 Dbid, TUniquePtr<FXSPTriangleBVH> BVH)
+{
+    FScopeLock Lock(&PickCS);
+    //构建中的节点不会被淘汰,Reset也会等待构建任务结束
+    FPickMesh& PickMesh = PickMeshes.FindOrAdd(Dbid);
+    PickCacheBytes += BVH->GetAllocatedSize();
+    PickMesh.BVH = MoveTemp(BVH);
+    PickRetries.Remove(Dbid);
+}
+
+void FXSPLoader::RemovePickMesh(int32 Dbid)
+{
+    FScopeLock Lock(&PickCS);
+    PickMeshes.Remove(Dbid);
+}
+
+void FXSPLoader::FailPickMesh(int32 Dbid)
+{
+    FScopeLock Lock(&PickCS);
+    PickMeshes.Remove(Dbid);
+
+    //连续失败时退避的帧数加倍,源文件持续不可读时每帧的拾取和遮挡剔除不会反复读取
+    FPickRetry& Retry = PickRetries.FindOrAdd(Dbid);
+    const uint64 NumBackoffFrames = (uint64)FMath::Max(1, GXSPPickRetryFrames) << FMath::Min(Retry.NumFailures, 6);
+    Retry.NumFailures++;
+    Retry.RetryFrame = FrameNumber.load(std::memory_order_relaxed) + NumBackoffFrames;
+}
+
+bool FXSPLoader::CanRetryPickMeshBuild(int32 Dbid, uint64 CurrentFrameNumber) const
+{
+    const FPickRetry* Retry = PickRetries.Find(Dbid);
+    return nullptr == Retry || CurrentFrameNumber >= Retry->RetryFrame;
+}
+
+void FXSPLoader::EvictPickMeshes()
+{
+    const SIZE_T BudgetBytes = (SIZE_T)FMath::Max(0, GXSPPickCacheMB) * 1024 * 1024;
+    FScopeLock Lock(&PickCS);
+    if (PickCacheBytes <= BudgetBytes)
+        return;
+
+    //按最近被拾取的帧号从旧到新丢弃,降到预算的3/4以下,避免每帧都排序;构建中的不丢弃
+    TArray<TPair<uint64, int32>> EvictionOrder;
+    EvictionOrder.Reserve(PickMeshes.Num());
+    for (const auto& Pair : PickMeshes)
+    {
+        if (Pair.Value.BVH.IsValid())
+        {
+            EvictionOrder.Emplace(Pair.Value.LastPickFrame, Pair.Key);
+        }
+    }
+    EvictionOrder.Sort([](const TPair<uint64, int32>& Lhs, const TPair<uint64, int32>& Rhs) { return Lhs.Key < Rhs.Key; });
 
-        if ((float)(FDateTime::Now().GetTicks() - BeginTicks) / ETimespan::TicksPerSecond >= AvailableTime)
+    const SIZE_T TargetBytes = BudgetBytes / 4 * 3;
+    for (const TPair<uint64, int32>& Entry : EvictionOrder)
+    {
+        if (PickCacheBytes <= TargetBytes)
             break;
+        FPickMesh& PickMesh = PickMeshes.FindChecked(Entry.Value);
+        PickCacheBytes -= PickMesh.BVH->GetAllocatedSize();
+        PickMeshes.Remove(Entry.Value);
+    }
+}
+
+void FXSPLoader::MarkProxiesVisible(TArrayView<const int32> Dbids)
+{
+    check(IsInGameThread());
+    uint64 CurrentFrameNumber = FrameNumber.load();
+    for (int32 Dbid : Dbids)
+    {
+        if (Dbid >= 0 && Dbid < TotalNumNodes)
+            ResidencyBudget.MarkVisible(TotalNumNodes + Dbid, CurrentFrameNumber);
+    }
+}
+
+void FXSPLoader::EvictMeshes(uint64 InFrameNumber)
+{
+    SCOPE_CYCLE_COUNTER(STAT_XSPEvictMeshes);
+
+    TArray<FXSPResidencyBudget::FResidentMesh> Evictions;
+    ResidencyBudget.CollectEvictions(InFrameNumber, Evictions);
+    for (const FXSPResidencyBudget::FResidentMesh& Mesh : Evictions)
+    {
+        //组件仍在使用被淘汰的网格体时才清空,组件回到未加载的状态,材质实例在之后的GC中回收;取自组件池的组件归还到池中
+        UStaticMeshComponent* Component = Mesh.Component.Get();
+        if (nullptr != Component && Component->GetStaticMesh() == Mesh.StaticMesh.Get())
+        {
+            if (Mesh.bPooled)
+            {
+                ComponentPool.Release(Component);
+            }
+            else
+            {
+                Component->SetStaticMesh(nullptr);
+                Component->SetMaterial(0, nullptr);
+            }
+        }
+        //此时已没有组件使用该网格体,归还到对象池,渲染资源在下一帧释放
+        MeshPool.Release(Mesh.StaticMesh.Get());
     }
+
+    INC_DWORD_STAT_BY(STAT_XSPNumEvicted, Evictions.Num());
+    SET_DWORD_STAT(STAT_XSPNumResident, ResidencyBudget.GetNumResident());
+    SET_FLOAT_STAT(STAT_XSPResidentMB, ResidencyBudget.GetResidentBytes() / (1024.0 * 1024.0));
+    SET_FLOAT_STAT(STAT_XSPMemoryBudgetMB, FXSPResidencyBudget::GetBudgetBytes() / (1024.0 * 1024.0));
+    SET_DWORD_STAT(STAT_XSPNumPooledInUse, ComponentPool.GetNumInUse());
+    SET_DWORD_STAT(STAT_XSPNumPooledFree, ComponentPool.GetNumFree());
+    SET_DWORD_STAT(STAT_XSPNumPooledMeshesFree, MeshPool.GetNumFree());
+    SET_DWORD_STAT(STAT_XSPNumPooledMeshesReleasing, MeshPool.GetNumReleasing());
+    SET_DWORD_STAT(STAT_XSPNumPooledMeshesCreated, MeshPool.GetNumCreated());
 }
 
 void FXSPLoader::ReleaseRequests()
 {
-    for (TMap<int32, FStaticMeshRequest*>::TIterator Itr(AllRequestMap); Itr; ++Itr)
+    //一次性取走整个可释放链表,开销只与本帧可释放的请求数有关
+    FStaticMeshRequest* Request = ReleasableListHead.exchange(nullptr);
+    uint32 NumReleased = 0;
+    while (nullptr != Request)
     {
-        if (Itr.Value()->IsReleasable())
+        FStaticMeshRequest* Next = Request->NextReleasable;
+        if (RequestSlots.IsValidIndex(Request->Dbid) && RequestSlots[Request->Dbid] == Request)
         {
-            //唯一释放请求的位置
-            delete Itr.Value();
-            Itr.RemoveCurrent();
+            RequestSlots[Request->Dbid] = nullptr;
+            DEC_DWORD_STAT(STAT_XSPNumLiveRequests);
         }
+        //未合并的请求(被取消、丢弃或过期)归还其静态网格对象
+        MeshPool.Release(Request->StaticMesh);
+        //唯一释放请求的位置
+        delete Request;
+        Request = Next;
+        NumReleased++;
     }
+    SET_DWORD_STAT(STAT_XSPNumReleased, NumReleased);
 }
\ No newline at end of file
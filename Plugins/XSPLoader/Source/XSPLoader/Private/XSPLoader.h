@@ -4,8 +4,25 @@
 
 #include "CoreMinimal.h"
 #include "IXSPLoader.h"
+#include "XSPBuildBudget.h"
+#include "XSPConcurrentBitArray.h"
+#include "XSPLockFreeQueue.h"
+#include "XSPSourceRouting.h"
+#include "XSPBoundsBVH.h"
+#include "XSPMergeBudget.h"
+#include "XSPResidencyBudget.h"
+#include "XSPNodeHierarchy.h"
+#include "XSPComponentPool.h"
+#include "XSPBatchRegistrar.h"
+#include "XSPStaticMeshPool.h"
+#include "XSPTriangleBVH.h"
+#include "HAL/Event.h"
+#include "Misc/IQueuedWork.h"
+#include <atomic>
 #include <fstream>
 
+class FQueuedThreadPool;
+
 struct Body_info
 {
 	int dbid;  //结构体的索引就是dbid 从0开始
@@ -35,17 +52,43 @@ struct Header_info
 	int verticeslength;  //vertices头文件大小
 };
 
+//请求流转的阶段,用于统计各阶段被取消的请求
+enum class EXSPLoadStage : uint8
+{
+	Load,	//在加载队列中排队或读取节点数据
+	Build,	//在线程池中构建网格体
+	Merge,	//在合并队列中等待设置到组件
+	Num
+};
+
+struct FRequestQueue;
+
 struct FStaticMeshRequest
 {
+	//超过此帧数未被再次请求的请求视为不再需要
+	static constexpr uint64 NumFramesToStale = 10;
+
+	//节点的dbid;代理请求为请求槽位的编号,即TotalNumNodes + 子树根节点的dbid
 	int32 Dbid;
-	float Priority;
-	uint64 LastUpdateFrameNumber;
-	bool bValid;
+	//优先级与时间戳是请求队列的排序键,由Game线程经FXSPLoader::UpdateRequestKey就地更新
+	std::atomic<float> Priority;
+	std::atomic<uint64> LastUpdateFrameNumber;
+	std::atomic<bool> bValid;
 	FLinearColor Color;
 	float Roughness;
 	UStaticMeshComponent* TargetComponent;
-	TStrongObjectPtr<UStaticMesh> StaticMesh;
+	//构建开始前才从网格体对象池取出,由池保持引用;合并后交给组件,否则在请求释放时归还
+	UStaticMesh* StaticMesh;
 	std::atomic_bool bReleasable;
+	//显式取消(如Reset),各阶段在工作间隙检查
+	std::atomic_bool bCancelled;
+	//投入加载队列的时刻,用于统计排队等待时长
+	uint64 QueuedCycles;
+	//可释放链表的侵入式指针,只在FXSPLoader::MarkReleasable和ReleaseRequests中访问
+	FStaticMeshRequest* NextReleasable;
+	//所在的请求堆及在堆中的位置,不在堆中时为空;OwnerQueue只在所在堆的锁内修改,HeapIndex只在其锁内访问
+	std::atomic<FRequestQueue*> OwnerQueue;
+	int32 HeapIndex;
 
 	FStaticMeshRequest(int32 InDbid, float InPriority, UStaticMeshComponent* InTargetComponent)
 		: Dbid(InDbid)
@@ -55,89 +98,229 @@ struct FStaticMeshRequest
 		, Color(1, 1, 1)
 		, Roughness(1)
 		, TargetComponent(InTargetComponent)
+		, StaticMesh(nullptr)
 		, bReleasable(false)
+		, bCancelled(false)
+		, QueuedCycles(0)
+		, NextReleasable(nullptr)
+		, OwnerQueue(nullptr)
+		, HeapIndex(INDEX_NONE)
 	{}
 
 	void Invalidate();
 
 	bool IsValid() { return bValid; }
 
-	void SetReleasable() { bReleasable.store(true); }
-
-	void ResetReleasable() { bReleasable.store(false); }
+	//置为可释放,返回是否由本次调用置位(只有置位者可以将其加入可释放链表)
+	bool TrySetReleasable() { return !bReleasable.exchange(true); }
 
 	bool IsReleasable() { return bReleasable; }
 
 	bool IsRequestCurrent(uint64 FrameNumber);
+
+	void Cancel() { bCancelled.store(true); }
+
+	//协作式取消检查,无锁,可在任意线程调用
+	bool ShouldCancel(uint64 FrameNumber) const
+	{
+		return bCancelled.load(std::memory_order_relaxed) || (FrameNumber - LastUpdateFrameNumber.load(std::memory_order_relaxed) >= NumFramesToStale);
+	}
+};
+
+//协作式取消令牌,绑定一个请求和加载器的帧号,在读取/细分/构建的各步骤之间检查
+struct FXSPCancellationToken
+{
+	FXSPCancellationToken(const FStaticMeshRequest& InRequest, const std::atomic<uint64>& InFrameNumber)
+		: Request(InRequest)
+		, FrameNumber(InFrameNumber)
+	{}
+
+	bool IsCancelled() const { return Request.ShouldCancel(FrameNumber.load(std::memory_order_relaxed)); }
+
+private:
+	const FStaticMeshRequest& Request;
+	const std::atomic<uint64>& FrameNumber;
 };
 
 struct FSortRequestFunctor
 {
 	bool operator() (FStaticMeshRequest* Lhs, FStaticMeshRequest* Rhs) const
 	{
-		if (Lhs->LastUpdateFrameNumber > Rhs->LastUpdateFrameNumber) return true;
-		else if (Lhs->LastUpdateFrameNumber < Rhs->LastUpdateFrameNumber) return false;
-		else return (Lhs->Priority > Rhs->Priority);
+		uint64 LhsFrameNumber = Lhs->LastUpdateFrameNumber.load(std::memory_order_relaxed);
+		uint64 RhsFrameNumber = Rhs->LastUpdateFrameNumber.load(std::memory_order_relaxed);
+		if (LhsFrameNumber > RhsFrameNumber) return true;
+		else if (LhsFrameNumber < RhsFrameNumber) return false;
+		else return (Lhs->Priority.load(std::memory_order_relaxed) > Rhs->Priority.load(std::memory_order_relaxed));
 	}
 };
 
+//阶段之间传递请求的无锁环形队列
+typedef TXSPBoundedMpscQueue<FStaticMeshRequest*> FRequestMpscRing;
+typedef TXSPBoundedSpscQueue<FStaticMeshRequest*> FRequestSpscRing;
+
+//按FSortRequestFunctor排序的请求堆,本身不加锁:待合并请求堆只由Game线程访问,加载工作线程的请求堆由其QueueCS保护
+//其他线程经由环形队列交付请求,消费线程用AddFrom批量取出后入堆
+//堆中的请求记录自己的位置,Game线程就地更新排序键后在该堆的锁内只上移或下移这一个请求,O(logN),不重建整个堆
 struct FRequestQueue
 {
 public:
+	//持有队列的锁,CS为空(只由Game线程访问的队列)时不加锁
+	struct FScopedLock
+	{
+		explicit FScopedLock(FRequestQueue& Queue) : CS(Queue.CS) { if (CS) CS->Lock(); }
+		~FScopedLock() { if (CS) CS->Unlock(); }
+		FCriticalSection* CS;
+	};
+
 	void Add(FStaticMeshRequest* Request);
 
-	void AddNoLock(FStaticMeshRequest* Request);
+	//取出环形队列中的全部请求并入堆,返回取出的个数
+	template<typename RingType>
+	int32 AddFrom(RingType& Ring)
+	{
+		FStaticMeshRequest* Batch[64];
+		int32 NumTotal = 0;
+		int32 NumDequeued = 0;
+		while ((NumDequeued = Ring.DequeueBatch(Batch, UE_ARRAY_COUNT(Batch))) > 0)
+		{
+			for (int32 i = 0; i < NumDequeued; ++i)
+			{
+				Add(Batch[i]);
+			}
+			NumTotal += NumDequeued;
+		}
+		return NumTotal;
+	}
 
 	void TakeFirst(FStaticMeshRequest*& Request);
 
-	bool IsEmpty();
+	//堆中请求的排序键变化后调整其位置,调用者须持有队列的锁
+	void Reorder(FStaticMeshRequest* Request);
+
+	bool IsEmpty() const { return RequestList.IsEmpty(); }
 
 	void Empty();
 
 	typedef TArray<FStaticMeshRequest*> FRequestList;
-	void Swap(FRequestList& RequestList);
-
 	FRequestList RequestList;
-	FCriticalSection RequestListCS;
+
+	//上次剔除过期请求时的帧号
+	uint64 SweepFrameNumber = 0;
+
+	//队列所处的阶段,队列中剔除的过期请求计入该阶段的取消数
+	EXSPLoadStage Stage = EXSPLoadStage::Load;
 
 	class FXSPLoader* Loader;
+
+	//保护本队列的锁,由所属的加载工作线程设置
+	FCriticalSection* CS = nullptr;
+
+private:
+	//把请求放到堆中的Index处并记录位置
+	void Place(int32 Index, FStaticMeshRequest* Request);
+	//上移或下移,返回是否移动过
+	bool SiftUp(int32 Index);
+	void SiftDown(int32 Index);
+	//移出堆顶,不检查是否过期
+	FStaticMeshRequest* PopTop();
+	//剔除过期请求后重建堆
+	void SweepStale(uint64 FrameNumber);
 };
 
+//构建任务持有节点数据,任务结束(完成或取消)时释放
+//代理请求没有缓存时节点数据为空,由任务自身读取子树的全部节点并简化合并出节点数据,不占用加载线程
 class FBuildStaticMeshTask : public FNonAbandonableTask
 {
 public:
-	FBuildStaticMeshTask(FStaticMeshRequest* InRequest, Body_info* InNodeData, FRequestQueue& MergeQueue)
-		: Request(InRequest)
+	FBuildStaticMeshTask(class FXSPLoader* InLoader, FStaticMeshRequest* InRequest, Body_info* InNodeData, const FXSPBuildCost& InCost)
+		: Loader(InLoader)
+		, Request(InRequest)
 		, NodeData(InNodeData)
-		, MergeRequestQueue(MergeQueue)
+		, Cost(InCost)
+	{
+	}
+	~FBuildStaticMeshTask()
 	{
+		delete NodeData;
 	}
 
 	void DoWork();
 
-	TStatId GetStatId() const
+	FORCEINLINE TStatId GetStatId() const
 	{
-		return TStatId();
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FBuildStaticMeshTask, STATGROUP_ThreadPoolAsyncTasks);
 	}
 
 private:
+	//读取并简化代理的子树,子树中没有网格体时bOutEmpty为true,被取消、读取失败或没有网格体时返回false
+	bool BuildProxyNodeData(const FXSPCancellationToken& CancellationToken, bool& bOutEmpty);
+
+	class FXSPLoader* Loader;
 	FStaticMeshRequest* Request;
 	Body_info* NodeData;
-	FRequestQueue& MergeRequestQueue;
+	//准入时占用的构建预算,任务结束时归还
+	FXSPBuildCost Cost;
+};
+
+//拾取用的节点三角形BVH构建任务,读取源文件所需的信息在创建时复制,不依赖加载线程和源文件元数据的生命周期
+class FBuildPickMeshTask : public FNonAbandonableTask
+{
+public:
+	FBuildPickMeshTask(class FXSPLoader* InLoader, int32 InDbid, const FString& InFilePathName, const Header_info& InHeader)
+		: Loader(InLoader)
+		, Dbid(InDbid)
+		, FilePathName(InFilePathName)
+		, Header(InHeader)
+	{
+	}
+
+	void DoWork();
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FBuildPickMeshTask, STATGROUP_ThreadPoolAsyncTasks);
+	}
+
+private:
+	class FXSPLoader* Loader;
+	int32 Dbid;
+	FString FilePathName;
+	Header_info Header;
+};
+
+//一个源文件的元数据,在FXSPLoader::Init时读入,之后只读
+struct FXSPSourceData
+{
+	int32 StartDbid = 0;
+	int32 Count = 0;
+	FString FilePathName;
+	//节点头信息和包围盒
+	TArray<Header_info> HeaderList;
+	TArray<FBox3f> BoundsList;
+	//按fragment头信息预估的节点三角形数
+	TArray<int32> NumTrianglesList;
 };
 
-class FXSPFileLoadRunnalbe : public FRunnable
+/**
+ * 加载工作线程
+ * 所有工作线程共同服务全部源文件:Game线程把新请求轮流分发到各线程的请求队列,
+ * 线程自己的队列为空时从其他线程的队列中窃取优先级最高的请求,因此请求集中在少数源文件时负载仍然均衡
+ * 每个线程按需打开自己的源文件流,上级节点数据由所有线程共享
+ */
+class FXSPLoadWorker : public FRunnable
 {
 public:
-	FXSPFileLoadRunnalbe(class FXSPLoader* Owner, std::fstream& InFileStream, int32 InStartDbid, int32 InCount, FRequestQueue& LoadQueue, FRequestQueue& MergeQueue)
+	FXSPLoadWorker(class FXSPLoader* Owner, int32 InWorkerIndex, int32 InboxCapacity)
 		: Loader(Owner)
-		, FileStream(InFileStream)
-		, StartDbid(InStartDbid)
-		, Count(InCount)
-		, LoadRequestQueue(LoadQueue)
-		, MergeRequestQueue(MergeQueue)
-	{}
-	~FXSPFileLoadRunnalbe();
+		, WorkerIndex(InWorkerIndex)
+		, WakeupEvent(FPlatformProcess::GetSynchEventFromPool(false))
+	{
+		Inbox.Init(InboxCapacity);
+		RequestQueue.Loader = Owner;
+		RequestQueue.Stage = EXSPLoadStage::Load;
+		RequestQueue.CS = &QueueCS;
+	}
+	~FXSPLoadWorker();
 
 	virtual bool Init() override
 	{
@@ -145,28 +328,61 @@ public:
 		return true;
 	}
 	virtual uint32 Run() override;
-	virtual void Stop() override
-	{
-		bStopRequested = true;
-	}
+	virtual void Stop() override;
 	virtual void Exit() override
 	{
 		bIsRunning = false;
 	}
 
+	//唤醒等待请求的线程
+	void Wakeup();
+
+	//Game线程分发请求,队列满时返回false
+	bool Enqueue(FStaticMeshRequest* Request) { return Inbox.TryEnqueue(Request); }
+
+	//其他线程从本线程的队列中窃取一个请求
+	FStaticMeshRequest* Steal();
+
+	//队列中的请求数(近似值),用于选择窃取对象
+	int32 GetNumQueued() const { return NumQueued.load(std::memory_order_relaxed); }
+
+private:
+	//将Inbox中的新请求移入请求队列,返回移入的个数
+	int32 DrainInbox();
+	FStaticMeshRequest* TakeFirst();
+	void ProcessRequest(FStaticMeshRequest* Request);
+	//代理请求:读取缓存,没有缓存时分发到构建线程池读取子树的全部节点并简化合并
+	void ProcessProxyRequest(FStaticMeshRequest* Request);
+	//取得构建预算后将节点数据和请求分发到构建线程池,节点数据由构建任务持有;代理请求的节点数据可为空,由构建任务生成
+	void DispatchBuild(FStaticMeshRequest* Request, Body_info* NodeDataPtr, const FXSPBuildCost& BuildCost, const FXSPCancellationToken& CancellationToken);
+	std::fstream* GetFileStream(const FXSPSourceData* SourceData);
+
 private:
 	TAtomic<bool> bIsRunning = false;
 	TAtomic<bool> bStopRequested = false;
 
 	class FXSPLoader* Loader = nullptr;
+	int32 WorkerIndex = 0;
 
-	std::fstream& FileStream;
-	int32 StartDbid = 0;
-	int32 Count = 0;
-	FRequestQueue& LoadRequestQueue;
-	FRequestQueue& MergeRequestQueue;
-	TArray<Header_info> HeaderList;
-	TMap<int32, Body_info*> BodyMap;
+	//Game线程(唯一生产者)到本线程(唯一消费者)的请求队列
+	FRequestSpscRing Inbox;
+	//本线程的请求堆,可被其他线程窃取,由QueueCS保护
+	FRequestQueue RequestQueue;
+	FCriticalSection QueueCS;
+	std::atomic<int32> NumQueued{ 0 };
+
+	//本线程打开的源文件流,超过上限时关闭最久未用的
+	struct FOpenFile
+	{
+		TUniquePtr<std::fstream> FileStream;
+		uint64 LastUseTick = 0;
+	};
+	TMap<const FXSPSourceData*, FOpenFile> OpenFiles;
+	uint64 FileUseTick = 0;
+	static constexpr int32 MaxOpenFiles = 32;
+
+	//请求队列为空且无处窃取时线程阻塞在此事件上,由DispatchNewRequests、其他线程或Stop触发
+	FEvent* WakeupEvent = nullptr;
 };
 
 class FXSPLoader : public IXSPLoader
@@ -178,60 +394,261 @@ public:
 	virtual bool Init(const TArray<FString>& FilePathNameArray) override;
 	virtual void Reset() override;
 	virtual void RequestStaticMesh(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent) override;
+	virtual void RequestStaticMeshes(TArrayView<const FXSPMeshRequest> Requests) override;
+	virtual int32 GetNumNodes() const override { return TotalNumNodes; }
+	virtual bool GetNodeBoundingBox(int32 Dbid, FBox& OutBox) const override;
+	virtual const FXSPBoundsBVH& GetNodeBVH() const override { return NodeBVH; }
+	virtual void MarkNodesVisible(TArrayView<const int32> Dbids) override;
+	virtual int32 GetNodeParent(int32 Dbid) const override { return NodeHierarchy.GetParent(Dbid); }
+	virtual TArrayView<const int32> GetNodeChildren(int32 Dbid) const override { return NodeHierarchy.GetChildren(Dbid); }
+	virtual bool GetProxyInfo(int32 Dbid, FBox& OutBounds, float& OutError) const override;
+	virtual void RequestProxyMesh(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent) override;
+	virtual void MarkProxiesVisible(TArrayView<const int32> Dbids) override;
+	virtual void SetComponentOwner(AActor* Owner) override;
+	virtual UStaticMeshComponent* GetNodeComponent(int32 Dbid) const override;
+	virtual UStaticMeshComponent* GetProxyComponent(int32 Dbid) const override;
+	virtual bool PickNode(const FVector& Origin, const FVector& Direction, float MaxDistance, FXSPPickHit& OutHit) override;
+	virtual bool VisitNodeTriangles(int32 Dbid, int32 MaxTriangles, int32& InOutNumBuilds, TFunctionRef<void(TArrayView<const FVector3f>)> Visitor) override;
 
 	void Tick(float DeltaTime);
 
+	//记录一次请求在加载队列中的等待时长,由加载线程调用
+	void RecordQueueWait(uint64 WaitCycles);
+
 private:
 	void DispatchNewRequests(uint64 InFrameNumber);
-	void ProcessMergeRequests(float AvailableTime);
+	void PublishStats();
+	void MarkReleasable(FStaticMeshRequest* Request);
+	//将请求置为失效并可释放,计入相应阶段的取消数
+	void CancelRequest(FStaticMeshRequest* Request, EXSPLoadStage Stage);
+	void RecordCancelled(EXSPLoadStage Stage) { NumCancelledRequests[(int32)Stage].fetch_add(1); }
+	void ProcessMergeRequests(float DeltaTime);
+	//取出MergeRing和溢出列表中的全部请求放入MergeRequestQueue,只在Game线程调用
+	void DrainMergeRing();
+	//超出内存预算时清空最久未可见的组件的网格体
+	void EvictMeshes(uint64 InFrameNumber);
 	void ReleaseRequests();
+	//网格体对象池的空闲目标个数,由r.XSP.MeshPoolSize或构建预算决定
+	int32 GetMeshPoolTarget() const;
+	//分发节点三角形BVH的构建任务,调用者须持有PickCS
+	void IssuePickMeshBuild(int32 Dbid, EQueuedWorkPriority Priority);
+	//构建任务完成后存入节点的三角形BVH,可由任意线程调用
+	void FinishPickMesh(int32 Dbid, TUniquePtr<FXSPTriangleBVH> BVH);
+	//节点没有网格体时移除占位,可由任意线程调用
+	void RemovePickMesh(int32 Dbid);
+	//读取源文件失败时移除占位,并记录之后允许重新构建的帧号,可由任意线程调用
+	void FailPickMesh(int32 Dbid);
+	//读取失败的节点是否已过了退避的帧数,调用者须持有PickCS
+	bool CanRetryPickMeshBuild(int32 Dbid, uint64 CurrentFrameNumber) const;
+	//超出r.XSP.PickCacheMB时丢弃最久未被射线经过的节点三角形BVH
+	void EvictPickMeshes();
 	void AddToBlacklist(int32 Dbid);
 	void ResetInternal();
+	void LoadBlacklist();
+	void SaveBlacklist();
+	//读取缓存或由全部节点的包围盒构建NodeBVH,SourceHash为空时不使用缓存
+	void BuildNodeBVH(const FString& SourceHash);
+	//由全部节点的上级建立NodeHierarchy,并确定哪些节点的子树有代理
+	void BuildNodeHierarchy();
+	//代理缓存的读写,ProxyCacheDir为空时不使用缓存;可由任意线程调用
+	bool LoadProxyCache(int32 ProxyDbid, Body_info& OutBody) const;
+	void SaveProxyCache(int32 ProxyDbid, const Body_info& Body) const;
 
 private:
 	bool bInitialized = false;
 	std::atomic<uint64> FrameNumber;
 
-	//每个源文件对应一个读取线程和一个请求队列
-	struct FSourceData
+	//全部源文件的节点总数,dbid的取值范围为[0, TotalNumNodes)
+	int32 TotalNumNodes = 0;
+
+	//请求槽位的编号:[0, TotalNumNodes)为节点自身,[TotalNumNodes, 2 * TotalNumNodes)为以该节点为根的子树的代理
+	int32 GetNumSlots() const { return TotalNumNodes * 2; }
+	int32 GetSlotIndex(const FXSPMeshRequest& Params) const { return Params.bProxy ? TotalNumNodes + Params.Dbid : Params.Dbid; }
+	bool IsProxySlot(int32 SlotIndex) const { return SlotIndex >= TotalNumNodes; }
+
+	typedef FXSPSourceData FSourceData;
+	TArray<FSourceData*> SourceDataList;
+
+	//dbid到SourceDataList序号的路由表,在Init时建立
+	FXSPSourceRoutingTable SourceRouting;
+
+	FSourceData* FindSourceData(int32 Dbid) const;
+
+	//全部节点包围盒的空间索引,在Init时建立,之后只读
+	FXSPBoundsBVH NodeBVH;
+
+	//节点的上下级关系,在Init时建立,之后只读
+	FXSPNodeHierarchy NodeHierarchy;
+
+	//有代理的子树,按根节点的dbid索引,在Init时建立,之后只读
+	struct FProxyInfo
 	{
-		int32 StartDbid;
-		int32 Count;
-		std::fstream FileStream;
-		FXSPFileLoadRunnalbe* FileLoadRunnable = nullptr;
-		FRunnableThread* LoadThread = nullptr;
-		FRequestQueue LoadRequestQueue;
+		//子树全部节点的包围盒
+		FBox3f Bounds;
+		//简化时聚类的网格边长,由包围盒尺寸和r.XSP.HLODResolution决定
+		float CellSize;
+		//简化结果的预估三角形数,用于在读取子树前占用构建预算
+		int64 EstimatedNumTriangles;
 	};
-	TArray<FSourceData*> SourceDataList;
+	TMap<int32, FProxyInfo> ProxyInfos;
+	//代理缓存目录,由源文件和r.XSP.HLODResolution决定,为空表示不缓存
+	FString ProxyCacheDir;
+
+	//加载工作线程,由r.XSP.LoadThreads决定个数,与源文件数无关
+	TArray<FXSPLoadWorker*> LoadWorkers;
+	TArray<FRunnableThread*> LoadThreads;
+	//轮流分发新请求的下一个工作线程
+	int32 NextLoadWorker = 0;
+
+	//从其他工作线程窃取请求,优先选择排队最多的
+	FStaticMeshRequest* StealRequest(const FXSPLoadWorker* Thief);
+	//唤醒除Source以外的全部工作线程,使空闲的线程来窃取
+	void WakeLoadWorkers(const FXSPLoadWorker* Source);
+
+	//作为上级节点读入的节点数据,按dbid索引,用于材质继承;所有线程共享,由ParentBodyCacheCS保护
+	//超出r.XSP.ParentBodyCacheMB时丢弃最久未用的,使用者持有共享指针,丢弃后仍可安全访问
+	typedef TSharedPtr<const Body_info, ESPMode::ThreadSafe> FBodyRef;
+	struct FParentBody
+	{
+		FBodyRef Body;
+		SIZE_T NumBytes = 0;
+		//最近一次被查找的帧号
+		uint64 LastUseFrame = 0;
+	};
+	TMap<int32, FParentBody> ParentBodyCache;
+	SIZE_T ParentBodyCacheBytes = 0;
+	FCriticalSection ParentBodyCacheCS;
+	//查找或读入上级节点数据,读取失败时返回空
+	FBodyRef FindOrReadParentBody(const FSourceData* SourceData, int32 ParentDbid, std::fstream& FileStream);
+	FBodyRef FindParentBody(int32 Dbid);
+	//超出r.XSP.ParentBodyCacheMB时丢弃最久未用的上级节点数据
+	void EvictParentBodies();
+	//新读入的节点尝试继承同一文件中上级节点的材质数据
+	void InheritParentMaterial(const FSourceData* SourceData, Body_info& Node, std::fstream& FileStream);
+	//读取子树的全部节点,简化合并为一个节点数据,被取消或读取失败时返回false;在构建线程池中执行,按需打开自己的源文件流
+	bool BuildProxyBody(int32 ProxyDbid, Body_info& OutBody, const FXSPCancellationToken& CancellationToken);
+	//无网格体的节点请求,置为无效并加入黑名单
+	void DiscardEmptyRequest(FStaticMeshRequest* Request);
 
 	// 材质模板
 	TStrongObjectPtr<UMaterialInterface> SourceMaterial;
 
+	//构建任务(多个生产者)交付给Game线程(唯一消费者)的待合并请求,Game线程每帧取出后放入MergeRequestQueue
+	FRequestMpscRing MergeRing;
+	//MergeRing满时构建任务将请求放入溢出列表后立即返回,不占用线程池线程等待;Game线程取出MergeRing后一并取出
+	TArray<FStaticMeshRequest*> MergeOverflow;
+	FCriticalSection MergeOverflowCS;
+	std::atomic<int32> NumMergeOverflow{ 0 };
+	//只由Game线程访问的待合并请求堆
 	FRequestQueue MergeRequestQueue;
 
+	//各环形队列的容量,满时:新请求被丢弃(外部下一帧会重新请求),加载请求被取消,待合并请求放入溢出列表;LoadRingCapacity为每个工作线程的容量
+	static constexpr int32 NewRequestRingCapacity = 1 << 16;
+	static constexpr int32 LoadRingCapacity = 1 << 14;
+	static constexpr int32 MergeRingCapacity = 1 << 12;
+
 	/**
 	Request的生命周期:
-	1.在FXSPLoader::Tick中被创建,根据dbid投入到相应文件对应的LoadRequestQueue	--Game线程
-	2.在FXSPFileLoadRunnalbe::Run中被从LoadRequestQueue中取出,(读取节点数据后)填充材质数据,与节点数据一起被封装为一个构建任务分发到线程池	--每个文件对应一个工作线程
-	3.在FBuildStaticMeshTask::DoWork中完成网格体构建后,被投入到全局的MergeRequestQueue	--线程池任意线程
-	4.在FXSPLoader::Tick中被从MergeRequestQueue中取出,将静态网格设置给组件对象,之后Request被销毁	--Game线程
-	在整个声明周期中,无论Request如何流转,AllRequestMap一直持有Request,最终必须确保Request在Game线程释放
+	1.在FXSPLoader::Tick中被创建,轮流投入到各加载工作线程的Inbox	--Game线程
+	2.在FXSPLoadWorker::Run中经请求队列排序后取出(或被其他工作线程窃取),(读取节点数据后)填充材质数据,与节点数据一起被封装为一个构建任务分发到线程池	--加载工作线程
+	3.在FBuildStaticMeshTask::DoWork中完成网格体构建后,被投入到全局的MergeRing(满时投入MergeOverflow)	--线程池任意线程
+	4.在FXSPLoader::Tick中经MergeRequestQueue排序后取出,将静态网格设置给组件对象,之后Request被销毁	--Game线程
+	在整个声明周期中,无论Request如何流转,RequestSlots一直持有Request,最终必须确保Request在Game线程释放
+	Request一旦被置为可释放就不再被任何线程修改,并被加入可释放链表,由ReleaseRequests在Game线程统一释放;
+	同一dbid的新请求到来时若旧Request已可释放,则创建新的Request替换槽位中的旧Request
 	*/
 
-	//全部请求的Map,只在Game线程访问
-	TMap<int32, FStaticMeshRequest*> AllRequestMap;
+	//请求槽位,长度为GetNumSlots(),只在Game线程访问
+	TArray<FStaticMeshRequest*> RequestSlots;
+
+	//可释放请求的侵入式无锁链表(多生产者,Game线程一次性取走全部)
+	std::atomic<FStaticMeshRequest*> ReleasableListHead{ nullptr };
 
-	//没有网格体的节点
-	TArray<int32> Blacklist;
-	FCriticalSection BlacklistCS;
+	//没有网格体的节点和代理,按槽位置位
+	FXSPConcurrentBitArray Blacklist;
 
-	//收集新请求的缓存数组,由外部调用线程和Game线程访问
-	TArray<FStaticMeshRequest*> CachedRequestArray;
-	FCriticalSection CachedRequestArrayCS;
+	//黑名单持久化文件,由源文件路径/大小/时间戳决定,为空表示不持久化
+	FString BlacklistFilePath;
 
-	//所有Request的可更新属性共享同一把锁
+	//收集请求参数的队列,外部任意线程写入,Game线程每帧取出;只有槽位中没有活动请求的dbid才会创建FStaticMeshRequest
+	TXSPBoundedMpscQueue<FXSPMeshRequest> NewRequestRing;
+
+	//所有Request的可更新属性共享同一把锁;需要同时持有请求堆的锁时先持有本锁
 	FCriticalSection RequestCS;
 
+	//就地更新请求的排序键,请求在某个请求堆中时在该堆的锁内更新并调整其位置;只在Game线程调用
+	void UpdateRequestKey(FStaticMeshRequest* Request, uint64 InFrameNumber, float Priority);
+
+	//请求排队等待时长的统计,加载线程写入,Game线程每帧汇总后清零
+	std::atomic<uint64> QueueWaitCyclesSum{ 0 };
+	std::atomic<uint64> QueueWaitCyclesMax{ 0 };
+	std::atomic<uint32> NumQueueWaits{ 0 };
+
+	//各阶段被取消的请求数和完成的请求数,Game线程每帧汇总后清零
+	std::atomic<uint32> NumCancelledRequests[(int32)EXSPLoadStage::Num] = {};
+	std::atomic<uint32> NumCompletedRequests{ 0 };
+	//新请求队列或加载队列已满而被丢弃的请求数
+	std::atomic<uint32> NumDroppedRequests{ 0 };
+	//被其他工作线程窃取的请求数
+	std::atomic<uint32> NumStolenRequests{ 0 };
+
+	//已分发到线程池尚未结束的构建任务数,Reset时需等待其归零
+	std::atomic<int32> NumInFlightBuilds{ 0 };
+
+	//构建网格体的专用线程池,在Init时按r.XSP.BuildThreads/r.XSP.BuildThreadPriority/r.XSP.BuildThreadStackSize创建
+	FQueuedThreadPool* BuildThreadPool = nullptr;
+	int32 NumBuildThreads = 0;
+
+	//线程池中排队尚未开始的构建任务数和正在执行的构建任务数
+	std::atomic<int32> NumQueuedBuilds{ 0 };
+	std::atomic<int32> NumBusyBuildThreads{ 0 };
+
+	//构建任务的执行时长累计,Game线程每帧汇总后清零,用于计算线程池利用率
+	std::atomic<uint64> BuildBusyCycles{ 0 };
+	uint64 LastPublishStatsCycles = 0;
+
+	//构建任务的准入控制,预算用尽时加载线程在分发前等待
+	FXSPBuildBudget BuildBudget;
+
+	//合并到场景的帧时间预算,只在Game线程访问
+	FXSPMergeBudget MergeBudget;
+
+	//已设置到组件上的网格体的常驻内存预算,只在Game线程访问
+	FXSPResidencyBudget ResidencyBudget;
+
+	//未指定目标组件的请求所用的组件池,只在Game线程访问
+	FXSPComponentPool ComponentPool;
+
+	//本帧合并的组件在全部设置好后一起注册,只在Game线程访问
+	FXSPBatchRegistrar MergeRegistrar;
+
+	//请求构建时取用的静态网格对象池,加载线程取出,Game线程补充和归还
+	FXSPStaticMeshPool MeshPool;
+
+	//拾取用的节点三角形BVH缓存,按dbid索引,由PickCS保护
+	struct FPickMesh
+	{
+		//构建完成前为空;读取失败或没有网格体时不保留条目,读取失败的退避记录在PickRetries中
+		TUniquePtr<FXSPTriangleBVH> BVH;
+		//最近一次被拾取射线经过的帧号
+		uint64 LastPickFrame = 0;
+	};
+	TMap<int32, FPickMesh> PickMeshes;
+	//读取源文件失败的节点的退避状态,由PickCS保护,构建成功后移除
+	struct FPickRetry
+	{
+		int32 NumFailures = 0;
+		uint64 RetryFrame = 0;
+	};
+	TMap<int32, FPickRetry> PickRetries;
+	SIZE_T PickCacheBytes = 0;
+	FCriticalSection PickCS;
+
+	//已分发到线程池尚未结束的三角形BVH构建任务数,Reset时需等待其归零
+	std::atomic<int32> NumInFlightPickBuilds{ 0 };
+
 	friend struct FRequestQueue;
-	friend class FXSPFileLoadRunnalbe;
+	friend class FXSPLoadWorker;
+	friend class FBuildStaticMeshTask;
+	friend class FBuildPickMeshTask;
 };
@@ -0,0 +1,250 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/UniquePtr.h"
+#include <atomic>
+
+/**
+ * 定长的无锁多生产者单消费者环形队列
+ * 每个槽位带一个序号,生产者以CAS抢占写入位置,消费者按序号判断槽位是否已写完,入队/出队均不加锁
+ * 容量在Init时确定并向上取整为2的幂,队列满时TryEnqueue返回false,由调用方决定丢弃或重试
+ * Init不是线程安全的,只能在没有其他线程访问时调用;Dequeue/DequeueBatch/IsEmpty只能由唯一的消费者线程调用
+ */
+template<typename T>
+class TXSPBoundedMpscQueue
+{
+public:
+	void Init(int32 InCapacity)
+	{
+		check(InCapacity > 0);
+		Capacity = (int32)FMath::RoundUpToPowerOfTwo(InCapacity);
+		Mask = Capacity - 1;
+		Cells = MakeUnique<FCell[]>(Capacity);
+		for (int32 i = 0; i < Capacity; ++i)
+		{
+			Cells[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+		EnqueuePos.store(0, std::memory_order_relaxed);
+		DequeuePos = 0;
+	}
+
+	int32 GetCapacity() const { return Capacity; }
+
+	//任意线程调用
+	bool TryEnqueue(const T& Item)
+	{
+		uint64 Pos = EnqueuePos.load(std::memory_order_relaxed);
+		FCell* Cell = nullptr;
+		for (;;)
+		{
+			Cell = &Cells[Pos & Mask];
+			int64 Diff = (int64)Cell->Sequence.load(std::memory_order_acquire) - (int64)Pos;
+			if (Diff == 0)
+			{
+				if (EnqueuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (Diff < 0)
+			{
+				//槽位尚未被消费者释放,队列已满
+				return false;
+			}
+			else
+			{
+				Pos = EnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+		Cell->Item = Item;
+		Cell->Sequence.store(Pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	//任意线程调用,按块一次CAS占用连续的多个槽位,返回入队的个数,队列满时剩余的不入队
+	int32 TryEnqueueBatch(const T* Items, int32 Count)
+	{
+		int32 NumEnqueued = 0;
+		while (NumEnqueued < Count)
+		{
+			int32 ChunkSize = FMath::Min(Count - NumEnqueued, FMath::Min(MaxReserveChunk, Capacity));
+			uint64 Pos = 0;
+			if (!TryReserve(ChunkSize, Pos))
+			{
+				//剩余空间不足一块,逐个入队直到队列满
+				if (ChunkSize == 1 || !TryEnqueue(Items[NumEnqueued]))
+					break;
+				NumEnqueued++;
+				continue;
+			}
+			for (int32 i = 0; i < ChunkSize; ++i)
+			{
+				FCell& Cell = Cells[(Pos + i) & Mask];
+				Cell.Item = Items[NumEnqueued + i];
+				Cell.Sequence.store(Pos + i + 1, std::memory_order_release);
+			}
+			NumEnqueued += ChunkSize;
+		}
+		return NumEnqueued;
+	}
+
+	bool Dequeue(T& OutItem)
+	{
+		FCell& Cell = Cells[DequeuePos & Mask];
+		if (Cell.Sequence.load(std::memory_order_acquire) != DequeuePos + 1)
+			return false;
+		OutItem = MoveTemp(Cell.Item);
+		Cell.Sequence.store(DequeuePos + Capacity, std::memory_order_release);
+		DequeuePos++;
+		return true;
+	}
+
+	//一次取出至多MaxCount个,返回取出的个数
+	int32 DequeueBatch(T* OutItems, int32 MaxCount)
+	{
+		int32 Count = 0;
+		while (Count < MaxCount && Dequeue(OutItems[Count]))
+		{
+			Count++;
+		}
+		return Count;
+	}
+
+	bool IsEmpty() const
+	{
+		return Cells[DequeuePos & Mask].Sequence.load(std::memory_order_acquire) != DequeuePos + 1;
+	}
+
+private:
+	struct FCell
+	{
+		std::atomic<uint64> Sequence;
+		T Item;
+	};
+
+	static constexpr int32 MaxReserveChunk = 64;
+
+	//占用从Pos开始的Count个连续槽位
+	//消费者按顺序释放槽位,因此最后一个槽位已释放时之前的槽位也都已释放
+	bool TryReserve(int32 Count, uint64& OutPos)
+	{
+		uint64 Pos = EnqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			uint64 LastPos = Pos + Count - 1;
+			int64 Diff = (int64)Cells[LastPos & Mask].Sequence.load(std::memory_order_acquire) - (int64)LastPos;
+			if (Diff == 0)
+			{
+				if (EnqueuePos.compare_exchange_weak(Pos, Pos + Count, std::memory_order_relaxed))
+				{
+					OutPos = Pos;
+					return true;
+				}
+			}
+			else if (Diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				Pos = EnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	TUniquePtr<FCell[]> Cells;
+	int32 Capacity = 0;
+	uint64 Mask = 0;
+
+	//生产者与消费者的位置放在不同的缓存行,避免伪共享
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> EnqueuePos{ 0 };
+	alignas(PLATFORM_CACHE_LINE_SIZE) uint64 DequeuePos = 0;
+};
+
+/**
+ * 定长的无锁单生产者单消费者环形队列
+ * 生产者和消费者各自缓存对方的位置,只在缓存的位置显示队列满/空时才重新读取,绝大多数入队/出队不触及对方的缓存行
+ * 容量在Init时确定并向上取整为2的幂,队列满时TryEnqueue返回false
+ * Init不是线程安全的;TryEnqueue只能由唯一的生产者线程调用,Dequeue/DequeueBatch/IsEmpty只能由唯一的消费者线程调用
+ */
+template<typename T>
+class TXSPBoundedSpscQueue
+{
+public:
+	void Init(int32 InCapacity)
+	{
+		check(InCapacity > 0);
+		Capacity = (int32)FMath::RoundUpToPowerOfTwo(InCapacity);
+		Mask = Capacity - 1;
+		Items = MakeUnique<T[]>(Capacity);
+		Tail.store(0, std::memory_order_relaxed);
+		Head.store(0, std::memory_order_relaxed);
+		CachedHead = 0;
+		CachedTail = 0;
+	}
+
+	int32 GetCapacity() const { return Capacity; }
+
+	bool TryEnqueue(const T& Item)
+	{
+		uint64 CurrentTail = Tail.load(std::memory_order_relaxed);
+		if (CurrentTail - CachedHead >= (uint64)Capacity)
+		{
+			CachedHead = Head.load(std::memory_order_acquire);
+			if (CurrentTail - CachedHead >= (uint64)Capacity)
+				return false;
+		}
+		Items[CurrentTail & Mask] = Item;
+		Tail.store(CurrentTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Dequeue(T& OutItem)
+	{
+		uint64 CurrentHead = Head.load(std::memory_order_relaxed);
+		if (CurrentHead == CachedTail)
+		{
+			CachedTail = Tail.load(std::memory_order_acquire);
+			if (CurrentHead == CachedTail)
+				return false;
+		}
+		OutItem = MoveTemp(Items[CurrentHead & Mask]);
+		Head.store(CurrentHead + 1, std::memory_order_release);
+		return true;
+	}
+
+	//一次取出至多MaxCount个,返回取出的个数;只发布一次消费位置
+	int32 DequeueBatch(T* OutItems, int32 MaxCount)
+	{
+		uint64 CurrentHead = Head.load(std::memory_order_relaxed);
+		CachedTail = Tail.load(std::memory_order_acquire);
+		int32 Count = (int32)FMath::Min<uint64>(CachedTail - CurrentHead, (uint64)FMath::Max(0, MaxCount));
+		for (int32 i = 0; i < Count; ++i)
+		{
+			OutItems[i] = MoveTemp(Items[(CurrentHead + i) & Mask]);
+		}
+		if (Count > 0)
+		{
+			Head.store(CurrentHead + Count, std::memory_order_release);
+		}
+		return Count;
+	}
+
+	bool IsEmpty() const
+	{
+		return Head.load(std::memory_order_relaxed) == Tail.load(std::memory_order_acquire);
+	}
+
+private:
+	TUniquePtr<T[]> Items;
+	int32 Capacity = 0;
+	uint64 Mask = 0;
+
+	//生产者一侧:写入位置和缓存的消费位置
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> Tail{ 0 };
+	uint64 CachedHead = 0;
+
+	//消费者一侧:消费位置和缓存的写入位置
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> Head{ 0 };
+	uint64 CachedTail = 0;
+};
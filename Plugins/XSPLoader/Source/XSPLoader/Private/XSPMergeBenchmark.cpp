@@ -0,0 +1,116 @@
+#include "XSPBatchRegistrar.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/World.h"
+#include "Engine/StaticMesh.h"
+#include "GameFramework/Actor.h"
+#include "Components/StaticMeshComponent.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPMergeBenchmark, Log, All);
+
+/**
+ * 合并到场景的基准测试
+ * 在当前World中对N个组件分别测量逐个注册(设置网格体和材质、挂接、注册)与全部设置好后批量注册的Game线程耗时
+ */
+namespace
+{
+    TArray<UStaticMeshComponent*> CreateComponents(AActor* Owner, int32 NumComponents)
+    {
+        TArray<UStaticMeshComponent*> Components;
+        Components.Reserve(NumComponents);
+        for (int32 i = 0; i < NumComponents; ++i)
+        {
+            UStaticMeshComponent* Component = NewObject<UStaticMeshComponent>(Owner);
+            Component->SetMobility(EComponentMobility::Movable);
+            Component->SetRelativeLocation(FVector(i % 100, (i / 100) % 100, i / 10000) * 200.0);
+            Components.Add(Component);
+        }
+        return Components;
+    }
+
+    void DestroyComponents(TArray<UStaticMeshComponent*>& Components)
+    {
+        for (UStaticMeshComponent* Component : Components)
+        {
+            Component->DestroyComponent();
+        }
+        Components.Empty();
+    }
+
+    void BenchmarkMerge(const TArray<FString>& Args, UWorld* World)
+    {
+        if (nullptr == World)
+        {
+            UE_LOG(LogXSPMergeBenchmark, Warning, TEXT("合并测试需要在有World时运行"));
+            return;
+        }
+
+        UStaticMesh* Mesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+        if (nullptr == Mesh)
+        {
+            UE_LOG(LogXSPMergeBenchmark, Warning, TEXT("找不到测试用的网格体"));
+            return;
+        }
+        UMaterialInterface* Material = Mesh->GetMaterial(0);
+
+        TArray<int32> Counts;
+        for (const FString& Arg : Args)
+        {
+            Counts.Add(FMath::Max(1, FCString::Atoi(*Arg)));
+        }
+        if (Counts.Num() == 0)
+        {
+            Counts = { 1000, 10000 };
+        }
+
+        FActorSpawnParameters SpawnParameters;
+        SpawnParameters.ObjectFlags |= RF_Transient;
+        AActor* Owner = World->SpawnActor<AActor>(SpawnParameters);
+        USceneComponent* Root = NewObject<USceneComponent>(Owner, TEXT("Root"));
+        Root->SetMobility(EComponentMobility::Movable);
+        Owner->SetRootComponent(Root);
+        Root->RegisterComponent();
+
+        for (int32 NumComponents : Counts)
+        {
+            //组件的创建不计入,只测量加入场景的部分
+            TArray<UStaticMeshComponent*> Components = CreateComponents(Owner, NumComponents);
+            double BeginTime = FPlatformTime::Seconds();
+            for (UStaticMeshComponent* Component : Components)
+            {
+                Component->SetStaticMesh(Mesh);
+                Component->SetMaterial(0, Material);
+                Component->AttachToComponent(Root, FAttachmentTransformRules::KeepRelativeTransform);
+                Component->RegisterComponent();
+            }
+            double IndividualTime = FPlatformTime::Seconds() - BeginTime;
+            DestroyComponents(Components);
+
+            Components = CreateComponents(Owner, NumComponents);
+            FXSPBatchRegistrar Registrar;
+            BeginTime = FPlatformTime::Seconds();
+            for (UStaticMeshComponent* Component : Components)
+            {
+                Component->SetStaticMesh(Mesh);
+                Component->SetMaterial(0, Material);
+                Component->SetupAttachment(Root);
+                Registrar.Add(Component);
+            }
+            double ConfigureTime = FPlatformTime::Seconds() - BeginTime;
+            Registrar.Flush();
+            double BatchTime = FPlatformTime::Seconds() - BeginTime;
+            DestroyComponents(Components);
+
+            UE_LOG(LogXSPMergeBenchmark, Display, TEXT("合并测试: %d个组件, 逐个注册%.2fms(%.2fus/个), 批量注册%.2fms(%.2fus/个, 其中设置%.2fms)"), NumComponents,
+                IndividualTime * 1000.0, IndividualTime * 1.0e6 / NumComponents, BatchTime * 1000.0, BatchTime * 1.0e6 / NumComponents, ConfigureTime * 1000.0);
+        }
+
+        Owner->Destroy();
+    }
+}
+
+static FAutoConsoleCommand CmdXSPBenchmarkMerge(
+    TEXT("XSP.BenchmarkMerge"),
+    TEXT("Measure game thread cost of adding static mesh components to the scene one by one against registering them in a batch.\n")
+    TEXT("Usage: XSP.BenchmarkMerge [NumComponents...=1000 10000]"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkMerge)
+);
@@ -0,0 +1,130 @@
+#include "XSPMergeBudget.h"
+#include "CoreGlobals.h"
+#include "HAL/IConsoleManager.h"
+
+static float GXSPTargetFrameTime = 16.6f;
+FAutoConsoleVariableRef CVarXSPTargetFrameTime(
+    TEXT("r.XSP.TargetFrameTime"),
+    GXSPTargetFrameTime,
+    TEXT("Target game thread frame time (ms) while merging loaded meshes into the scene.\n")
+    TEXT(" 16.6: default\n"),
+    ECVF_Default
+);
+
+static float GXSPMinMergeTime = 1.0f;
+FAutoConsoleVariableRef CVarXSPMinMergeTime(
+    TEXT("r.XSP.MinMergeTime"),
+    GXSPMinMergeTime,
+    TEXT("Min time (ms) per frame spent merging loaded meshes into the scene.\n")
+    TEXT(" 1.0: default\n"),
+    ECVF_Default
+);
+
+static float GXSPMaxMergeTime = 8.0f;
+FAutoConsoleVariableRef CVarXSPMaxMergeTime(
+    TEXT("r.XSP.MaxMergeTime"),
+    GXSPMaxMergeTime,
+    TEXT("Max time (ms) per frame spent merging loaded meshes into the scene.\n")
+    TEXT(" 8.0: default\n"),
+    ECVF_Default
+);
+
+namespace
+{
+    //预算和单次合并耗时的平滑系数
+    const double BudgetSmoothing = 0.25;
+    const double MergeCostSmoothing = 0.1;
+}
+
+FXSPMergeBudget::FXSPMergeBudget()
+{
+    FrameBudget = GXSPMinMergeTime / 1000.0;
+    ImpactSamples.Reserve(NumImpactSamples);
+}
+
+void FXSPMergeBudget::BeginFrame(float DeltaTime)
+{
+    //上一帧中合并以外的Game线程耗时,优先使用不含等待的Game线程时间
+    double GameThreadTime = GGameThreadTime > 0 ? FPlatformTime::ToSeconds(GGameThreadTime) : DeltaTime;
+    double OtherWorkTime = FMath::Max(0.0, GameThreadTime - LastFrameMergeTime);
+
+    double MinBudget = FMath::Max(0.0f, GXSPMinMergeTime) / 1000.0;
+    double MaxBudget = FMath::Max(GXSPMinMergeTime, GXSPMaxMergeTime) / 1000.0;
+    double DesiredBudget = FMath::Clamp(GXSPTargetFrameTime / 1000.0 - OtherWorkTime, MinBudget, MaxBudget);
+    FrameBudget = FMath::Lerp(FrameBudget, DesiredBudget, BudgetSmoothing);
+
+    FrameMergeTime = 0;
+    NumMergedThisFrame = 0;
+}
+
+bool FXSPMergeBudget::CanMergeMore() const
+{
+    if (NumMergedThisFrame == 0)
+        return true;
+    return FrameMergeTime + AverageMergeCost <= FrameBudget;
+}
+
+void FXSPMergeBudget::RecordMerge(double Seconds)
+{
+    FrameMergeTime += Seconds;
+    NumMergedThisFrame += 1;
+    AverageMergeCost = AverageMergeCost > 0 ? FMath::Lerp(AverageMergeCost, Seconds, MergeCostSmoothing) : Seconds;
+}
+
+void FXSPMergeBudget::RecordPendingMerge(double Seconds)
+{
+    FrameMergeTime += Seconds + AverageBatchCost;
+    NumMergedThisFrame += 1;
+    PendingMergeTime += Seconds;
+    NumPendingMerges += 1;
+    //还没有完成过一批时以设置组件的耗时作为初值
+    if (AverageMergeCost <= 0)
+        AverageMergeCost = Seconds;
+}
+
+void FXSPMergeBudget::RecordBatch(double Seconds)
+{
+    if (NumPendingMerges == 0)
+    {
+        FrameMergeTime += Seconds;
+        return;
+    }
+
+    FrameMergeTime += Seconds - AverageBatchCost * NumPendingMerges;
+    double BatchCost = Seconds / NumPendingMerges;
+    double MergeCost = (PendingMergeTime + Seconds) / NumPendingMerges;
+    AverageBatchCost = AverageBatchCost > 0 ? FMath::Lerp(AverageBatchCost, BatchCost, MergeCostSmoothing) : BatchCost;
+    AverageMergeCost = AverageMergeCost > 0 ? FMath::Lerp(AverageMergeCost, MergeCost, MergeCostSmoothing) : MergeCost;
+    PendingMergeTime = 0;
+    NumPendingMerges = 0;
+}
+
+void FXSPMergeBudget::EndFrame()
+{
+    LastFrameMergeTime = FrameMergeTime;
+
+    if (NumMergedThisFrame > 0)
+    {
+        float Sample = (float)(FrameMergeTime * 1000.0);
+        if (ImpactSamples.Num() < NumImpactSamples)
+        {
+            ImpactSamples.Add(Sample);
+        }
+        else
+        {
+            ImpactSamples[NextImpactSample] = Sample;
+        }
+        NextImpactSample = (NextImpactSample + 1) % NumImpactSamples;
+    }
+}
+
+float FXSPMergeBudget::GetFrameImpactPercentile(float Percentile) const
+{
+    if (ImpactSamples.Num() == 0)
+        return 0;
+
+    TArray<float> SortedSamples = ImpactSamples;
+    SortedSamples.Sort();
+    int32 Index = FMath::Clamp(FMath::FloorToInt(Percentile * (SortedSamples.Num() - 1) + 0.5f), 0, SortedSamples.Num() - 1);
+    return SortedSamples[Index];
+}
@@ -0,0 +1,110 @@
+#include "XSPStaticMeshPool.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/StaticMesh.h"
+#include "UObject/UObjectArray.h"
+#include "UObject/UObjectGlobals.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPMeshPoolBenchmark, Log, All);
+
+/**
+ * 静态网格对象池的压力测试
+ * 模拟请求突增:每轮在Game线程一次取得N个静态网格对象再全部放弃,分别测量直接NewObject和从对象池取出/归还的单轮耗时,
+ * 以及每轮之后强制GC的耗时和UObject个数的峰值增量;对象不做构建,只测量对象创建和回收本身的开销
+ */
+namespace
+{
+    struct FBurstStats
+    {
+        double SumBurst = 0;
+        double MaxBurst = 0;
+        double SumGC = 0;
+        int32 MaxObjectDelta = 0;
+
+        void Report(const TCHAR* Name, int32 NumBursts) const
+        {
+            UE_LOG(LogXSPMeshPoolBenchmark, Display, TEXT("\t%s: 单轮平均%.2fms 最大%.2fms, GC平均%.2fms, UObject峰值增量%d"), Name,
+                SumBurst * 1000.0 / NumBursts, MaxBurst * 1000.0, SumGC * 1000.0 / NumBursts, MaxObjectDelta);
+        }
+    };
+
+    int32 GetNumObjects()
+    {
+        return GUObjectArray.GetObjectArrayNumMinusAvailable();
+    }
+
+    double TimeGarbageCollection()
+    {
+        double BeginTime = FPlatformTime::Seconds();
+        CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+        return FPlatformTime::Seconds() - BeginTime;
+    }
+
+    void BenchmarkMeshPool(const TArray<FString>& Args)
+    {
+        int32 NumMeshes = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 10000;
+        int32 NumBursts = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 10;
+
+        //先清理之前的垃圾,避免计入第一轮
+        TimeGarbageCollection();
+        int32 BaseObjects = GetNumObjects();
+        TArray<UStaticMesh*> Meshes;
+        Meshes.Reserve(NumMeshes);
+
+        FBurstStats DirectStats;
+        for (int32 Burst = 0; Burst < NumBursts; ++Burst)
+        {
+            double BeginTime = FPlatformTime::Seconds();
+            for (int32 i = 0; i < NumMeshes; ++i)
+            {
+                Meshes.Add(NewObject<UStaticMesh>());
+            }
+            double BurstTime = FPlatformTime::Seconds() - BeginTime;
+            DirectStats.SumBurst += BurstTime;
+            DirectStats.MaxBurst = FMath::Max(DirectStats.MaxBurst, BurstTime);
+            DirectStats.MaxObjectDelta = FMath::Max(DirectStats.MaxObjectDelta, GetNumObjects() - BaseObjects);
+            //放弃全部对象,由GC回收
+            Meshes.Reset();
+            DirectStats.SumGC += TimeGarbageCollection();
+        }
+
+        FXSPStaticMeshPool Pool;
+        double BeginTime = FPlatformTime::Seconds();
+        Pool.Tick(NumMeshes, NumMeshes);
+        double PrewarmTime = FPlatformTime::Seconds() - BeginTime;
+
+        FBurstStats PoolStats;
+        for (int32 Burst = 0; Burst < NumBursts; ++Burst)
+        {
+            BeginTime = FPlatformTime::Seconds();
+            for (int32 i = 0; i < NumMeshes; ++i)
+            {
+                Meshes.Add(Pool.AcquireOrCreate());
+            }
+            double BurstTime = FPlatformTime::Seconds() - BeginTime;
+            PoolStats.SumBurst += BurstTime;
+            PoolStats.MaxBurst = FMath::Max(PoolStats.MaxBurst, BurstTime);
+            PoolStats.MaxObjectDelta = FMath::Max(PoolStats.MaxObjectDelta, GetNumObjects() - BaseObjects);
+            //未构建的对象直接回到空闲列表
+            for (UStaticMesh* StaticMesh : Meshes)
+            {
+                Pool.Release(StaticMesh);
+            }
+            Meshes.Reset();
+            PoolStats.SumGC += TimeGarbageCollection();
+        }
+        int32 NumMisses = Pool.GetNumMisses();
+        Pool.Reset();
+        TimeGarbageCollection();
+
+        UE_LOG(LogXSPMeshPoolBenchmark, Display, TEXT("静态网格对象池测试: 每轮%d个, %d轮, 预先创建耗时%.2fms, 池为空时新建%d次"), NumMeshes, NumBursts, PrewarmTime * 1000.0, NumMisses);
+        DirectStats.Report(TEXT("直接创建"), NumBursts);
+        PoolStats.Report(TEXT("对象池"), NumBursts);
+    }
+}
+
+static FAutoConsoleCommand CmdXSPBenchmarkMeshPool(
+    TEXT("XSP.BenchmarkMeshPool"),
+    TEXT("Stress bursts of static mesh object requests, creating them directly against taking them from the pool, and report burst and GC cost.\n")
+    TEXT("Usage: XSP.BenchmarkMeshPool [NumMeshes=10000] [NumBursts=10]"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkMeshPool)
+);
@@ -0,0 +1,72 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 节点的上下级关系
+ * 由各节点的parentdbid建立,子节点按CSR形式连续存放,查询某节点的全部子节点为O(1)
+ * 构建后只读,可由任意线程同时查询
+ */
+class FXSPNodeHierarchy
+{
+public:
+	void Reset()
+	{
+		Parents.Empty();
+		ChildOffsets.Empty();
+		Children.Empty();
+	}
+
+	//InParents按dbid索引,无上级或上级无效(越界或指向自身)的节点为INDEX_NONE
+	void Build(TArray<int32>&& InParents)
+	{
+		Parents = MoveTemp(InParents);
+		const int32 NumNodes = Parents.Num();
+		for (int32 Dbid = 0; Dbid < NumNodes; ++Dbid)
+		{
+			if (Parents[Dbid] < 0 || Parents[Dbid] >= NumNodes || Parents[Dbid] == Dbid)
+				Parents[Dbid] = INDEX_NONE;
+		}
+
+		//先统计每个节点的子节点数,前缀和即为各节点子节点的起始位置
+		ChildOffsets.SetNumZeroed(NumNodes + 1);
+		for (int32 Dbid = 0; Dbid < NumNodes; ++Dbid)
+		{
+			if (Parents[Dbid] != INDEX_NONE)
+				ChildOffsets[Parents[Dbid] + 1]++;
+		}
+		for (int32 Dbid = 0; Dbid < NumNodes; ++Dbid)
+		{
+			ChildOffsets[Dbid + 1] += ChildOffsets[Dbid];
+		}
+
+		Children.SetNumUninitialized(ChildOffsets[NumNodes]);
+		TArray<int32> NextChild(ChildOffsets.GetData(), NumNodes);
+		for (int32 Dbid = 0; Dbid < NumNodes; ++Dbid)
+		{
+			if (Parents[Dbid] != INDEX_NONE)
+				Children[NextChild[Parents[Dbid]]++] = Dbid;
+		}
+	}
+
+	int32 Num() const { return Parents.Num(); }
+
+	int32 GetParent(int32 Dbid) const
+	{
+		return Parents.IsValidIndex(Dbid) ? Parents[Dbid] : INDEX_NONE;
+	}
+
+	TArrayView<const int32> GetChildren(int32 Dbid) const
+	{
+		if (!Parents.IsValidIndex(Dbid))
+			return TArrayView<const int32>();
+		return TArrayView<const int32>(Children.GetData() + ChildOffsets[Dbid], ChildOffsets[Dbid + 1] - ChildOffsets[Dbid]);
+	}
+
+private:
+	TArray<int32> Parents;
+	TArray<int32> ChildOffsets;
+	TArray<int32> Children;
+};
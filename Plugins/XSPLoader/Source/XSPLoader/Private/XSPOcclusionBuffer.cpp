@@ -0,0 +1,217 @@
+#include "XSPOcclusionBuffer.h"
+
+void FXSPOcclusionBuffer::Init(int32 InWidth, int32 InHeight)
+{
+    check(InWidth > 0 && InHeight > 0);
+    NumTilesX = FMath::DivideAndRoundUp(InWidth, TileSize);
+    NumTilesY = FMath::DivideAndRoundUp(InHeight, TileSize);
+    Width = NumTilesX * TileSize;
+    Height = NumTilesY * TileSize;
+    Depth.SetNumZeroed(Width * Height);
+    TileMinDepth.SetNumZeroed(NumTilesX * NumTilesY);
+    NumOccluders = 0;
+}
+
+void FXSPOcclusionBuffer::Clear(const FVector& InViewOrigin, const FMatrix& TranslatedViewProjMatrix, float InNearClip)
+{
+    ViewOrigin = InViewOrigin;
+    ViewProjMatrix = FMatrix44f(TranslatedViewProjMatrix);
+    NearClip = FMath::Max(InNearClip, KINDA_SMALL_NUMBER);
+    NumOccluders = 0;
+    FMemory::Memzero(Depth.GetData(), Depth.Num() * sizeof(float));
+    FMemory::Memzero(TileMinDepth.GetData(), TileMinDepth.Num() * sizeof(float));
+}
+
+bool FXSPOcclusionBuffer::ProjectPoint(const FVector3f& TranslatedPoint, FScreenVertex& OutVertex) const
+{
+    FVector4f Clip = ViewProjMatrix.TransformFVector4(FVector4f(TranslatedPoint, 1.0f));
+    if (Clip.W < NearClip)
+        return false;
+
+    float InvW = 1.0f / Clip.W;
+    OutVertex.X = (Clip.X * InvW * 0.5f + 0.5f) * Width;
+    OutVertex.Y = (0.5f - Clip.Y * InvW * 0.5f) * Height;
+    OutVertex.InvW = InvW;
+    return true;
+}
+
+bool FXSPOcclusionBuffer::ProjectBox(const FBox3f& Box, FScreenVertex OutVertices[8]) const
+{
+    FVector3f Min = FVector3f(FVector(Box.Min) - ViewOrigin);
+    FVector3f Max = FVector3f(FVector(Box.Max) - ViewOrigin);
+    for (int32 i = 0; i < 8; ++i)
+    {
+        FVector3f Corner((i & 1) ? Max.X : Min.X, (i & 2) ? Max.Y : Min.Y, (i & 4) ? Max.Z : Min.Z);
+        if (!ProjectPoint(Corner, OutVertices[i]))
+            return false;
+    }
+    return true;
+}
+
+bool FXSPOcclusionBuffer::AddOccluder(TArrayView<const FVector3f> TriangleVertices)
+{
+    //背面比正面远,写入较近的深度时不影响结果,因此不区分正反面
+    bool bRasterized = false;
+    auto Translate = [this](const FVector3f& Vertex) { return FVector3f(FVector(Vertex) - ViewOrigin); };
+    for (int32 i = 0; i + 2 < TriangleVertices.Num(); i += 3)
+    {
+        //穿过近平面的三角形跳过,只会少遮挡
+        FScreenVertex Vertices[3];
+        if (ProjectPoint(Translate(TriangleVertices[i + 0]), Vertices[0])
+            && ProjectPoint(Translate(TriangleVertices[i + 1]), Vertices[1])
+            && ProjectPoint(Translate(TriangleVertices[i + 2]), Vertices[2]))
+        {
+            bRasterized |= RasterizeTriangle(Vertices[0], Vertices[1], Vertices[2]);
+        }
+    }
+    if (bRasterized)
+    {
+        NumOccluders++;
+    }
+    return bRasterized;
+}
+
+bool FXSPOcclusionBuffer::RasterizeTriangle(const FScreenVertex& V0, const FScreenVertex& V1, const FScreenVertex& V2)
+{
+    float Area = (V1.X - V0.X) * (V2.Y - V0.Y) - (V2.X - V0.X) * (V1.Y - V0.Y);
+    if (FMath::Abs(Area) < SMALL_NUMBER)
+        return false;
+
+    //宽或高不足一个像素的三角形不可能覆盖整个像素
+    if (FMath::Max3(V0.X, V1.X, V2.X) - FMath::Min3(V0.X, V1.X, V2.X) < 1.0f || FMath::Max3(V0.Y, V1.Y, V2.Y) - FMath::Min3(V0.Y, V1.Y, V2.Y) < 1.0f)
+        return false;
+
+    int32 X0 = FMath::Max(0, FMath::FloorToInt(FMath::Min3(V0.X, V1.X, V2.X)));
+    int32 X1 = FMath::Min(Width - 1, FMath::FloorToInt(FMath::Max3(V0.X, V1.X, V2.X)));
+    int32 Y0 = FMath::Max(0, FMath::FloorToInt(FMath::Min3(V0.Y, V1.Y, V2.Y)));
+    int32 Y1 = FMath::Min(Height - 1, FMath::FloorToInt(FMath::Max3(V0.Y, V1.Y, V2.Y)));
+    if (X0 > X1 || Y0 > Y1)
+        return false;
+
+    //边函数E(x, y) = A * x + B * y + C,统一符号使三角形内部为非负
+    //像素中心处的值减去半个像素范围内的最大变化量,像素中心处非负即整个像素都在边的内侧
+    const FScreenVertex* Vertices[3] = { &V0, &V1, &V2 };
+    float Sign = Area > 0 ? -1.0f : 1.0f;
+    float EdgeA[3], EdgeB[3], EdgeC[3];
+    for (int32 i = 0; i < 3; ++i)
+    {
+        const FScreenVertex& A = *Vertices[i];
+        const FScreenVertex& B = *Vertices[(i + 1) % 3];
+        EdgeA[i] = (B.Y - A.Y) * Sign;
+        EdgeB[i] = (A.X - B.X) * Sign;
+        EdgeC[i] = -A.X * EdgeA[i] - A.Y * EdgeB[i] - 0.5f * (FMath::Abs(EdgeA[i]) + FMath::Abs(EdgeB[i]));
+    }
+
+    //1/W在屏幕空间线性变化,由3个顶点求出平面方程;同样减去半个像素范围内的最大变化量,得到像素范围内最远处的深度
+    float DepthA = ((V1.InvW - V0.InvW) * (V2.Y - V0.Y) - (V2.InvW - V0.InvW) * (V1.Y - V0.Y)) / Area;
+    float DepthB = ((V1.X - V0.X) * (V2.InvW - V0.InvW) - (V2.X - V0.X) * (V1.InvW - V0.InvW)) / Area;
+    float DepthC = V0.InvW - DepthA * V0.X - DepthB * V0.Y - 0.5f * (FMath::Abs(DepthA) + FMath::Abs(DepthB));
+
+    const VectorRegister4Float Zero = VectorZeroFloat();
+    const VectorRegister4Float LaneOffsets = MakeVectorRegisterFloat(0.5f, 1.5f, 2.5f, 3.5f);
+    const VectorRegister4Float E0A = VectorSetFloat1(EdgeA[0]), E1A = VectorSetFloat1(EdgeA[1]), E2A = VectorSetFloat1(EdgeA[2]);
+    const VectorRegister4Float ZA = VectorSetFloat1(DepthA);
+
+    //逐行以4个像素为一组,在像素中心求边函数和深度
+    bool bWritten = false;
+    int32 BlockX0 = X0 & ~3;
+    for (int32 Y = Y0; Y <= Y1; ++Y)
+    {
+        float PixelY = Y + 0.5f;
+        VectorRegister4Float E0Row = VectorSetFloat1(EdgeB[0] * PixelY + EdgeC[0]);
+        VectorRegister4Float E1Row = VectorSetFloat1(EdgeB[1] * PixelY + EdgeC[1]);
+        VectorRegister4Float E2Row = VectorSetFloat1(EdgeB[2] * PixelY + EdgeC[2]);
+        VectorRegister4Float ZRow = VectorSetFloat1(DepthB * PixelY + DepthC);
+        float* Row = Depth.GetData() + Y * Width;
+        for (int32 X = BlockX0; X <= X1; X += 4)
+        {
+            VectorRegister4Float PixelX = VectorAdd(VectorSetFloat1((float)X), LaneOffsets);
+            VectorRegister4Float Inside = VectorBitwiseAnd(
+                VectorBitwiseAnd(VectorCompareGE(VectorMultiplyAdd(E0A, PixelX, E0Row), Zero), VectorCompareGE(VectorMultiplyAdd(E1A, PixelX, E1Row), Zero)),
+                VectorCompareGE(VectorMultiplyAdd(E2A, PixelX, E2Row), Zero));
+            if (VectorMaskBits(Inside) == 0)
+                continue;
+
+            VectorRegister4Float PixelDepth = VectorMultiplyAdd(ZA, PixelX, ZRow);
+            VectorRegister4Float Current = VectorLoadAligned(Row + X);
+            VectorStoreAligned(VectorSelect(Inside, VectorMax(Current, PixelDepth), Current), Row + X);
+            bWritten = true;
+        }
+    }
+    return bWritten;
+}
+
+void FXSPOcclusionBuffer::Finalize()
+{
+    for (int32 TileY = 0; TileY < NumTilesY; ++TileY)
+    {
+        for (int32 TileX = 0; TileX < NumTilesX; ++TileX)
+        {
+            const float* TileStart = Depth.GetData() + TileY * TileSize * Width + TileX * TileSize;
+            VectorRegister4Float MinDepth = VectorLoadAligned(TileStart);
+            for (int32 Y = 0; Y < TileSize; ++Y)
+            {
+                for (int32 X = 0; X < TileSize; X += 4)
+                {
+                    MinDepth = VectorMin(MinDepth, VectorLoadAligned(TileStart + Y * Width + X));
+                }
+            }
+            alignas(16) float Lanes[4];
+            VectorStoreAligned(MinDepth, Lanes);
+            TileMinDepth[TileY * NumTilesX + TileX] = FMath::Min(FMath::Min(Lanes[0], Lanes[1]), FMath::Min(Lanes[2], Lanes[3]));
+        }
+    }
+}
+
+bool FXSPOcclusionBuffer::IsVisible(const FBox3f& Box) const
+{
+    if (NumOccluders == 0)
+        return true;
+
+    FScreenVertex Vertices[8];
+    if (!ProjectBox(Box, Vertices))
+        return true;
+
+    //包围盒的屏幕矩形和最近的深度
+    float MinX = Vertices[0].X, MaxX = Vertices[0].X, MinY = Vertices[0].Y, MaxY = Vertices[0].Y, MaxInvW = Vertices[0].InvW;
+    for (int32 i = 1; i < 8; ++i)
+    {
+        MinX = FMath::Min(MinX, Vertices[i].X);
+        MaxX = FMath::Max(MaxX, Vertices[i].X);
+        MinY = FMath::Min(MinY, Vertices[i].Y);
+        MaxY = FMath::Max(MaxY, Vertices[i].Y);
+        MaxInvW = FMath::Max(MaxInvW, Vertices[i].InvW);
+    }
+    int32 X0 = FMath::Max(0, FMath::FloorToInt(MinX));
+    int32 X1 = FMath::Min(Width - 1, FMath::FloorToInt(MaxX));
+    int32 Y0 = FMath::Max(0, FMath::FloorToInt(MinY));
+    int32 Y1 = FMath::Min(Height - 1, FMath::FloorToInt(MaxY));
+    if (X0 > X1 || Y0 > Y1)
+        return true;
+
+    //任一像素的遮挡深度不比包围盒最近处近,包围盒即可见;矩形两端按4像素对齐,多测试的像素只会使结果更保守
+    const VectorRegister4Float BoxDepth = VectorSetFloat1(MaxInvW);
+    for (int32 TileY = Y0 / TileSize; TileY <= Y1 / TileSize; ++TileY)
+    {
+        for (int32 TileX = X0 / TileSize; TileX <= X1 / TileSize; ++TileX)
+        {
+            if (TileMinDepth[TileY * NumTilesX + TileX] > MaxInvW)
+                continue;
+
+            int32 PixelY0 = FMath::Max(Y0, TileY * TileSize);
+            int32 PixelY1 = FMath::Min(Y1, TileY * TileSize + TileSize - 1);
+            int32 PixelX0 = FMath::Max(X0, TileX * TileSize) & ~3;
+            int32 PixelX1 = FMath::Min(X1, TileX * TileSize + TileSize - 1);
+            for (int32 Y = PixelY0; Y <= PixelY1; ++Y)
+            {
+                const float* Row = Depth.GetData() + Y * Width;
+                for (int32 X = PixelX0; X <= PixelX1; X += 4)
+                {
+                    if (VectorMaskBits(VectorCompareLE(VectorLoadAligned(Row + X), BoxDepth)) != 0)
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
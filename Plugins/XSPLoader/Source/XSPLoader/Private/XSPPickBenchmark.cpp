@@ -0,0 +1,97 @@
+#include "XSPTriangleBVH.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPPickBenchmark, Log, All);
+
+/**
+ * 拾取用三角形BVH的基准测试
+ * 生成随机分布的小三角形,测量BVH的构建耗时和单条射线的最近命中耗时,并对部分射线逐个测试全部三角形,校验两者的命中距离一致
+ */
+namespace
+{
+    void BenchmarkPick(const TArray<FString>& Args)
+    {
+        int32 NumTriangles = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1000000;
+        int32 NumRays = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 10000;
+        //逐个测试全部三角形很慢,只用于校验少量射线
+        const int32 NumVerifiedRays = FMath::Min(NumRays, 20);
+
+        //场景尺寸随三角形个数增长,使三角形的密度大致不变
+        FRandomStream Random(12345);
+        float SceneSize = 100.0f * FMath::Sqrt((float)NumTriangles);
+        TArray<FVector3f> Vertices;
+        Vertices.SetNumUninitialized(NumTriangles * 3);
+        for (int32 i = 0; i < NumTriangles; ++i)
+        {
+            FVector3f Center(Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize * 0.1f));
+            for (int32 j = 0; j < 3; ++j)
+            {
+                Vertices[i * 3 + j] = Center + FVector3f(Random.VRand()) * Random.FRandRange(10, 100);
+            }
+        }
+
+        double BeginTime = FPlatformTime::Seconds();
+        FXSPTriangleBVH BVH;
+        BVH.Build(Vertices);
+        double BuildTime = FPlatformTime::Seconds() - BeginTime;
+        UE_LOG(LogXSPPickBenchmark, Display, TEXT("拾取测试: %d个三角形, %d个BVH节点, 占用%.1fMB, 构建耗时%.2fms, 射线%d条"),
+            NumTriangles, BVH.NumNodes(), BVH.GetAllocatedSize() / (1024.0 * 1024.0), BuildTime * 1000.0, NumRays);
+
+        double BVHTime = 0;
+        double MaxBVHTime = 0;
+        double BruteForceTime = 0;
+        int32 NumHits = 0;
+        int32 NumMismatches = 0;
+        for (int32 q = 0; q < NumRays; ++q)
+        {
+            FVector3f Origin(Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize), Random.FRandRange(0, SceneSize * 0.1f));
+            FVector3f Direction = FVector3f(Random.VRand()).GetSafeNormal();
+            float MaxDistance = SceneSize;
+
+            int32 Triangle = INDEX_NONE;
+            float Distance = MaxDistance;
+            BeginTime = FPlatformTime::Seconds();
+            bool bHit = BVH.RayCast(Origin, Direction, MaxDistance, Triangle, Distance);
+            double RayTime = FPlatformTime::Seconds() - BeginTime;
+            BVHTime += RayTime;
+            MaxBVHTime = FMath::Max(MaxBVHTime, RayTime);
+            NumHits += bHit ? 1 : 0;
+
+            if (q >= NumVerifiedRays)
+                continue;
+
+            float BruteForceDistance = MaxDistance;
+            bool bBruteForceHit = false;
+            BeginTime = FPlatformTime::Seconds();
+            for (int32 i = 0; i < NumTriangles; ++i)
+            {
+                FVector HitLocation, HitNormal;
+                FVector Start(Origin);
+                FVector End(Origin + Direction * BruteForceDistance);
+                if (FMath::SegmentTriangleIntersection(Start, End, FVector(Vertices[i * 3 + 0]), FVector(Vertices[i * 3 + 1]), FVector(Vertices[i * 3 + 2]), HitLocation, HitNormal))
+                {
+                    BruteForceDistance = (float)FVector::Dist(Start, HitLocation);
+                    bBruteForceHit = true;
+                }
+            }
+            BruteForceTime += FPlatformTime::Seconds() - BeginTime;
+            //两种算法的浮点误差不同,命中距离允许少量偏差
+            if (bHit != bBruteForceHit || (bHit && FMath::Abs(Distance - BruteForceDistance) > 0.1f))
+            {
+                NumMismatches++;
+            }
+        }
+
+        UE_LOG(LogXSPPickBenchmark, Display, TEXT("\tBVH: 平均%.4fms/条, 最大%.4fms, 命中率%.1f%%"), BVHTime * 1000.0 / NumRays, MaxBVHTime * 1000.0, 100.0 * NumHits / NumRays);
+        UE_LOG(LogXSPPickBenchmark, Display, TEXT("\t逐个测试: 平均%.2fms/条, 校验%d条%s"), BruteForceTime * 1000.0 / NumVerifiedRays, NumVerifiedRays,
+            NumMismatches > 0 ? *FString::Printf(TEXT(", %d条结果不一致!"), NumMismatches) : TEXT(""));
+    }
+}
+
+static FAutoConsoleCommand CmdXSPBenchmarkPick(
+    TEXT("XSP.BenchmarkPick"),
+    TEXT("Measure build time and nearest-hit ray cast time of the triangle BVH used for picking, verifying a few rays against testing every triangle.\n")
+    TEXT("Usage: XSP.BenchmarkPick [NumTriangles=1000000] [NumRays=10000]"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkPick)
+);
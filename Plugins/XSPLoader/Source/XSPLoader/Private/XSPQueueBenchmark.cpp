@@ -0,0 +1,141 @@
+#include "XSPLockFreeQueue.h"
+#include "Async/Async.h"
+#include "Containers/Queue.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/ScopeLock.h"
+#include <atomic>
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPQueueBenchmark, Log, All);
+
+/**
+ * 请求/加载/合并各阶段之间交付队列的争用测试
+ * 1到32个生产者线程向同一队列写入,单个消费者线程批量取出,比较无锁环形队列与原先的加锁数组/TQueue的吞吐量
+ */
+namespace
+{
+    const int32 BatchSize = 64;
+
+    //加锁数组,生产者逐个加入,消费者整体换出(原CachedRequestArray的做法)
+    struct FLockedArrayQueue
+    {
+        FCriticalSection CS;
+        TArray<uint64> Items;
+
+        bool TryEnqueue(uint64 Item)
+        {
+            FScopeLock Lock(&CS);
+            Items.Add(Item);
+            return true;
+        }
+
+        int32 DequeueAll(TArray<uint64>& OutItems)
+        {
+            OutItems.Reset();
+            FScopeLock Lock(&CS);
+            Swap(OutItems, Items);
+            return OutItems.Num();
+        }
+    };
+
+    //启动NumProducers个生产者线程,每个写入NumItemsPerProducer个,在调用线程上消费,返回每秒交付的个数
+    template<typename EnqueueFuncType, typename DequeueFuncType>
+    double RunContention(int32 NumProducers, int32 NumItemsPerProducer, EnqueueFuncType&& Enqueue, DequeueFuncType&& Dequeue)
+    {
+        std::atomic<bool> bStart{ false };
+        TArray<TFuture<void>> Producers;
+        for (int32 p = 0; p < NumProducers; ++p)
+        {
+            Producers.Add(Async(EAsyncExecution::Thread, [&bStart, &Enqueue, p, NumItemsPerProducer]() {
+                while (!bStart.load())
+                {
+                    FPlatformProcess::Yield();
+                }
+                for (int32 i = 0; i < NumItemsPerProducer; ++i)
+                {
+                    while (!Enqueue((uint64)p * NumItemsPerProducer + i))
+                    {
+                        FPlatformProcess::Yield();
+                    }
+                }
+                }));
+        }
+
+        int64 NumExpected = (int64)NumProducers * NumItemsPerProducer;
+        int64 NumReceived = 0;
+        double BeginTime = FPlatformTime::Seconds();
+        bStart.store(true);
+        while (NumReceived < NumExpected)
+        {
+            int32 NumDequeued = Dequeue();
+            if (NumDequeued == 0)
+            {
+                FPlatformProcess::Yield();
+            }
+            NumReceived += NumDequeued;
+        }
+        double Elapsed = FPlatformTime::Seconds() - BeginTime;
+
+        for (TFuture<void>& Producer : Producers)
+        {
+            Producer.Wait();
+        }
+        return Elapsed > 0 ? NumExpected / Elapsed : 0;
+    }
+
+    void BenchmarkQueues(const TArray<FString>& Args)
+    {
+        int32 NumItemsPerProducer = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100000;
+        int32 Capacity = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 4096;
+
+        UE_LOG(LogXSPQueueBenchmark, Display, TEXT("队列争用测试: 每个生产者%d个, 环形队列容量%d, 单位: 百万个/秒"), NumItemsPerProducer, Capacity);
+        UE_LOG(LogXSPQueueBenchmark, Display, TEXT("生产者数\tMPSC环形队列\tTQueue(Mpsc)\t加锁数组"));
+
+        for (int32 NumProducers = 1; NumProducers <= 32; NumProducers *= 2)
+        {
+            TXSPBoundedMpscQueue<uint64> Ring;
+            Ring.Init(Capacity);
+            uint64 Batch[BatchSize];
+            double RingRate = RunContention(NumProducers, NumItemsPerProducer,
+                [&Ring](uint64 Item) { return Ring.TryEnqueue(Item); },
+                [&Ring, &Batch]() { return Ring.DequeueBatch(Batch, BatchSize); });
+
+            TQueue<uint64, EQueueMode::Mpsc> Queue;
+            double QueueRate = RunContention(NumProducers, NumItemsPerProducer,
+                [&Queue](uint64 Item) { return Queue.Enqueue(Item); },
+                [&Queue]() {
+                    int32 NumDequeued = 0;
+                    uint64 Item;
+                    while (NumDequeued < BatchSize && Queue.Dequeue(Item))
+                    {
+                        NumDequeued++;
+                    }
+                    return NumDequeued;
+                });
+
+            FLockedArrayQueue LockedArray;
+            TArray<uint64> Swapped;
+            double LockedRate = RunContention(NumProducers, NumItemsPerProducer,
+                [&LockedArray](uint64 Item) { return LockedArray.TryEnqueue(Item); },
+                [&LockedArray, &Swapped]() { return LockedArray.DequeueAll(Swapped); });
+
+            UE_LOG(LogXSPQueueBenchmark, Display, TEXT("%d\t%.2f\t%.2f\t%.2f"), NumProducers, RingRate / 1e6, QueueRate / 1e6, LockedRate / 1e6);
+        }
+
+        //加载线程的交付是单生产者单消费者
+        TXSPBoundedSpscQueue<uint64> SpscRing;
+        SpscRing.Init(Capacity);
+        uint64 SpscBatch[BatchSize];
+        double SpscRate = RunContention(1, NumItemsPerProducer,
+            [&SpscRing](uint64 Item) { return SpscRing.TryEnqueue(Item); },
+            [&SpscRing, &SpscBatch]() { return SpscRing.DequeueBatch(SpscBatch, BatchSize); });
+        UE_LOG(LogXSPQueueBenchmark, Display, TEXT("SPSC环形队列(1个生产者): %.2f"), SpscRate / 1e6);
+    }
+}
+
+static FAutoConsoleCommand CmdXSPBenchmarkQueues(
+    TEXT("XSP.BenchmarkQueues"),
+    TEXT("Measure producer/consumer throughput of the XSPLoader handoff queues with 1 to 32 producer threads.\n")
+    TEXT("Usage: XSP.BenchmarkQueues [ItemsPerProducer=100000] [RingCapacity=4096]"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkQueues)
+);
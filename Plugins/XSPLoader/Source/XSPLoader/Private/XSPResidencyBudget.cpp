@@ -0,0 +1,205 @@
+#include "XSPResidencyBudget.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+
+static int32 GXSPMemoryBudgetMB = 4096;
+FAutoConsoleVariableRef CVarXSPMemoryBudgetMB(
+    TEXT("r.XSP.MemoryBudgetMB"),
+    GXSPMemoryBudgetMB,
+    TEXT("Memory budget (MB) of loaded meshes, CPU and estimated GPU bytes, the least recently visible are evicted beyond it.\n")
+    TEXT(" 0: unlimited\n")
+    TEXT(" 4096: default\n"),
+    ECVF_Default
+);
+
+static float GXSPEvictLowWatermark = 0.9f;
+FAutoConsoleVariableRef CVarXSPEvictLowWatermark(
+    TEXT("r.XSP.EvictLowWatermark"),
+    GXSPEvictLowWatermark,
+    TEXT("Once over the budget, evict until resident bytes drop below this fraction of it.\n")
+    TEXT(" 0.9: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPEvictMinInvisibleFrames = 60;
+FAutoConsoleVariableRef CVarXSPEvictMinInvisibleFrames(
+    TEXT("r.XSP.EvictMinInvisibleFrames"),
+    GXSPEvictMinInvisibleFrames,
+    TEXT("Meshes visible within this many frames are never evicted.\n")
+    TEXT(" 60: default\n"),
+    ECVF_Default
+);
+
+static int32 GXSPMaxEvictionsPerFrame = 256;
+FAutoConsoleVariableRef CVarXSPMaxEvictionsPerFrame(
+    TEXT("r.XSP.MaxEvictionsPerFrame"),
+    GXSPMaxEvictionsPerFrame,
+    TEXT("Max number of meshes evicted per frame.\n")
+    TEXT(" 256: default\n"),
+    ECVF_Default
+);
+
+void FXSPResidencyBudget::Init(int32 NumNodes)
+{
+    ResidentMeshes.Reset();
+    ResidentIndices.Init(INDEX_NONE, NumNodes);
+    LruPrev.Init(INDEX_NONE, NumNodes);
+    LruNext.Init(INDEX_NONE, NumNodes);
+    LruHead = LruTail = INDEX_NONE;
+    ResidentBytes = 0;
+    bEvicting = false;
+}
+
+void FXSPResidencyBudget::Reset()
+{
+    ResidentMeshes.Empty();
+    ResidentIndices.Empty();
+    LruPrev.Empty();
+    LruNext.Empty();
+    LruHead = LruTail = INDEX_NONE;
+    ResidentBytes = 0;
+    bEvicting = false;
+}
+
+void FXSPResidencyBudget::LinkTail(int32 Dbid)
+{
+    LruPrev[Dbid] = LruTail;
+    LruNext[Dbid] = INDEX_NONE;
+    if (LruTail != INDEX_NONE)
+    {
+        LruNext[LruTail] = Dbid;
+    }
+    else
+    {
+        LruHead = Dbid;
+    }
+    LruTail = Dbid;
+}
+
+void FXSPResidencyBudget::Unlink(int32 Dbid)
+{
+    int32 Prev = LruPrev[Dbid];
+    int32 Next = LruNext[Dbid];
+    if (Prev != INDEX_NONE)
+        LruNext[Prev] = Next;
+    else
+        LruHead = Next;
+    if (Next != INDEX_NONE)
+        LruPrev[Next] = Prev;
+    else
+        LruTail = Prev;
+    LruPrev[Dbid] = LruNext[Dbid] = INDEX_NONE;
+}
+
+void FXSPResidencyBudget::AddResident(int32 Dbid, UStaticMeshComponent* Component, UStaticMesh* StaticMesh, int64 NumBytes, uint64 FrameNumber, bool bPooled)
+{
+    if (!ResidentIndices.IsValidIndex(Dbid))
+        return;
+
+    int32& Index = ResidentIndices[Dbid];
+    if (Index == INDEX_NONE)
+    {
+        Index = ResidentMeshes.AddDefaulted();
+    }
+    else
+    {
+        ResidentBytes -= ResidentMeshes[Index].NumBytes;
+        Unlink(Dbid);
+    }
+    ResidentMeshes[Index] = { Dbid, NumBytes, FrameNumber, Component, StaticMesh, bPooled };
+    ResidentBytes += NumBytes;
+    LinkTail(Dbid);
+}
+
+void FXSPResidencyBudget::MarkVisible(int32 Dbid, uint64 FrameNumber)
+{
+    if (IsResident(Dbid))
+    {
+        ResidentMeshes[ResidentIndices[Dbid]].LastVisibleFrame = FrameNumber;
+        if (LruTail != Dbid)
+        {
+            Unlink(Dbid);
+            LinkTail(Dbid);
+        }
+    }
+}
+
+void FXSPResidencyBudget::RemoveAt(int32 Index)
+{
+    const FResidentMesh& Mesh = ResidentMeshes[Index];
+    ResidentBytes -= Mesh.NumBytes;
+    ResidentIndices[Mesh.Dbid] = INDEX_NONE;
+    Unlink(Mesh.Dbid);
+    ResidentMeshes.RemoveAtSwap(Index, 1, false);
+    if (Index < ResidentMeshes.Num())
+    {
+        ResidentIndices[ResidentMeshes[Index].Dbid] = Index;
+    }
+}
+
+int64 FXSPResidencyBudget::GetBudgetBytes()
+{
+    return (int64)FMath::Max(0, GXSPMemoryBudgetMB) * 1024 * 1024;
+}
+
+void FXSPResidencyBudget::CollectEvictions(uint64 FrameNumber, TArray<FResidentMesh>& OutEvictions)
+{
+    int64 BudgetBytes = GetBudgetBytes();
+    if (BudgetBytes == 0)
+    {
+        bEvicting = false;
+        return;
+    }
+
+    //高低水位之间不进入也不退出淘汰状态
+    int64 LowWatermarkBytes = (int64)(BudgetBytes * FMath::Clamp(GXSPEvictLowWatermark, 0.0f, 1.0f));
+    if (ResidentBytes > BudgetBytes)
+    {
+        bEvicting = true;
+    }
+    else if (ResidentBytes <= LowWatermarkBytes)
+    {
+        bEvicting = false;
+    }
+    if (!bEvicting)
+        return;
+
+    //从LRU链表头部取最久未可见的,遇到最近可见的即停止,其后的都更近,开销只与淘汰的个数有关
+    uint64 MinInvisibleFrames = (uint64)FMath::Max(0, GXSPEvictMinInvisibleFrames);
+    int32 MaxEvictions = FMath::Max(1, GXSPMaxEvictionsPerFrame);
+    while (LruHead != INDEX_NONE && OutEvictions.Num() < MaxEvictions && ResidentBytes > LowWatermarkBytes)
+    {
+        int32 Index = ResidentIndices[LruHead];
+        if (FrameNumber < ResidentMeshes[Index].LastVisibleFrame + MinInvisibleFrames)
+            break;
+        OutEvictions.Add(ResidentMeshes[Index]);
+        RemoveAt(Index);
+    }
+
+    //降到低水位后退出淘汰状态;其余的都在最近可见时暂时降不到低水位,下一帧再试
+    if (ResidentBytes <= LowWatermarkBytes)
+    {
+        bEvicting = false;
+    }
+}
+
+int64 FXSPResidencyBudget::EstimateMeshBytes(UStaticMesh* StaticMesh)
+{
+    if (nullptr == StaticMesh)
+        return 0;
+
+    int64 NumBytes = StaticMesh->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+    if (const FStaticMeshRenderData* RenderData = StaticMesh->GetRenderData())
+    {
+        for (const FStaticMeshLODResources& LODResources : RenderData->LODResources)
+        {
+            //位置12字节,切线基8字节,每套UV 8字节(全精度),顶点色4字节
+            int64 NumVertices = LODResources.GetNumVertices();
+            NumBytes += NumVertices * (12 + 8 + 8 * (int64)LODResources.GetNumTexCoords());
+            NumBytes += (int64)LODResources.VertexBuffers.ColorVertexBuffer.GetNumVertices() * 4;
+            NumBytes += (int64)LODResources.IndexBuffer.GetNumIndices() * (LODResources.IndexBuffer.Is32Bit() ? 4 : 2);
+        }
+    }
+    return NumBytes;
+}
@@ -0,0 +1,82 @@
+#include "XSPSourceRouting.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPRoutingBenchmark, Log, All);
+
+/**
+ * dbid路由的微基准测试
+ * 生成若干节点数随机的源文件区间,比较原先逐个扫描区间与路由表二分查找的单次查找耗时
+ */
+namespace
+{
+    struct FSourceRange
+    {
+        int32 StartDbid;
+        int32 Count;
+    };
+
+    int32 FindSourceIndexLinear(const TArray<FSourceRange>& Ranges, int32 Dbid)
+    {
+        for (int32 i = 0; i < Ranges.Num(); ++i)
+        {
+            if (Dbid >= Ranges[i].StartDbid && Dbid < Ranges[i].StartDbid + Ranges[i].Count)
+                return i;
+        }
+        return INDEX_NONE;
+    }
+
+    void BenchmarkRouting(const TArray<FString>& Args)
+    {
+        int32 NumFiles = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1000;
+        int32 NumLookups = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 1000000;
+
+        FRandomStream Random(12345);
+        TArray<FSourceRange> Ranges;
+        FXSPSourceRoutingTable RoutingTable;
+        int32 TotalNumNodes = 0;
+        for (int32 i = 0; i < NumFiles; ++i)
+        {
+            int32 Count = Random.RandRange(100, 20000);
+            Ranges.Add({ TotalNumNodes, Count });
+            RoutingTable.AddSource(TotalNumNodes, Count);
+            TotalNumNodes += Count;
+        }
+
+        TArray<int32> Dbids;
+        Dbids.SetNumUninitialized(NumLookups);
+        for (int32& Dbid : Dbids)
+        {
+            Dbid = Random.RandRange(0, TotalNumNodes - 1);
+        }
+
+        //累加查找结果,防止查找被优化掉,同时校验两种查找的结果一致
+        int64 LinearChecksum = 0;
+        double BeginTime = FPlatformTime::Seconds();
+        for (int32 Dbid : Dbids)
+        {
+            LinearChecksum += FindSourceIndexLinear(Ranges, Dbid);
+        }
+        double LinearTime = FPlatformTime::Seconds() - BeginTime;
+
+        int64 RoutingChecksum = 0;
+        BeginTime = FPlatformTime::Seconds();
+        for (int32 Dbid : Dbids)
+        {
+            RoutingChecksum += RoutingTable.FindSourceIndex(Dbid);
+        }
+        double RoutingTime = FPlatformTime::Seconds() - BeginTime;
+
+        UE_LOG(LogXSPRoutingBenchmark, Display, TEXT("dbid路由测试: %d个源文件, %d个节点, %d次查找%s"),
+            NumFiles, TotalNumNodes, NumLookups, LinearChecksum == RoutingChecksum ? TEXT("") : TEXT(", 结果不一致!"));
+        UE_LOG(LogXSPRoutingBenchmark, Display, TEXT("\t线性扫描: %.2fns/次"), LinearTime * 1e9 / NumLookups);
+        UE_LOG(LogXSPRoutingBenchmark, Display, TEXT("\t路由表: %.2fns/次"), RoutingTime * 1e9 / NumLookups);
+    }
+}
+
+static FAutoConsoleCommand CmdXSPBenchmarkRouting(
+    TEXT("XSP.BenchmarkRouting"),
+    TEXT("Compare linear scan and routing table lookup of the source file owning a dbid.\n")
+    TEXT("Usage: XSP.BenchmarkRouting [NumFiles=1000] [NumLookups=1000000]"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkRouting)
+);
@@ -0,0 +1,46 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Algo/BinarySearch.h"
+
+/**
+ * dbid到源文件的路由表
+ * 各源文件的dbid区间[StartDbid, StartDbid + Count)首尾相接、按源文件顺序递增,
+ * 在Init时记录全部区间起点,查找时对起点做二分,O(logN)且数据紧凑,千个文件时只有十次比较
+ * 构建后只读,可由任意线程同时查找
+ */
+class FXSPSourceRoutingTable
+{
+public:
+	void Reset()
+	{
+		StartDbids.Reset();
+		EndDbid = 0;
+	}
+
+	//按源文件顺序追加一个区间,StartDbid必须等于上一个区间的末尾
+	void AddSource(int32 StartDbid, int32 Count)
+	{
+		check(StartDbid == EndDbid && Count >= 0);
+		StartDbids.Add(StartDbid);
+		EndDbid = StartDbid + Count;
+	}
+
+	int32 NumSources() const { return StartDbids.Num(); }
+
+	//返回dbid所属的源文件序号,越界时返回INDEX_NONE
+	int32 FindSourceIndex(int32 Dbid) const
+	{
+		if (Dbid < 0 || Dbid >= EndDbid)
+			return INDEX_NONE;
+
+		//第一个起点大于dbid的区间的前一个即为所属区间,空文件的区间起点与后一个相同,会被自然跳过
+		return Algo::UpperBound(StartDbids, Dbid) - 1;
+	}
+
+private:
+	TArray<int32> StartDbids;
+	int32 EndDbid = 0;
+};
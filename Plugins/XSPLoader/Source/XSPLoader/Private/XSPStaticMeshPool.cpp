@@ -0,0 +1,175 @@
+#include "XSPStaticMeshPool.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+
+FXSPStaticMeshPool::FXSPStaticMeshPool()
+    : FreeEvent(FPlatformProcess::GetSynchEventFromPool(true))
+{
+}
+
+FXSPStaticMeshPool::~FXSPStaticMeshPool()
+{
+    FPlatformProcess::ReturnSynchEventToPool(FreeEvent);
+    FreeEvent = nullptr;
+}
+
+void FXSPStaticMeshPool::Reset()
+{
+    check(IsInGameThread());
+    {
+        FScopeLock Lock(&FreeCS);
+        FreeMeshes.Empty();
+    }
+    RetiredMeshes.Empty();
+    ReleasingMeshes.Empty();
+    Meshes.Empty();
+    NumCreated = 0;
+    NumMisses = 0;
+}
+
+UStaticMesh* FXSPStaticMeshPool::CreateMesh()
+{
+    UStaticMesh* StaticMesh = NewObject<UStaticMesh>();
+    Meshes.Add(StaticMesh);
+    NumCreated++;
+    return StaticMesh;
+}
+
+void FXSPStaticMeshPool::Tick(int32 TargetFree, int32 MaxCreations)
+{
+    check(IsInGameThread());
+
+    //渲染资源已释放的对象回到空闲列表,丢弃渲染数据以免在池中占用内存
+    TArray<UStaticMesh*> Recycled;
+    for (int32 i = ReleasingMeshes.Num() - 1; i >= 0; --i)
+    {
+        UStaticMesh* StaticMesh = ReleasingMeshes[i];
+        if (StaticMesh->ReleaseResourcesFence.IsFenceComplete())
+        {
+            StaticMesh->SetRenderData(nullptr);
+            Recycled.Add(StaticMesh);
+            ReleasingMeshes.RemoveAtSwap(i, 1, false);
+        }
+    }
+
+    //上一帧归还的对象,其组件的渲染状态已在帧末更新,此时可以释放渲染资源
+    for (UStaticMesh* StaticMesh : RetiredMeshes)
+    {
+        StaticMesh->ReleaseResources();
+        ReleasingMeshes.Add(StaticMesh);
+    }
+    RetiredMeshes.Reset();
+
+    int32 NumFree = 0;
+    {
+        FScopeLock Lock(&FreeCS);
+        FreeMeshes.Append(Recycled);
+        NumFree = FreeMeshes.Num();
+    }
+
+    TargetFree = FMath::Max(0, TargetFree);
+    if (NumFree > TargetFree * 2)
+    {
+        //请求减少后丢弃多余的空闲对象,由GC回收
+        FScopeLock Lock(&FreeCS);
+        while (FreeMeshes.Num() > TargetFree)
+        {
+            Meshes.Remove(FreeMeshes.Pop(false));
+        }
+        NumFree = FreeMeshes.Num();
+    }
+
+    int32 NumToCreate = FMath::Min(TargetFree - NumFree, FMath::Max(0, MaxCreations));
+    if (NumToCreate > 0)
+    {
+        TArray<UStaticMesh*> Created;
+        Created.Reserve(NumToCreate);
+        for (int32 i = 0; i < NumToCreate; ++i)
+        {
+            Created.Add(CreateMesh());
+        }
+        FScopeLock Lock(&FreeCS);
+        FreeMeshes.Append(Created);
+    }
+
+    if (Recycled.Num() > 0 || NumToCreate > 0)
+    {
+        FreeEvent->Trigger();
+    }
+}
+
+UStaticMesh* FXSPStaticMeshPool::TryAcquire()
+{
+    FScopeLock Lock(&FreeCS);
+    return FreeMeshes.Num() > 0 ? FreeMeshes.Pop(false) : nullptr;
+}
+
+UStaticMesh* FXSPStaticMeshPool::Acquire(TFunctionRef<bool()> ShouldAbort)
+{
+    while (true)
+    {
+        {
+            FScopeLock Lock(&FreeCS);
+            if (FreeMeshes.Num() > 0)
+                return FreeMeshes.Pop(false);
+            //空闲列表为空时才在锁内复位,之后补充或归还对象时触发,手动重置的事件唤醒全部等待者
+            FreeEvent->Reset();
+        }
+        if (ShouldAbort())
+            return nullptr;
+        //请求过期等放弃条件的变化不会触发事件,等待设有上限,到时重新检查
+        FreeEvent->Wait(AbortCheckIntervalMs);
+    }
+}
+
+UStaticMesh* FXSPStaticMeshPool::AcquireOrCreate()
+{
+    check(IsInGameThread());
+    if (UStaticMesh* StaticMesh = TryAcquire())
+        return StaticMesh;
+
+    NumMisses++;
+    return CreateMesh();
+}
+
+void FXSPStaticMeshPool::Release(UStaticMesh* StaticMesh)
+{
+    check(IsInGameThread());
+    if (nullptr == StaticMesh)
+        return;
+
+    //构建时会追加一个材质槽,复用前清空
+    StaticMesh->GetStaticMaterials().Reset();
+    Meshes.Add(StaticMesh);
+    if (nullptr != StaticMesh->GetRenderData())
+    {
+        RetiredMeshes.Add(StaticMesh);
+    }
+    else
+    {
+        //未构建过的对象直接回到空闲列表
+        {
+            FScopeLock Lock(&FreeCS);
+            FreeMeshes.Add(StaticMesh);
+        }
+        FreeEvent->Trigger();
+    }
+}
+
+void FXSPStaticMeshPool::WakeWaiters()
+{
+    FreeEvent->Trigger();
+}
+
+int32 FXSPStaticMeshPool::GetNumFree() const
+{
+    FScopeLock Lock(&FreeCS);
+    return FreeMeshes.Num();
+}
+
+void FXSPStaticMeshPool::AddReferencedObjects(FReferenceCollector& Collector)
+{
+    Collector.AddReferencedObjects(Meshes);
+}
@@ -0,0 +1,230 @@
+#include "XSPTriangleBVH.h"
+#include "Algo/Partition.h"
+
+namespace
+{
+    //Möller–Trumbore算法求射线与三角形的交点,不区分正反面
+    FORCEINLINE bool IntersectTriangle(const FVector3f& Origin, const FVector3f& Dir, const FVector3f& V0, const FVector3f& V1, const FVector3f& V2, float& OutDistance)
+    {
+        const FVector3f Edge1 = V1 - V0;
+        const FVector3f Edge2 = V2 - V0;
+        const FVector3f P = Dir ^ Edge2;
+        const float Det = Edge1 | P;
+        //射线与三角形平行或三角形退化
+        if (FMath::Abs(Det) < 1e-12f)
+            return false;
+
+        const float InvDet = 1.0f / Det;
+        const FVector3f S = Origin - V0;
+        const float U = (S | P) * InvDet;
+        if (U < 0.0f || U > 1.0f)
+            return false;
+
+        const FVector3f Q = S ^ Edge1;
+        const float V = (Dir | Q) * InvDet;
+        if (V < 0.0f || U + V > 1.0f)
+            return false;
+
+        OutDistance = (Edge2 | Q) * InvDet;
+        return OutDistance >= 0.0f;
+    }
+}
+
+void FXSPTriangleBVH::Empty()
+{
+    Nodes.Empty();
+    Vertices.Empty();
+    TriangleIndices.Empty();
+    Bounds = FBox3f(ForceInit);
+}
+
+void FXSPTriangleBVH::Build(TArrayView<const FVector3f> TriangleVertices)
+{
+    Empty();
+
+    const int32 NumTris = TriangleVertices.Num() / 3;
+    if (NumTris == 0)
+        return;
+
+    TArray<FVector3f> Centers;
+    Centers.SetNumUninitialized(NumTris);
+    TriangleIndices.SetNumUninitialized(NumTris);
+    for (int32 i = 0; i < NumTris; ++i)
+    {
+        Centers[i] = (TriangleVertices[i * 3 + 0] + TriangleVertices[i * 3 + 1] + TriangleVertices[i * 3 + 2]) / 3.0f;
+        TriangleIndices[i] = i;
+    }
+
+    //节点数不超过叶节点数的2倍
+    Nodes.Reserve(FMath::DivideAndRoundUp(NumTris, LeafSize) * 2);
+    Nodes.AddUninitialized(1);
+
+    struct FBuildItem
+    {
+        int32 Node;
+        int32 Begin;
+        int32 End;
+    };
+    TArray<FBuildItem, TInlineAllocator<64>> Stack;
+    Stack.Push({ 0, 0, NumTris });
+    while (Stack.Num() > 0)
+    {
+        FBuildItem Item = Stack.Pop(false);
+        const int32 Count = Item.End - Item.Begin;
+
+        FBox3f NodeBounds(ForceInit);
+        FBox3f CenterBounds(ForceInit);
+        for (int32 i = Item.Begin; i < Item.End; ++i)
+        {
+            int32 Tri = TriangleIndices[i];
+            NodeBounds += TriangleVertices[Tri * 3 + 0];
+            NodeBounds += TriangleVertices[Tri * 3 + 1];
+            NodeBounds += TriangleVertices[Tri * 3 + 2];
+            CenterBounds += Centers[Tri];
+        }
+        Nodes[Item.Node].Min = NodeBounds.Min;
+        Nodes[Item.Node].Max = NodeBounds.Max;
+
+        if (Count <= LeafSize)
+        {
+            Nodes[Item.Node].First = Item.Begin;
+            Nodes[Item.Node].Count = Count;
+            continue;
+        }
+
+        //按三角形中心包围盒最长轴的中点划分,全部落在一侧时(中心重合)按个数对半划分
+        const FVector3f CenterSize = CenterBounds.GetSize();
+        const int32 Axis = CenterSize.X >= CenterSize.Y ? (CenterSize.X >= CenterSize.Z ? 0 : 2) : (CenterSize.Y >= CenterSize.Z ? 1 : 2);
+        const float Split = (CenterBounds.Min[Axis] + CenterBounds.Max[Axis]) * 0.5f;
+        int32 Mid = Item.Begin + Algo::Partition(TriangleIndices.GetData() + Item.Begin, Count, [&Centers, Axis, Split](int32 Tri) { return Centers[Tri][Axis] < Split; });
+        if (Mid == Item.Begin || Mid == Item.End)
+        {
+            Mid = Item.Begin + Count / 2;
+        }
+
+        int32 Left = Nodes.AddUninitialized(2);
+        Nodes[Item.Node].First = Left;
+        Nodes[Item.Node].Count = 0;
+        Stack.Push({ Left + 1, Mid, Item.End });
+        Stack.Push({ Left, Item.Begin, Mid });
+    }
+    Nodes.Shrink();
+
+    //顶点按叶节点的顺序重排,遍历叶节点时连续访问
+    Vertices.SetNumUninitialized(NumTris * 3);
+    for (int32 i = 0; i < NumTris; ++i)
+    {
+        int32 Tri = TriangleIndices[i];
+        Vertices[i * 3 + 0] = TriangleVertices[Tri * 3 + 0];
+        Vertices[i * 3 + 1] = TriangleVertices[Tri * 3 + 1];
+        Vertices[i * 3 + 2] = TriangleVertices[Tri * 3 + 2];
+    }
+    Bounds = FBox3f(Nodes[0].Min, Nodes[0].Max);
+}
+
+SIZE_T FXSPTriangleBVH::GetAllocatedSize() const
+{
+    return Nodes.GetAllocatedSize() + Vertices.GetAllocatedSize() + TriangleIndices.GetAllocatedSize();
+}
+
+bool FXSPTriangleBVH::RayCast(const FVector3f& Origin, const FVector3f& Direction, float MaxDistance, int32& OutTriangle, float& OutDistance, FVector3f* OutNormal) const
+{
+    if (Nodes.Num() == 0)
+        return false;
+
+    const FVector3f Dir = Direction.GetSafeNormal();
+    if (Dir.IsZero())
+        return false;
+
+    //方向分量为0时用同号的极大值代替倒数,避免产生NaN
+    auto SafeInverse = [](float V) { return FMath::Abs(V) > SMALL_NUMBER ? 1.0f / V : (V < 0 ? -1e30f : 1e30f); };
+    const FVector3f InvDir(SafeInverse(Dir.X), SafeInverse(Dir.Y), SafeInverse(Dir.Z));
+
+    float BestDistance = MaxDistance;
+    int32 BestPosition = INDEX_NONE;
+
+    //slab法求射线进入包围盒的距离,离开距离受当前最近命中限制
+    auto IntersectNode = [&Origin, &InvDir, &BestDistance](const FNode& Node, float& OutEnter) {
+        const FVector3f T1 = (Node.Min - Origin) * InvDir;
+        const FVector3f T2 = (Node.Max - Origin) * InvDir;
+        const float TEnter = FMath::Max(FMath::Max(FMath::Min(T1.X, T2.X), FMath::Min(T1.Y, T2.Y)), FMath::Max(FMath::Min(T1.Z, T2.Z), 0.0f));
+        const float TExit = FMath::Min(FMath::Min(FMath::Max(T1.X, T2.X), FMath::Max(T1.Y, T2.Y)), FMath::Min(FMath::Max(T1.Z, T2.Z), BestDistance));
+        OutEnter = TEnter;
+        return TEnter <= TExit;
+    };
+
+    struct FStackEntry
+    {
+        int32 Node;
+        float Enter;
+    };
+    TArray<FStackEntry, TInlineAllocator<64>> Stack;
+    float RootEnter;
+    if (!IntersectNode(Nodes[0], RootEnter))
+        return false;
+    Stack.Push({ 0, RootEnter });
+
+    while (Stack.Num() > 0)
+    {
+        FStackEntry Entry = Stack.Pop(false);
+        //入栈后找到了更近的命中
+        if (Entry.Enter > BestDistance)
+            continue;
+
+        const FNode& Node = Nodes[Entry.Node];
+        if (Node.Count > 0)
+        {
+            for (int32 i = Node.First, i_end = Node.First + Node.Count; i < i_end; ++i)
+            {
+                float Distance;
+                if (IntersectTriangle(Origin, Dir, Vertices[i * 3 + 0], Vertices[i * 3 + 1], Vertices[i * 3 + 2], Distance) && Distance <= BestDistance)
+                {
+                    BestDistance = Distance;
+                    BestPosition = i;
+                }
+            }
+            continue;
+        }
+
+        //较近的子节点后入栈,先被访问
+        float LeftEnter, RightEnter;
+        const bool bHitLeft = IntersectNode(Nodes[Node.First], LeftEnter);
+        const bool bHitRight = IntersectNode(Nodes[Node.First + 1], RightEnter);
+        if (bHitLeft && bHitRight)
+        {
+            if (LeftEnter <= RightEnter)
+            {
+                Stack.Push({ Node.First + 1, RightEnter });
+                Stack.Push({ Node.First, LeftEnter });
+            }
+            else
+            {
+                Stack.Push({ Node.First, LeftEnter });
+                Stack.Push({ Node.First + 1, RightEnter });
+            }
+        }
+        else if (bHitLeft)
+        {
+            Stack.Push({ Node.First, LeftEnter });
+        }
+        else if (bHitRight)
+        {
+            Stack.Push({ Node.First + 1, RightEnter });
+        }
+    }
+
+    if (BestPosition == INDEX_NONE)
+        return false;
+
+    OutTriangle = TriangleIndices[BestPosition];
+    OutDistance = BestDistance;
+    if (OutNormal)
+    {
+        //与构建网格体时计算法线的方式一致
+        const FVector3f& P0 = Vertices[BestPosition * 3 + 0];
+        const FVector3f& P1 = Vertices[BestPosition * 3 + 1];
+        const FVector3f& P2 = Vertices[BestPosition * 3 + 2];
+        *OutNormal = ((P1 - P2) ^ (P0 - P2)).GetSafeNormal();
+    }
+    return true;
+}
@@ -6,6 +6,40 @@
 #include "Containers/UnrealString.h"
 #include "Components/StaticMeshComponent.h"
 #include "UObject/WeakObjectPtrTemplates.h"
+#include "XSPBoundsBVH.h"
+
+class AActor;
+
+//一个静态网格请求的参数,用于批量请求
+struct FXSPMeshRequest
+{
+	int32 Dbid = -1;
+	float Priority = 0;
+	UStaticMeshComponent* TargetMeshComponent = nullptr;
+	//请求节点子树的HLOD代理网格体,而不是节点自身的网格体
+	bool bProxy = false;
+
+	FXSPMeshRequest() = default;
+	FXSPMeshRequest(int32 InDbid, float InPriority, UStaticMeshComponent* InTargetMeshComponent, bool bInProxy = false)
+		: Dbid(InDbid)
+		, Priority(InPriority)
+		, TargetMeshComponent(InTargetMeshComponent)
+		, bProxy(bInProxy)
+	{}
+};
+
+//射线拾取的结果
+struct FXSPPickHit
+{
+	int32 Dbid = INDEX_NONE;
+	//节点网格体中的三角形序号,与构建网格体时的三角形顺序一致
+	int32 TriangleIndex = INDEX_NONE;
+	float Distance = 0;
+	FVector Location = FVector::ZeroVector;
+	FVector Normal = FVector::ZeroVector;
+	//射线经过的较近节点的三角形数据尚在构建,结果可能不是最近的命中,稍后重试可得到准确结果
+	bool bPending = false;
+};
 
 class IXSPLoader
 {
@@ -26,8 +60,112 @@ public:
 	/**
 	 *	请求静态网格数据（数据加载完毕后会自动设置到目标组件上）
 	 *	@param	Dbid				[in]	请求的节点
+	 *  @param	Priority			[in]	优先级,通常取节点包围盒的投影屏幕尺寸,越大越优先;对已有请求会就地更新
+	 *  @param	TargetMeshComponent	[in]	目标组件,为空时在网格体就绪后从组件池中取出(见SetComponentOwner)
+	 */
+	virtual void RequestStaticMesh(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent) = 0;
+
+	/**
+	 *	批量请求静态网格数据,语义与逐个调用RequestStaticMesh相同,每帧请求大量节点时开销更小
+	 *	@param	Requests			[in]	请求数组
+	 */
+	virtual void RequestStaticMeshes(TArrayView<const FXSPMeshRequest> Requests) = 0;
+
+	/**
+	 *	获取节点总数,dbid的取值范围为[0, GetNumNodes())
+	 */
+	virtual int32 GetNumNodes() const = 0;
+
+	/**
+	 *	获取节点的包围盒(世界空间,已转换为引擎坐标系和单位)
+	 *	@param	Dbid				[in]	节点
+	 *	@param	OutBox				[out]	包围盒
+	 *	@return	dbid无效时返回false
+	 */
+	virtual bool GetNodeBoundingBox(int32 Dbid, FBox& OutBox) const = 0;
+
+	/**
+	 *	获取全部节点包围盒的空间索引,查询结果为dbid;Init后只读,可由任意线程查询
+	 */
+	virtual const FXSPBoundsBVH& GetNodeBVH() const = 0;
+
+	/**
+	 *	报告本帧可见的节点,超出内存预算时最久未可见的已加载节点会被卸载(组件的静态网格被清空,可重新请求);只能在Game线程调用
+	 *	@param	Dbids				[in]	本帧可见的节点
+	 */
+	virtual void MarkNodesVisible(TArrayView<const int32> Dbids) = 0;
+
+	/**
+	 *	获取节点的上级节点
+	 *	@return	无上级或dbid无效时返回INDEX_NONE
+	 */
+	virtual int32 GetNodeParent(int32 Dbid) const = 0;
+
+	/**
+	 *	获取节点的下级节点,dbid无效时为空;Init后只读,可由任意线程查询
+	 */
+	virtual TArrayView<const int32> GetNodeChildren(int32 Dbid) const = 0;
+
+	/**
+	 *	获取节点子树的HLOD代理信息,子树节点数在r.XSP.HLODMinDescendants和r.XSP.HLODMaxDescendants之间的节点才有代理
+	 *	@param	Dbid				[in]	子树的根节点
+	 *	@param	OutBounds			[out]	子树全部节点的包围盒
+	 *	@param	OutError			[out]	代理相对于原网格体的最大几何误差(厘米)
+	 *	@return	节点没有代理时返回false
+	 */
+	virtual bool GetProxyInfo(int32 Dbid, FBox& OutBounds, float& OutError) const = 0;
+
+	/**
+	 *	请求节点子树的HLOD代理网格体,首次请求时读取子树的全部节点并简化合并(结果缓存在Saved/XSPLoader),语义与RequestStaticMesh相同
+	 *	@param	Dbid				[in]	子树的根节点,须有代理
 	 *  @param	Priority			[in]	优先级
 	 *  @param	TargetMeshComponent	[in]	目标组件
 	 */
-	virtual void RequestStaticMesh(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent) = 0;
+	virtual void RequestProxyMesh(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent) = 0;
+
+	/**
+	 *	报告本帧显示的代理,与MarkNodesVisible相同,用于代理网格体的内存预算;只能在Game线程调用
+	 *	@param	Dbids				[in]	本帧显示的代理的根节点
+	 */
+	virtual void MarkProxiesVisible(TArrayView<const int32> Dbids) = 0;
+
+	/**
+	 *	设置组件池的Owner:未指定目标组件的请求在网格体就绪时从池中取出组件(创建在Owner上),网格体被淘汰时组件归还到池中;只能在Game线程调用
+	 *	@param	Owner				[in]	创建组件的Actor,组件挂接到其根组件
+	 */
+	virtual void SetComponentOwner(AActor* Owner) = 0;
+
+	/**
+	 *	获取节点已加载的网格体所在的组件,未加载或已被淘汰时返回nullptr;只能在Game线程调用
+	 */
+	virtual UStaticMeshComponent* GetNodeComponent(int32 Dbid) const = 0;
+
+	/**
+	 *	获取子树的代理网格体所在的组件,未加载或已被淘汰时返回nullptr;只能在Game线程调用
+	 */
+	virtual UStaticMeshComponent* GetProxyComponent(int32 Dbid) const = 0;
+
+	/**
+	 *	射线拾取节点的三角形,不依赖物理碰撞:由节点包围盒的BVH按距离从近到远筛选节点,再查询各节点的三角形BVH
+	 *	节点的三角形BVH在首次被射线经过时于构建线程池中读取源文件构建,缓存大小由r.XSP.PickCacheMB限制;未加载的节点也可被拾取
+	 *	可由任意线程调用,但不能与Init/Reset同时调用
+	 *	@param	Origin				[in]	射线起点,与GetNodeBoundingBox相同的坐标空间
+	 *	@param	Direction			[in]	射线方向
+	 *	@param	MaxDistance			[in]	最大距离
+	 *	@param	OutHit				[out]	最近的命中
+	 *	@return	命中时返回true;没有命中但bPending为true时,稍后重试可能命中
+	 */
+	virtual bool PickNode(const FVector& Origin, const FVector& Direction, float MaxDistance, FXSPPickHit& OutHit) = 0;
+
+	/**
+	 *	访问节点的三角形(与PickNode共用三角形缓存),可用作CPU遮挡剔除的遮挡体;尚未缓存时分发构建并返回false,稍后重试
+	 *	构建以低于网格体构建的优先级执行,不会推迟节点的加载
+	 *	Visitor在持有缓存锁时被调用,不能在其中调用PickNode或本函数
+	 *	@param	Dbid				[in]	节点
+	 *	@param	MaxTriangles		[in]	按头信息预估的三角形数超过它的节点既不访问也不构建
+	 *	@param	InOutNumBuilds		[in,out]	还可分发的构建数,为0时不再分发,分发一个减1;调用者以此限制每帧的构建数
+	 *	@param	Visitor				[in]	以节点的三角形顶点(世界空间,每3个顶点一个三角形)调用
+	 *	@return	Visitor被调用时返回true,节点没有网格体或三角形过多时返回false
+	 */
+	virtual bool VisitNodeTriangles(int32 Dbid, int32 MaxTriangles, int32& InOutNumBuilds, TFunctionRef<void(TArrayView<const FVector3f>)> Visitor) = 0;
 };
@@ -0,0 +1,27 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UPrimitiveComponent;
+
+/**
+ * 批量注册组件(只在Game线程使用)
+ * 未注册的组件设置网格体、材质和挂接时只修改属性,不会创建或重建渲染状态;
+ * 先把一批组件全部设置好再加入,Flush时以同一个FRegisterComponentContext注册,图元在最后一次性批量加入场景
+ */
+class XSPLOADER_API FXSPBatchRegistrar
+{
+public:
+	//加入一个设置好的组件,Flush时若已注册则跳过
+	void Add(UPrimitiveComponent* Component) { Components.Add(Component); }
+
+	//注册全部加入的组件并批量创建渲染状态,返回注册的个数
+	int32 Flush();
+
+	int32 Num() const { return Components.Num(); }
+
+private:
+	TArray<UPrimitiveComponent*> Components;
+};
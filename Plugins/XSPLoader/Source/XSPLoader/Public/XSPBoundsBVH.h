@@ -0,0 +1,90 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//射线查询的命中结果
+struct FXSPBVHRayHit
+{
+	int32 Index;
+	//射线进入包围盒处的距离,起点在包围盒内时为0
+	float Distance;
+};
+
+/**
+ * 节点包围盒的4叉BVH
+ * 图元按包围盒中心的Morton码排序后,每4个相邻的图元组成一个叶节点,每4个相邻的节点组成上一层节点,直到根节点
+ * 节点按层连续存放,每个节点以SoA形式保存4个子节点的包围盒,查询时用SIMD一次测试4个子节点;
+ * 子树覆盖的图元在排序后的数组中是连续的,子树完全位于查询范围内时直接输出整段图元而不再向下测试
+ * 构建完成后只读,可由任意线程同时查询;查询结果为构建时传入的图元序号(即dbid)
+ */
+class XSPLOADER_API FXSPBoundsBVH
+{
+public:
+	static constexpr int32 BranchFactor = 4;
+
+	//并行构建,无效的包围盒不参与构建
+	void Build(TArrayView<const FBox3f> Bounds);
+
+	void Empty();
+
+	bool IsEmpty() const { return Nodes.Num() == 0; }
+
+	//参与构建的图元数
+	int32 NumPrimitives() const { return PrimIndices.Num(); }
+
+	int32 NumNodes() const { return Nodes.Num(); }
+
+	//构建时传入的图元总数(含无效的包围盒),用于校验缓存
+	int32 GetSourceCount() const { return SourceCount; }
+
+	//与凸体相交的图元,平面法线朝外(与FConvexVolume::Planes一致)
+	void QueryConvex(TArrayView<const FPlane> Planes, TArray<int32>& OutIndices) const;
+
+	//与球体相交的图元
+	void QuerySphere(const FVector3f& Center, float Radius, TArray<int32>& OutIndices) const;
+
+	//与包围盒相交的图元
+	void QueryBox(const FBox3f& Box, TArray<int32>& OutIndices) const;
+
+	//与射线相交的图元,按距离从近到远排序
+	void QueryRay(const FVector3f& Origin, const FVector3f& Direction, float MaxDistance, TArray<FXSPBVHRayHit>& OutHits) const;
+
+	//读写缓存,读取失败时保持为空
+	bool Serialize(FArchive& Ar);
+
+private:
+	struct alignas(16) FNode
+	{
+		//4个子节点(或图元)的包围盒
+		float MinX[BranchFactor];
+		float MinY[BranchFactor];
+		float MinZ[BranchFactor];
+		float MaxX[BranchFactor];
+		float MaxY[BranchFactor];
+		float MaxZ[BranchFactor];
+		//第0层节点的子节点是图元,FirstChild为PrimIndices中的位置;其他层为Nodes中的位置
+		int32 FirstChild;
+		int32 NumChildren;
+		int32 Level;
+		int32 Padding;
+	};
+
+	//遍历框架,TestFunc对一个节点的4个子节点求出相交和完全包含的位掩码
+	template<typename TestFuncType>
+	void Traverse(TestFuncType&& TestFunc, TArray<int32>& OutIndices) const;
+
+	//子节点覆盖的图元区间
+	void GetChildPrimRange(const FNode& Node, int32 ChildIndex, int32& OutBegin, int32& OutEnd) const;
+
+	//校验读入的缓存:层结构、子节点区间和图元序号都在有效范围内
+	bool IsConsistent() const;
+
+	TArray<FNode> Nodes;
+	//每层第一个节点在Nodes中的位置,根节点为最后一层唯一的节点
+	TArray<int32> LevelOffsets;
+	//排序后的图元对应的原始序号
+	TArray<int32> PrimIndices;
+	int32 SourceCount = 0;
+};
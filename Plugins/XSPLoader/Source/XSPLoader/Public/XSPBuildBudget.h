@@ -0,0 +1,81 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "Templates/Function.h"
+
+class FEvent;
+
+//一个网格体构建任务的预估开销
+struct FXSPBuildCost
+{
+	int64 NumTriangles = 0;
+	int64 NumBytes = 0;
+
+	//构建过程中每个三角形的预估内存:顶点/法线临时数组、网格描述和渲染数据
+	static constexpr int64 BytesPerTriangle = 512;
+
+	static FXSPBuildCost FromTriangles(int64 InNumTriangles)
+	{
+		FXSPBuildCost Cost;
+		Cost.NumTriangles = InNumTriangles;
+		Cost.NumBytes = InNumTriangles * BytesPerTriangle;
+		return Cost;
+	}
+};
+
+/**
+ * 网格体构建任务的准入控制
+ * 按同时进行的任务数、三角形数和内存三项上限限制进入线程池的构建任务,超出上限时提交方等待或稍后重试
+ * 没有任务在进行时总是准入,避免单个超大任务永远无法执行
+ */
+class XSPLOADER_API FXSPBuildBudget
+{
+public:
+	struct FLimits
+	{
+		int32 MaxInFlight = 0;
+		int64 MaxTriangles = 0;
+		int64 MaxBytes = 0;
+	};
+
+	FXSPBuildBudget();
+	~FXSPBuildBudget();
+
+	//由r.XSP.MaxInFlightBuilds/r.XSP.MaxInFlightTriangles/r.XSP.MaxInFlightMB决定的上限
+	static FLimits GetLimitsFromConsoleVariables();
+
+	void SetLimits(const FLimits& InLimits);
+
+	//尝试占用预算,不阻塞
+	bool TryAcquire(const FXSPBuildCost& Cost);
+
+	//阻塞直到占用成功,ShouldAbort返回true时放弃并返回false
+	bool Acquire(const FXSPBuildCost& Cost, TFunctionRef<bool()> ShouldAbort);
+
+	//任务结束后归还预算,唤醒等待者
+	void Release(const FXSPBuildCost& Cost);
+
+	//唤醒全部等待者,使其重新检查ShouldAbort
+	void WakeWaiters();
+
+	int32 GetNumInFlight() const { return NumInFlight; }
+	int64 GetNumTrianglesInFlight() const { return NumTrianglesInFlight; }
+	int64 GetNumBytesInFlight() const { return NumBytesInFlight; }
+
+private:
+	bool TryAcquireNoLock(const FXSPBuildCost& Cost);
+
+	FCriticalSection CS;
+	FLimits Limits;
+	int32 NumInFlight = 0;
+	int64 NumTrianglesInFlight = 0;
+	int64 NumBytesInFlight = 0;
+
+	//有预算被归还或上限改变时触发,手动重置,唤醒全部等待者各自重新检查,准入失败的等待者将其复位
+	FEvent* ReleasedEvent = nullptr;
+	//等待预算时重新检查放弃条件的间隔
+	static constexpr uint32 AbortCheckIntervalMs = 50;
+};
@@ -0,0 +1,47 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/GCObject.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class AActor;
+class UStaticMeshComponent;
+
+/**
+ * 静态网格组件的回收池(只在Game线程使用)
+ * 组件在网格体就绪时才从池中取出,网格体被淘汰时注销后归还,取出的组件都是未注册的,由使用者设置好后再(批量)注册;
+ * 池中的组件全部创建在Owner上并挂接到其根组件,组件的个数只与同时常驻的网格体数有关,与节点总数无关
+ */
+class XSPLOADER_API FXSPComponentPool : public FGCObject
+{
+public:
+	//设置创建组件的Actor,Owner变化时丢弃已有的组件
+	void Init(AActor* InOwner);
+	void Reset();
+
+	bool IsValid() const { return Owner.IsValid(); }
+
+	//取出一个组件,没有空闲的组件时新建;Owner无效时返回nullptr
+	UStaticMeshComponent* Acquire();
+
+	//注销组件,清空其网格体和材质并放回池中
+	void Release(UStaticMeshComponent* Component);
+
+	//创建过的组件总数、正在使用的和空闲的组件数
+	int32 GetNumCreated() const { return NumCreated; }
+	int32 GetNumInUse() const { return NumCreated - FreeComponents.Num(); }
+	int32 GetNumFree() const { return FreeComponents.Num(); }
+
+	//FGCObject
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override { return TEXT("FXSPComponentPool"); }
+
+private:
+	TWeakObjectPtr<AActor> Owner;
+	//池创建的全部组件,保证其在归还之前不被回收
+	TArray<UStaticMeshComponent*> Components;
+	TArray<UStaticMeshComponent*> FreeComponents;
+	int32 NumCreated = 0;
+};
@@ -0,0 +1,61 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 合并构建完成的网格体到场景时的帧时间预算(只在Game线程使用)
+ * 以r.XSP.TargetFrameTime为目标帧时间,根据上一帧除合并以外的Game线程耗时计算本帧可用于合并的时间,
+ * 并按实测的单次合并耗时决定本帧还能合并多少个;预算被限制在[r.XSP.MinMergeTime, r.XSP.MaxMergeTime]内
+ * 同时记录最近若干个有合并发生的帧的合并耗时,用于统计流式加载对帧时间的影响
+ */
+class XSPLOADER_API FXSPMergeBudget
+{
+public:
+	FXSPMergeBudget();
+
+	//每帧合并开始前调用
+	void BeginFrame(float DeltaTime);
+
+	//本帧是否还能再合并一个,每帧至少允许合并一个以保证进度
+	bool CanMergeMore() const;
+
+	//记录一次合并的耗时(秒)
+	void RecordMerge(double Seconds);
+
+	//批量合并:每次合并只记录设置组件的耗时,并按上一批的平摊耗时预估注册的耗时;
+	//本批全部组件注册完成后调用RecordBatch,以实际的注册耗时替换预估,平摊到本批的每次合并
+	void RecordPendingMerge(double Seconds);
+	void RecordBatch(double Seconds);
+
+	//每帧合并结束后调用
+	void EndFrame();
+
+	//本帧可用于合并的时间(秒)
+	double GetFrameBudget() const { return FrameBudget; }
+
+	//单次合并耗时的滑动平均(秒)
+	double GetAverageMergeCost() const { return AverageMergeCost; }
+
+	int32 GetNumMergedThisFrame() const { return NumMergedThisFrame; }
+
+	//最近有合并发生的帧中,合并耗时的百分位数(毫秒),Percentile取值[0, 1]
+	float GetFrameImpactPercentile(float Percentile) const;
+
+private:
+	double FrameBudget = 0;
+	double AverageMergeCost = 0;
+	double LastFrameMergeTime = 0;
+	double FrameMergeTime = 0;
+	int32 NumMergedThisFrame = 0;
+
+	//批量注册平摊到每次合并的耗时,以及本批尚未注册的合并
+	double AverageBatchCost = 0;
+	double PendingMergeTime = 0;
+	int32 NumPendingMerges = 0;
+
+	static constexpr int32 NumImpactSamples = 256;
+	TArray<float> ImpactSamples;
+	int32 NextImpactSample = 0;
+};
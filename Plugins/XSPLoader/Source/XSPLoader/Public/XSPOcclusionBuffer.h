@@ -0,0 +1,77 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * CPU上的低分辨率遮挡缓冲
+ * 每帧先光栅化若干个近处遮挡体的三角形,再测试候选包围盒是否被完全遮挡,不依赖GPU,可在发起加载请求之前剔除被遮挡的节点
+ * 深度以1/W保存(越大越近),遮挡体写入较近的深度;光栅化和测试都以4个像素为一组用SIMD计算
+ * 遮挡体的覆盖是保守的:只写入整个像素都在三角形内的像素,深度取像素范围内最远处,因此被判为遮挡的包围盒一定不可见;
+ * 代价是三角形的公共边经过的像素不被写入,遮挡体须是真实的几何体(不能用包围盒代替,包围盒内的几何体通常是空心或稀疏的)
+ * 缓冲按8x8像素分块,Finalize时记录每块中最远的遮挡深度,测试时整块都比候选包围盒近的块不再逐像素比较
+ * 坐标相对于视点,以保证大场景下的浮点精度;穿过近平面的遮挡三角形被跳过,穿过近平面的候选包围盒视为可见
+ * 添加遮挡体只能在一个线程进行,Finalize之后IsVisible可由任意线程同时调用
+ */
+class XSPLOADER_API FXSPOcclusionBuffer
+{
+public:
+	static constexpr int32 TileSize = 8;
+
+	//分辨率向上取整为TileSize的倍数
+	void Init(int32 InWidth, int32 InHeight);
+
+	/**
+	 *	清空缓冲并设置本帧的视图
+	 *	@param	InViewOrigin				[in]	视点
+	 *	@param	TranslatedViewProjMatrix	[in]	以视点为原点的视图投影矩阵
+	 *	@param	InNearClip					[in]	近平面距离,W小于此值的顶点视为穿过近平面
+	 */
+	void Clear(const FVector& InViewOrigin, const FMatrix& TranslatedViewProjMatrix, float InNearClip);
+
+	//光栅化一个遮挡体的三角形(世界空间,每3个顶点一个三角形),没有三角形被光栅化时返回false
+	bool AddOccluder(TArrayView<const FVector3f> TriangleVertices);
+
+	//添加完遮挡体后调用
+	void Finalize();
+
+	//包围盒是否有部分未被遮挡
+	bool IsVisible(const FBox3f& Box) const;
+
+	int32 GetWidth() const { return Width; }
+	int32 GetHeight() const { return Height; }
+	int32 GetNumOccluders() const { return NumOccluders; }
+
+private:
+	struct FScreenVertex
+	{
+		float X;
+		float Y;
+		float InvW;
+	};
+
+	//将以视点为原点的点投影到屏幕,穿过近平面时返回false
+	bool ProjectPoint(const FVector3f& TranslatedPoint, FScreenVertex& OutVertex) const;
+
+	//将包围盒的8个角点投影到屏幕,有角点穿过近平面时返回false
+	bool ProjectBox(const FBox3f& Box, FScreenVertex OutVertices[8]) const;
+
+	//保守光栅化,返回是否写入了像素
+	bool RasterizeTriangle(const FScreenVertex& V0, const FScreenVertex& V1, const FScreenVertex& V2);
+
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 NumTilesX = 0;
+	int32 NumTilesY = 0;
+
+	FVector ViewOrigin = FVector::ZeroVector;
+	FMatrix44f ViewProjMatrix = FMatrix44f::Identity;
+	float NearClip = 1.0f;
+	int32 NumOccluders = 0;
+
+	//逐像素的遮挡深度(1/W),没有遮挡体的像素为0
+	TArray<float, TAlignedHeapAllocator<16>> Depth;
+	//每块中最远的遮挡深度
+	TArray<float> TileMinDepth;
+};
@@ -0,0 +1,77 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class UStaticMesh;
+class UStaticMeshComponent;
+
+/**
+ * 已加载网格体的常驻内存预算(只在Game线程使用)
+ * 记录每个已设置到组件上的网格体的内存估算(CPU + GPU)和最近一次可见的帧号,
+ * 总量超过r.XSP.MemoryBudgetMB时,按最近可见的帧从早到晚淘汰,直到降到预算的r.XSP.EvictLowWatermark以下;
+ * 常驻的网格体按最近可见的帧串成LRU链表,可见时移到表尾,淘汰时从表头取,不需要每帧扫描和排序;
+ * 连续不可见未满r.XSP.EvictMinInvisibleFrames帧的网格体不会被淘汰,避免在视锥边缘反复加载和卸载
+ */
+class XSPLOADER_API FXSPResidencyBudget
+{
+public:
+	struct FResidentMesh
+	{
+		int32 Dbid;
+		int64 NumBytes;
+		uint64 LastVisibleFrame;
+		TWeakObjectPtr<UStaticMeshComponent> Component;
+		TWeakObjectPtr<UStaticMesh> StaticMesh;
+		//组件取自组件池,淘汰时归还
+		bool bPooled;
+	};
+
+	void Init(int32 NumNodes);
+	void Reset();
+
+	//网格体设置到组件上后调用,同一dbid已常驻时替换原记录
+	void AddResident(int32 Dbid, UStaticMeshComponent* Component, UStaticMesh* StaticMesh, int64 NumBytes, uint64 FrameNumber, bool bPooled);
+
+	//记录节点在本帧可见,不常驻的节点被忽略
+	void MarkVisible(int32 Dbid, uint64 FrameNumber);
+
+	bool IsResident(int32 Dbid) const { return ResidentIndices.IsValidIndex(Dbid) && ResidentIndices[Dbid] != INDEX_NONE; }
+
+	//常驻的网格体的记录,不常驻时返回nullptr
+	const FResidentMesh* FindResident(int32 Dbid) const { return IsResident(Dbid) ? &ResidentMeshes[ResidentIndices[Dbid]] : nullptr; }
+
+	//超出预算时取出本帧应淘汰的网格体并移除其记录,未超出预算时不输出
+	void CollectEvictions(uint64 FrameNumber, TArray<FResidentMesh>& OutEvictions);
+
+	int32 GetNumResident() const { return ResidentMeshes.Num(); }
+	int64 GetResidentBytes() const { return ResidentBytes; }
+	//预算(字节),0表示不限
+	static int64 GetBudgetBytes();
+
+	//估算网格体占用的内存:CPU端取资源大小,GPU端按顶点和索引数计算
+	static int64 EstimateMeshBytes(UStaticMesh* StaticMesh);
+
+private:
+	void RemoveAt(int32 Index);
+
+	//LRU链表的操作,按dbid链接
+	void LinkTail(int32 Dbid);
+	void Unlink(int32 Dbid);
+
+	TArray<FResidentMesh> ResidentMeshes;
+	//按dbid索引ResidentMeshes中的位置,不常驻为INDEX_NONE
+	TArray<int32> ResidentIndices;
+	int64 ResidentBytes = 0;
+
+	//按最近可见的帧从早到晚排列的双向链表,帧号单调递增,可见的节点移到表尾即保持有序
+	TArray<int32> LruPrev;
+	TArray<int32> LruNext;
+	int32 LruHead = INDEX_NONE;
+	int32 LruTail = INDEX_NONE;
+
+	//超出预算后进入淘汰状态,降到低水位以下才退出
+	bool bEvicting = false;
+};
@@ -0,0 +1,78 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "Templates/Function.h"
+#include "UObject/GCObject.h"
+
+class FEvent;
+class UStaticMesh;
+
+/**
+ * 可重复构建的静态网格对象池
+ * 空闲对象由Game线程逐帧补充到目标个数(每帧新建的个数有上限),任意线程都可从池中取出,避免请求突增时集中创建UObject;
+ * 归还的网格体先释放渲染资源,渲染线程释放完成后才回到空闲列表,之后可再次调用BuildFromMeshDescriptions
+ * 池持有其创建的全部对象,取出后仍由池保持引用,直到空闲个数超出上限被丢弃或Reset
+ */
+class XSPLOADER_API FXSPStaticMeshPool : public FGCObject
+{
+public:
+	FXSPStaticMeshPool();
+	virtual ~FXSPStaticMeshPool();
+
+	//丢弃全部对象,由GC回收;须确保没有线程仍在使用取出的对象
+	void Reset();
+
+	//Game线程每帧调用:推进归还中的对象,把空闲对象补充到TargetFree个,最多新建MaxCreations个,超出2倍TargetFree的空闲对象被丢弃
+	void Tick(int32 TargetFree, int32 MaxCreations);
+
+	//取出一个空闲对象,没有时返回nullptr,可在任意线程调用
+	UStaticMesh* TryAcquire();
+
+	//等待直到取出一个空闲对象,ShouldAbort返回true时放弃并返回nullptr
+	UStaticMesh* Acquire(TFunctionRef<bool()> ShouldAbort);
+
+	//取出一个空闲对象,没有时新建,只在Game线程调用
+	UStaticMesh* AcquireOrCreate();
+
+	//归还对象,只在Game线程调用;调用者须保证已没有组件使用该网格体
+	void Release(UStaticMesh* StaticMesh);
+
+	//唤醒全部等待者,使其重新检查ShouldAbort
+	void WakeWaiters();
+
+	int32 GetNumCreated() const { return NumCreated; }
+	int32 GetNumFree() const;
+	//归还后等待渲染资源释放的个数
+	int32 GetNumReleasing() const { return RetiredMeshes.Num() + ReleasingMeshes.Num(); }
+	//池为空时在Game线程新建的次数
+	int32 GetNumMisses() const { return NumMisses; }
+
+	//FGCObject
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override { return TEXT("FXSPStaticMeshPool"); }
+
+private:
+	UStaticMesh* CreateMesh();
+
+	//池创建的全部对象,只在Game线程修改
+	TSet<UStaticMesh*> Meshes;
+
+	mutable FCriticalSection FreeCS;
+	TArray<UStaticMesh*> FreeMeshes;
+
+	//本帧归还的对象,组件的渲染状态在帧末才更新,下一帧再释放渲染资源
+	TArray<UStaticMesh*> RetiredMeshes;
+	//已发出释放渲染资源的命令,等待渲染线程完成
+	TArray<UStaticMesh*> ReleasingMeshes;
+
+	int32 NumCreated = 0;
+	int32 NumMisses = 0;
+
+	//有对象回到空闲列表时触发,手动重置,空闲列表被取空后由等待者复位
+	FEvent* FreeEvent = nullptr;
+	//等待空闲对象时重新检查放弃条件的间隔
+	static constexpr uint32 AbortCheckIntervalMs = 50;
+};
@@ -0,0 +1,63 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 单个节点三角形的二叉BVH,用于不依赖物理碰撞的射线拾取
+ * 按三角形中心所在包围盒最长轴的中点划分,叶节点最多LeafSize个三角形;顶点按叶节点的顺序重排后连续存放
+ * 查询时先访问较近的子节点,子节点的进入距离超过已有的最近命中时剪掉整棵子树
+ * 构建完成后只读,可由任意线程同时查询;查询结果为构建时的三角形序号
+ */
+class XSPLOADER_API FXSPTriangleBVH
+{
+public:
+	static constexpr int32 LeafSize = 4;
+
+	//由三角形顶点列表构建,每3个顶点一个三角形
+	void Build(TArrayView<const FVector3f> TriangleVertices);
+
+	void Empty();
+
+	bool IsEmpty() const { return Nodes.Num() == 0; }
+
+	int32 NumTriangles() const { return TriangleIndices.Num(); }
+
+	int32 NumNodes() const { return Nodes.Num(); }
+
+	SIZE_T GetAllocatedSize() const;
+
+	const FBox3f& GetBounds() const { return Bounds; }
+
+	//全部三角形的顶点,每3个顶点一个三角形,顺序与构建时不同
+	TArrayView<const FVector3f> GetVertices() const { return Vertices; }
+
+	/**
+	 *	最近的射线命中,三角形双面可拾取
+	 *	@param	MaxDistance		[in]	只查找此距离以内的命中
+	 *	@param	OutTriangle		[out]	命中的三角形序号
+	 *	@param	OutDistance		[out]	命中点到起点的距离
+	 *	@param	OutNormal		[out]	可选,命中三角形按顶点顺序的法线
+	 *	@return	没有命中时返回false,输出参数保持不变
+	 */
+	bool RayCast(const FVector3f& Origin, const FVector3f& Direction, float MaxDistance, int32& OutTriangle, float& OutDistance, FVector3f* OutNormal = nullptr) const;
+
+private:
+	struct FNode
+	{
+		FVector3f Min;
+		//叶节点为第一个三角形在重排后的位置,内部节点为左子节点的位置(右子节点紧随其后)
+		int32 First;
+		FVector3f Max;
+		//叶节点的三角形个数,内部节点为0
+		int32 Count;
+	};
+
+	TArray<FNode> Nodes;
+	//按叶节点顺序重排后的三角形顶点
+	TArray<FVector3f> Vertices;
+	//重排后的三角形对应的原始序号
+	TArray<int32> TriangleIndices;
+	FBox3f Bounds = FBox3f(ForceInit);
+};
@@ -15,6 +15,7 @@ public class Demo : ModuleRules
                 "MeshConversion",
                 "MeshDescription",
                 "StaticMeshDescription",
+				"MeshUtils",
 				"XSPLoader"
 			});
 
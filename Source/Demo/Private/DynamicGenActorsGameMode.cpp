@@ -6,7 +6,11 @@
 #include "MeshDescription.h"
 #include "MeshDescriptionBuilder.h"
 #include "StaticMeshAttributes.h"
+#include "StaticMeshResources.h"
+#include "PhysicsEngine/BodySetup.h"
 #include "Math/UnrealMathUtility.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Sort.h"
 
 #include <iostream>
 #include <fstream>
@@ -27,7 +31,27 @@ FAutoConsoleVariableRef CVarBatchNodes(
     TEXT("r.My.BatchNodes"),
     GBatchNodes,
     TEXT("Build static mesh in a batch.\n")
-    TEXT(" 0: off(default)\n"),
+    TEXT(" 0: off(default)\n")
+    TEXT(" 1: all nodes in one mesh\n")
+    TEXT(" 2: one mesh per spatial cluster of nodes with the same material\n"),
+    ECVF_Default
+);
+
+static int32 GClusterMaxTriangles = 65536;
+FAutoConsoleVariableRef CVarClusterMaxTriangles(
+    TEXT("r.My.ClusterMaxTriangles"),
+    GClusterMaxTriangles,
+    TEXT("Maximum number of triangles in a cluster when r.My.BatchNodes is 2, smaller clusters cull finer at the cost of more draw calls.\n")
+    TEXT(" 65536: default\n"),
+    ECVF_Default
+);
+
+static int32 GBatchRegister = 1;
+FAutoConsoleVariableRef CVarBatchRegister(
+    TEXT("r.My.BatchRegister"),
+    GBatchRegister,
+    TEXT("Register the components added to the scene in a frame together after all of them are set up.\n")
+    TEXT(" 1: on(default)\n"),
     ECVF_Default
 );
 
@@ -405,7 +429,25 @@ void AppendNodeMesh(const Body_info& Node, TArray<FVector>& VertexList)
     }
 }
 
-int32 BuildStaticMesh(UStaticMesh* StaticMesh, const TArray<FVector>& VertexList)
+//按fragment类型预估构建开销,与AppendNodeMesh的细分方式一致
+FXSPBuildCost EstimateBuildCost(const Body_info& Node)
+{
+    int64 NumTriangles = 0;
+    for (size_t i = 0, i_len = Node.fragment.size(); i < i_len; i++)
+    {
+        const Body_info& Fragment = Node.fragment[i];
+        if (Fragment.name == "Mesh")
+            NumTriangles += Fragment.vertices.size() / 9;
+        else if (Fragment.name == "Elliptical")
+            NumTriangles += 18;
+        else if (Fragment.name == "Cylinder")
+            NumTriangles += 36;
+    }
+    return FXSPBuildCost::FromTriangles(NumTriangles);
+}
+
+// bComplexCollision为true时保留CPU端的顶点和索引数据,构建后在Game线程由SetupComplexCollision以三角形建立碰撞
+int32 BuildStaticMesh(UStaticMesh* StaticMesh, const TArray<FVector>& VertexList, bool bComplexCollision = false)
 {
     if (GDummyRun > 0)
         return VertexList.Num() / 3;
@@ -445,6 +487,7 @@ int32 BuildStaticMesh(UStaticMesh* StaticMesh, const TArray<FVector>& VertexList
     BuildParams.bMarkPackageDirty = false;
     BuildParams.bBuildSimpleCollision = false;
     BuildParams.bFastBuild = true;
+    BuildParams.bAllowCpuAccess = bComplexCollision;
 
     TArray<const FMeshDescription*> MeshDescPtrs;
     MeshDescPtrs.Emplace(&MeshDesc);
@@ -476,6 +519,36 @@ int32 BuildStaticMesh(UStaticMesh* StaticMesh, std::vector<Body_info*>& NodeList
     return BuildStaticMesh(StaticMesh, VertexList);
 }
 
+//合并一组节点,记录每个节点的三角形范围,隐藏的节点不输出三角形;构建复杂碰撞,以便由射线检测返回的三角形序号查找节点
+int32 BuildStaticMesh(UStaticMesh* StaticMesh, const std::vector<Body_info*>& NodeList, const TBitArray<>& HiddenMask, TArray<ADynamicGenActorsGameMode::FNodeFaceRange>& OutFaceRanges)
+{
+    TArray<FVector> VertexList;
+    OutFaceRanges.Reset(NodeList.size());
+    for (int32 i = 0, Num = NodeList.size(); i < Num; i++)
+    {
+        int32 StartFaceIndex = VertexList.Num() / 3;
+        if (!HiddenMask[i])
+        {
+            AppendNodeMesh(*NodeList[i], VertexList);
+        }
+        OutFaceRanges.Add({ NodeList[i]->dbid, StartFaceIndex, VertexList.Num() / 3 - StartFaceIndex });
+    }
+    if (VertexList.Num() < 3)
+        return 0;
+    return BuildStaticMesh(StaticMesh, VertexList, true);
+}
+
+// 以渲染数据的三角形建立复杂碰撞并用作简单碰撞,射线检测命中三角形并返回FaceIndex;只在Game线程调用
+// 取自池中的网格体可能保留上次构建的碰撞数据,先使其失效再重新生成
+void SetupComplexCollision(UStaticMesh* StaticMesh)
+{
+    StaticMesh->CreateBodySetup();
+    UBodySetup* BodySetup = StaticMesh->GetBodySetup();
+    BodySetup->CollisionTraceFlag = CTF_UseComplexAsSimple;
+    BodySetup->InvalidatePhysicsData();
+    BodySetup->CreatePhysicsMeshes();
+}
+
 UMaterialInstanceDynamic* CreateMaterialInstanceDynamic(UMaterialInterface* SourceMaterial, const FLinearColor& Color, float Roughness)
 {
     UMaterialInstanceDynamic* MaterialInstanceDynamic = UMaterialInstanceDynamic::Create(SourceMaterial, nullptr);
@@ -495,10 +568,11 @@ void ADynamicGenActorsGameMode::FLoadFileTask::DoWork()
 class FBuildStaticMeshTask : public FNonAbandonableTask
 {
 public:
-    FBuildStaticMeshTask(ADynamicGenActorsGameMode* InGameMode, UStaticMesh* InStaticMesh, Body_info* InNode)
+    FBuildStaticMeshTask(ADynamicGenActorsGameMode* InGameMode, UStaticMesh* InStaticMesh, Body_info* InNode, const FXSPBuildCost& InCost)
         : GameMode(InGameMode)
         , StaticMesh(InStaticMesh)
         , Node(InNode)
+        , Cost(InCost)
     {
     }
     ~FBuildStaticMeshTask()
@@ -518,6 +592,9 @@ public:
         LoadedData.StaticMesh = StaticMesh;
         GetMaterial(Node, LoadedData.Color, LoadedData.Roughness);
         GameMode->LoadedNodes.Enqueue(LoadedData);
+
+        // 归还构建预算
+        GameMode->BuildBudget.Release(Cost);
     }
 
     TStatId GetStatId() const
@@ -529,6 +606,62 @@ private:
     ADynamicGenActorsGameMode* GameMode;
     UStaticMesh* StaticMesh;
     Body_info* Node;
+    FXSPBuildCost Cost;
+};
+
+// 异步构建一个簇的静态网格的任务类
+class FBuildClusterTask : public FNonAbandonableTask
+{
+public:
+    FBuildClusterTask(ADynamicGenActorsGameMode* InGameMode, UStaticMesh* InStaticMesh, int32 InClusterIndex, const FXSPBuildCost& InCost)
+        : GameMode(InGameMode)
+        , StaticMesh(InStaticMesh)
+        , ClusterIndex(InClusterIndex)
+        , Cost(InCost)
+    {
+        // 节点列表和隐藏状态在Game线程复制,构建期间簇的记录可能被修改
+        const ADynamicGenActorsGameMode::FNodeCluster& Cluster = GameMode->Clusters[ClusterIndex];
+        Nodes = Cluster.Nodes;
+        Color = Cluster.Color;
+        Roughness = Cluster.Roughness;
+        HiddenMask.Init(false, Nodes.size());
+        for (int32 i = 0, Num = Nodes.size(); i < Num; i++)
+        {
+            HiddenMask[i] = GameMode->HiddenNodes.Contains(Nodes[i]->dbid);
+        }
+    }
+
+    void DoWork()
+    {
+        ADynamicGenActorsGameMode::FLoadedData LoadedData;
+
+        LoadedData.NumTriangles = BuildStaticMesh(StaticMesh, Nodes, HiddenMask, LoadedData.FaceRanges);
+
+        // 全部节点都被隐藏时不设置网格体
+        LoadedData.Name = FName(FString::Printf(TEXT("Cluster_%d"), ClusterIndex));
+        LoadedData.StaticMesh = LoadedData.NumTriangles > 0 ? StaticMesh : nullptr;
+        LoadedData.Color = Color;
+        LoadedData.Roughness = Roughness;
+        LoadedData.ClusterIndex = ClusterIndex;
+        GameMode->LoadedNodes.Enqueue(LoadedData);
+
+        GameMode->BuildBudget.Release(Cost);
+    }
+
+    TStatId GetStatId() const
+    {
+        return TStatId();
+    }
+
+private:
+    ADynamicGenActorsGameMode* GameMode;
+    UStaticMesh* StaticMesh;
+    int32 ClusterIndex;
+    FXSPBuildCost Cost;
+    std::vector<Body_info*> Nodes;
+    TBitArray<> HiddenMask;
+    FLinearColor Color;
+    float Roughness;
 };
 
 ADynamicGenActorsGameMode::ADynamicGenActorsGameMode()
@@ -574,6 +707,18 @@ void ADynamicGenActorsGameMode::Tick(float DeltaSeconds)
 {
     Super::Tick(DeltaSeconds);
 
+    // 读取文件和加载场景期间逐帧补充静态网格对象,个数与构建预算相当
+    int32 MaxInFlight = FXSPBuildBudget::GetLimitsFromConsoleVariables().MaxInFlight;
+    if (CurrentLoadPhase == ELoadPhase::LP_LoadingFile || CurrentLoadPhase == ELoadPhase::LP_LoadingScene)
+    {
+        MeshPool.Tick(MaxInFlight * 2, MaxInFlight);
+    }
+    else if (CurrentLoadPhase == ELoadPhase::LP_Finished && Clusters.Num() > 0)
+    {
+        // 重建簇时替换下的网格体归还到池中,释放渲染资源后供之后的重建复用,不再预先新建
+        MeshPool.Tick(MaxInFlight, 0);
+    }
+
     if (CurrentLoadPhase == ELoadPhase::LP_LoadingFile)
     {
         if (AsyncLoadFileTask)
@@ -604,34 +749,67 @@ void ADynamicGenActorsGameMode::Tick(float DeltaSeconds)
     {
         if (NumLoadedNodes < NumValidNodes)
         {
-            int64 BeginTicks = FDateTime::Now().GetTicks();
-
-            // 从完成队列取出静态网格加入场景
-            FLoadedData LoadedData;
-            while (LoadedNodes.Dequeue(LoadedData))
-            {
-                AddToScene(&LoadedData);
-                NumLoadedNodes++;
-                NumTotoalTriangles += LoadedData.NumTriangles;
-
-                FString Message = FString::Printf(TEXT("图元加载中 (%d / %d) ..."), NumLoadedNodes, NumValidNodes);
-                GEngine->AddOnScreenDebugMessage(0, 5.0f, FColor::Red, Message, true);
+            IssueBuildTasks();
+            MergeLoadedNodes(DeltaSeconds);
 
-                // 每帧最多给0.07秒用于合并新网格到场景中，以保证一定的帧率
-                if ((float)(FDateTime::Now().GetTicks() - BeginTicks) / ETimespan::TicksPerSecond >= 0.07f)
-                    break;
-            }
+            FString Message = FString::Printf(TEXT("图元加载中 (%d / %d) ..."), NumLoadedNodes, NumValidNodes);
+            GEngine->AddOnScreenDebugMessage(0, 5.0f, FColor::Red, Message, true);
         }
         else
         {
             CurrentLoadPhase = ELoadPhase::LP_Finished;
+            // 取出的对象由StaticMeshList持有,剩余的空闲对象交给GC回收
+            MeshPool.Reset();
 
             FString Message = FString::Printf(TEXT("加载完成 (%d)"), NumLoadedNodes);
             GEngine->AddOnScreenDebugMessage(0, 10.0f, FColor::Green, Message, true);
 
-            UE_LOG(LogDynamicGenActorsDemo, Display, TEXT("统计结果: \n\t节点数=%d\n\t三角形数=%d"), NumValidNodes, NumTotoalTriangles);
+            UE_LOG(LogDynamicGenActorsDemo, Display, TEXT("统计结果: \n\t节点数=%d\n\t簇数=%d\n\t三角形数=%d\n\t合并耗时p50=%.2fms p99=%.2fms"),
+                NumValidNodes, Clusters.Num(), NumTotoalTriangles, MergeBudget.GetFrameImpactPercentile(0.5f), MergeBudget.GetFrameImpactPercentile(0.99f));
+
+            if (Clusters.Num() > 0 && GDummyRun <= 0)
+            {
+                VerifyClusterPicking();
+            }
+        }
+    }
+    else if (CurrentLoadPhase == ELoadPhase::LP_Finished && Clusters.Num() > 0)
+    {
+        // 隐藏或显示节点后重建的簇
+        IssueClusterBuildTasks();
+        MergeLoadedNodes(DeltaSeconds);
+    }
+}
+
+void ADynamicGenActorsGameMode::MergeLoadedNodes(float DeltaSeconds)
+{
+    // 从完成队列取出静态网格加入场景，合并个数由帧时间预算根据实测的合并耗时自适应决定，以保证一定的帧率
+    MergeBudget.BeginFrame(DeltaSeconds);
+    FLoadedData LoadedData;
+    const bool bBatchRegister = GBatchRegister > 0;
+    while (MergeBudget.CanMergeMore() && LoadedNodes.Dequeue(LoadedData))
+    {
+        double BeginTime = FPlatformTime::Seconds();
+        AddToScene(&LoadedData, bBatchRegister);
+        if (bBatchRegister)
+            MergeBudget.RecordPendingMerge(FPlatformTime::Seconds() - BeginTime);
+        else
+            MergeBudget.RecordMerge(FPlatformTime::Seconds() - BeginTime);
+
+        if (LoadedData.NumNodes > 0)
+        {
+            NumLoadedNodes += LoadedData.NumNodes;
+            NumTotoalTriangles += LoadedData.NumTriangles;
         }
     }
+    // 本帧加入的组件一起注册，图元批量加入场景
+    if (ComponentRegistrar.Num() > 0)
+    {
+        double BeginTime = FPlatformTime::Seconds();
+        ComponentRegistrar.Flush();
+        MergeBudget.RecordBatch(FPlatformTime::Seconds() - BeginTime);
+    }
+    MergeBudget.EndFrame();
 }
 
 void ADynamicGenActorsGameMode::LoadScene()
@@ -639,85 +817,335 @@ void ADynamicGenActorsGameMode::LoadScene()
     NumLoadedNodes = 0;
     NumValidNodes = 0;
     int32 NumNodes = NodeDataList.size();
+    NextNodeToBuild = NumNodes;
 
-    if (GBatchNodes > 0)
+    // 合批模式在Game线程将全部节点构建为一个静态网格
+    if (GBatchNodes == 1)
     {
         NumValidNodes = 1;
         StaticMeshList.Add(NewObject<UStaticMesh>());
+
+        FLoadedData LoadedData;
+
+        LoadedData.NumTriangles = BuildStaticMesh(StaticMeshList[0], NodeDataList);
+        LoadedData.Name = FName(FString::FromInt(0));
+        LoadedData.StaticMesh = StaticMeshList[0];
+        GetMaterial(nullptr, LoadedData.Color, LoadedData.Roughness);
+        LoadedNodes.Enqueue(LoadedData);
+        return;
     }
-    else
+
+    StaticMeshList.SetNumZeroed(NumNodes);
+    for (int32 i = 0; i < NumNodes; i++)
+    {
+        if (CheckNode(*NodeDataList[i]))
+        {
+            NumValidNodes++;
+        }
+        else
+        {
+            // 释放空的Node对象
+            delete NodeDataList[i];
+            NodeDataList[i] = nullptr;
+        }
+    }
+
+    // 聚簇模式按簇异步构建,不受r.My.AsyncBuild影响
+    if (GBatchNodes == 2)
+    {
+        BuildClusters();
+        BuildBudget.SetLimits(FXSPBuildBudget::GetLimitsFromConsoleVariables());
+        IssueBuildTasks();
+        return;
+    }
+
+    //异步多线程构建静态网格对象,受构建预算限制,在Tick中逐帧分发
+    if (GBuildMeshAsync > 0) 
+    {
+        NextNodeToBuild = 0;
+        BuildBudget.SetLimits(FXSPBuildBudget::GetLimitsFromConsoleVariables());
+        IssueBuildTasks();
+    }
+    else // Game线程构建静态网格对象
     {
-        StaticMeshList.AddUninitialized(NumNodes);
         for (int32 i = 0; i < NumNodes; i++)
         {
-            if (CheckNode(*NodeDataList[i]))
-            {
-                NumValidNodes++;
-                // 必须在Game线程创建UObject派生对象
-                StaticMeshList[i] = NewObject<UStaticMesh>();
-            }
-            else
+            Body_info* Node = NodeDataList[i];
+            if (Node)
             {
-                // 释放空的Node对象
-                delete NodeDataList[i];
-                NodeDataList[i] = nullptr;
-                StaticMeshList[i] = nullptr;
+                UStaticMesh* StaticMesh = MeshPool.AcquireOrCreate();
+                StaticMeshList[i] = StaticMesh;
+
+                FLoadedData LoadedData;
+
+                LoadedData.NumTriangles = BuildStaticMesh(StaticMesh, *Node);
+
+                LoadedData.Name = FName(FString::FromInt(Node->dbid));
+                LoadedData.StaticMesh = StaticMesh;
+                GetMaterial(Node, LoadedData.Color, LoadedData.Roughness);
+                LoadedNodes.Enqueue(LoadedData);
             }
         }
     }
+}
 
-    //异步多线程构建静态网格对象
-    if (GBuildMeshAsync > 0) 
+void ADynamicGenActorsGameMode::BuildClusters()
+{
+    struct FClusterItem
     {
-        for (int32 i = 0; i < NumNodes; i++)
+        Body_info* Node;
+        FVector Center;
+        int64 NumTriangles;
+    };
+
+    // 颜色和粗糙度量化到8位作为材质的键,键相同的节点共用一个材质实例
+    TMap<uint32, TArray<FClusterItem>> MaterialGroups;
+    for (Body_info* Node : NodeDataList)
+    {
+        if (nullptr == Node)
+            continue;
+
+        FLinearColor Color;
+        float Roughness;
+        GetMaterial(Node, Color, Roughness);
+        FColor Quantized = Color.ToFColor(false);
+        Quantized.A = (uint8)FMath::Clamp(FMath::RoundToInt(Roughness * 255.f), 0, 255);
+
+        FVector Min(Node->box[0], Node->box[1], Node->box[2]);
+        FVector Max(Node->box[3], Node->box[4], Node->box[5]);
+        MaterialGroups.FindOrAdd(Quantized.DWColor()).Add({ Node, (Min + Max) * 0.5, EstimateBuildCost(*Node).NumTriangles });
+    }
+
+    // 按中心点包围盒的最长轴在中位数处二分,直到三角形数不超过上限或只剩一个节点
+    const int64 MaxTriangles = FMath::Max(1, GClusterMaxTriangles);
+    TFunction<void(TArrayView<FClusterItem>)> Split = [&](TArrayView<FClusterItem> Items) {
+        int64 NumTriangles = 0;
+        FBox CenterBounds(ForceInit);
+        for (const FClusterItem& Item : Items)
+        {
+            NumTriangles += Item.NumTriangles;
+            CenterBounds += Item.Center;
+        }
+
+        if (NumTriangles <= MaxTriangles || Items.Num() == 1)
         {
-            if (StaticMeshList[i])
+            FNodeCluster& Cluster = Clusters.AddDefaulted_GetRef();
+            GetMaterial(Items[0].Node, Cluster.Color, Cluster.Roughness);
+            Cluster.NumTriangles = NumTriangles;
+            Cluster.Nodes.reserve(Items.Num());
+            for (const FClusterItem& Item : Items)
             {
-                (new FAutoDeleteAsyncTask<FBuildStaticMeshTask>(this, StaticMeshList[i], NodeDataList[i]))->StartBackgroundTask();
+                Cluster.Nodes.push_back(Item.Node);
+                NodeClusterIndices.Add(Item.Node->dbid, Clusters.Num() - 1);
             }
+            return;
         }
+
+        FVector Extent = CenterBounds.GetExtent();
+        int32 Axis = Extent.X >= Extent.Y && Extent.X >= Extent.Z ? 0 : (Extent.Y >= Extent.Z ? 1 : 2);
+        Algo::SortBy(Items, [Axis](const FClusterItem& Item) { return Item.Center[Axis]; });
+        int32 Mid = Items.Num() / 2;
+        Split(Items.Left(Mid));
+        Split(Items.RightChop(Mid));
+    };
+
+    for (auto& Pair : MaterialGroups)
+    {
+        Split(Pair.Value);
     }
-    else // Game线程构建静态网格对象
+
+    StaticMeshList.SetNumZeroed(Clusters.Num());
+    ClusterBuildQueue.Reserve(Clusters.Num());
+    for (int32 i = 0; i < Clusters.Num(); i++)
     {
+        Clusters[i].bBuildQueued = true;
+        ClusterBuildQueue.Add(i);
+    }
+    UE_LOG(LogDynamicGenActorsDemo, Display, TEXT("聚簇: %d个节点, %d种材质, %d个簇"), NodeClusterIndices.Num(), MaterialGroups.Num(), Clusters.Num());
+}
 
-        if (GBatchNodes > 0)
+void ADynamicGenActorsGameMode::IssueClusterBuildTasks()
+{
+    // 按加入队列的顺序分发,预算用尽时停止,剩余的在下一帧继续;上次构建未完成的簇留在队列中
+    int32 NumKept = 0;
+    int32 Index = 0;
+    for (; Index < ClusterBuildQueue.Num(); Index++)
+    {
+        int32 ClusterIndex = ClusterBuildQueue[Index];
+        FNodeCluster& Cluster = Clusters[ClusterIndex];
+        if (Cluster.bBuilding)
         {
-            FLoadedData LoadedData;
+            ClusterBuildQueue[NumKept++] = ClusterIndex;
+            continue;
+        }
+
+        FXSPBuildCost Cost = FXSPBuildCost::FromTriangles(Cluster.NumTriangles);
+        if (!BuildBudget.TryAcquire(Cost))
+            break;
+
+        // 重建时使用新的静态网格对象,旧的仍在渲染,替换后归还到池中
+        Cluster.bBuildQueued = false;
+        Cluster.bBuilding = true;
+        StaticMeshList[ClusterIndex] = MeshPool.AcquireOrCreate();
+        (new FAutoDeleteAsyncTask<FBuildClusterTask>(this, StaticMeshList[ClusterIndex], ClusterIndex, Cost))->StartBackgroundTask();
+    }
+    for (; Index < ClusterBuildQueue.Num(); Index++)
+    {
+        ClusterBuildQueue[NumKept++] = ClusterBuildQueue[Index];
+    }
+    ClusterBuildQueue.SetNum(NumKept, false);
+}
+
+void ADynamicGenActorsGameMode::VerifyClusterPicking() const
+{
+    // 取第一个有网格体的簇,沿其第一个三角形的法线穿过三角形中心做一次复杂射线检测,应命中该组件且FaceIndex为0
+    for (const FNodeCluster& Cluster : Clusters)
+    {
+        UStaticMesh* StaticMesh = Cluster.Component ? Cluster.Component->GetStaticMesh() : nullptr;
+        const FStaticMeshRenderData* RenderData = StaticMesh ? StaticMesh->GetRenderData() : nullptr;
+        if (nullptr == RenderData || RenderData->LODResources.Num() == 0 || RenderData->LODResources[0].IndexBuffer.GetNumIndices() < 3)
+            continue;
 
-            LoadedData.NumTriangles = BuildStaticMesh(StaticMeshList[0], NodeDataList);
-            LoadedData.Name = FName(FString::FromInt(0));
-            LoadedData.StaticMesh = StaticMeshList[0];
-            GetMaterial(nullptr, LoadedData.Color, LoadedData.Roughness);
-            LoadedNodes.Enqueue(LoadedData);
+        const FStaticMeshLODResources& LODResources = RenderData->LODResources[0];
+        const FPositionVertexBuffer& PositionBuffer = LODResources.VertexBuffers.PositionVertexBuffer;
+        const FTransform& Transform = Cluster.Component->GetComponentTransform();
+        FVector Corners[3];
+        for (int32 i = 0; i < 3; i++)
+        {
+            Corners[i] = Transform.TransformPosition(FVector(PositionBuffer.VertexPosition(LODResources.IndexBuffer.GetIndex(i))));
+        }
+        FVector Center = (Corners[0] + Corners[1] + Corners[2]) / 3;
+        FVector Normal = FVector::CrossProduct(Corners[1] - Corners[0], Corners[2] - Corners[0]).GetSafeNormal();
+
+        FCollisionQueryParams QueryParams;
+        QueryParams.bTraceComplex = true;
+        QueryParams.bReturnFaceIndex = true;
+        FHitResult HitResult;
+        bool bHit = Cluster.Component->LineTraceComponent(HitResult, Center + Normal * 10.0, Center - Normal * 10.0, QueryParams);
+        if (bHit && HitResult.FaceIndex == 0)
+        {
+            UE_LOG(LogDynamicGenActorsDemo, Display, TEXT("簇拾取检查通过: %s, FaceIndex=%d"), *Cluster.Component->GetName(), HitResult.FaceIndex);
         }
         else
         {
-            for (int32 i = 0; i < NumNodes; i++)
-            {
-                UStaticMesh* StaticMesh = StaticMeshList[i];
-                if (StaticMesh)
-                {
-                    Body_info* Node = NodeDataList[i];
+            UE_LOG(LogDynamicGenActorsDemo, Warning, TEXT("簇拾取检查失败: %s, 命中=%d, FaceIndex=%d"), *Cluster.Component->GetName(), bHit ? 1 : 0, HitResult.FaceIndex);
+        }
+        return;
+    }
+}
 
-                    FLoadedData LoadedData;
+int32 ADynamicGenActorsGameMode::FindNodeByFace(const UPrimitiveComponent* Component, int32 FaceIndex) const
+{
+    const int32* ClusterIndex = ComponentClusterIndices.Find(Component);
+    if (nullptr == ClusterIndex || FaceIndex < 0)
+        return INDEX_NONE;
+
+    // 最后一个起始序号不大于FaceIndex的范围,隐藏的节点范围为空,不会被命中
+    const TArray<FNodeFaceRange>& FaceRanges = Clusters[*ClusterIndex].FaceRanges;
+    int32 Index = Algo::UpperBoundBy(FaceRanges, FaceIndex, &FNodeFaceRange::StartFaceIndex) - 1;
+    while (FaceRanges.IsValidIndex(Index) && FaceRanges[Index].FaceCount == 0)
+    {
+        Index--;
+    }
+    if (!FaceRanges.IsValidIndex(Index) || FaceIndex >= FaceRanges[Index].StartFaceIndex + FaceRanges[Index].FaceCount)
+        return INDEX_NONE;
+    return FaceRanges[Index].Dbid;
+}
 
-                    LoadedData.NumTriangles = BuildStaticMesh(StaticMesh, *Node);
+void ADynamicGenActorsGameMode::SetNodeHidden(int32 Dbid, bool bHidden)
+{
+    const int32* ClusterIndex = NodeClusterIndices.Find(Dbid);
+    if (nullptr == ClusterIndex)
+        return;
+
+    bool bChanged = bHidden ? !HiddenNodes.Contains(Dbid) : HiddenNodes.Remove(Dbid) > 0;
+    if (!bChanged)
+        return;
+    if (bHidden)
+        HiddenNodes.Add(Dbid);
+
+    FNodeCluster& Cluster = Clusters[*ClusterIndex];
+    if (!Cluster.bBuildQueued)
+    {
+        Cluster.bBuildQueued = true;
+        ClusterBuildQueue.Add(*ClusterIndex);
+    }
+}
 
-                    LoadedData.Name = FName(FString::FromInt(Node->dbid));
-                    LoadedData.StaticMesh = StaticMesh;
-                    GetMaterial(Node, LoadedData.Color, LoadedData.Roughness);
-                    LoadedNodes.Enqueue(LoadedData);
-                }
-            }
+void ADynamicGenActorsGameMode::IssueBuildTasks()
+{
+    if (Clusters.Num() > 0)
+    {
+        IssueClusterBuildTasks();
+        return;
+    }
+
+    // 按节点顺序分发构建任务,预算用尽时停止,待已分发的任务完成归还预算后在下一帧继续
+    int32 NumNodes = NodeDataList.size();
+    while (NextNodeToBuild < NumNodes)
+    {
+        Body_info* Node = NodeDataList[NextNodeToBuild];
+        if (Node)
+        {
+            FXSPBuildCost Cost = EstimateBuildCost(*Node);
+            if (!BuildBudget.TryAcquire(Cost))
+                break;
+
+            // 必须在Game线程创建UObject派生对象,优先取用预先创建的
+            StaticMeshList[NextNodeToBuild] = MeshPool.AcquireOrCreate();
+            (new FAutoDeleteAsyncTask<FBuildStaticMeshTask>(this, StaticMeshList[NextNodeToBuild], Node, Cost))->StartBackgroundTask();
         }
+        NextNodeToBuild++;
     }
 }
 
-void ADynamicGenActorsGameMode::AddToScene(FLoadedData* LoadedData)
+void ADynamicGenActorsGameMode::AddToScene(FLoadedData* LoadedData, bool bDeferRegister)
 {
+    if (LoadedData->ClusterIndex != INDEX_NONE)
+    {
+        FNodeCluster& Cluster = Clusters[LoadedData->ClusterIndex];
+        Cluster.FaceRanges = MoveTemp(LoadedData->FaceRanges);
+        Cluster.bBuilding = false;
+        if (nullptr != LoadedData->StaticMesh && GDummyRun <= 0)
+        {
+            SetupComplexCollision(LoadedData->StaticMesh);
+        }
+        if (nullptr == LoadedData->StaticMesh)
+        {
+            // 全部节点都被隐藏,未构建的网格体直接归还
+            MeshPool.Release(StaticMeshList[LoadedData->ClusterIndex]);
+            StaticMeshList[LoadedData->ClusterIndex] = nullptr;
+        }
+        if (nullptr != Cluster.Component)
+        {
+            // 重建的簇替换已有组件的网格体,不计入加载的节点;替换下的网格体已没有组件使用,归还到池中
+            UStaticMesh* OldStaticMesh = Cluster.Component->GetStaticMesh();
+            Cluster.Component->SetStaticMesh(LoadedData->StaticMesh);
+            MeshPool.Release(OldStaticMesh);
+            LoadedData->NumNodes = 0;
+            return;
+        }
+        LoadedData->NumNodes = Cluster.Nodes.size();
+    }
+
     UStaticMeshComponent* StaticMeshComponent = NewObject<UStaticMeshComponent>(DataActor, LoadedData->Name);
     StaticMeshComponent->SetStaticMesh(LoadedData->StaticMesh);
     StaticMeshComponent->SetMaterial(0, CreateMaterialInstanceDynamic(SourceMaterial, LoadedData->Color, LoadedData->Roughness));
-    StaticMeshComponent->AttachToComponent(DataActor->GetRootComponent(), FAttachmentTransformRules::KeepRelativeTransform);
-    StaticMeshComponent->RegisterComponent();
+    if (bDeferRegister)
+    {
+        // 只记录挂接关系，注册时才真正挂接并创建渲染状态
+        StaticMeshComponent->SetupAttachment(DataActor->GetRootComponent());
+        ComponentRegistrar.Add(StaticMeshComponent);
+    }
+    else
+    {
+        StaticMeshComponent->AttachToComponent(DataActor->GetRootComponent(), FAttachmentTransformRules::KeepRelativeTransform);
+        StaticMeshComponent->RegisterComponent();
+    }
+
+    if (LoadedData->ClusterIndex != INDEX_NONE)
+    {
+        Clusters[LoadedData->ClusterIndex].Component = StaticMeshComponent;
+        ComponentClusterIndices.Add(StaticMeshComponent, LoadedData->ClusterIndex);
+    }
 }
\ No newline at end of file
@@ -3,7 +3,151 @@
 
 #include "DynamicLoadGameMode.h"
 #include "XSPLoaderModule.h"
-#include <fstream>
+#include "SceneManagement.h"
+#include "ConvexVolume.h"
+#include "Async/ParallelFor.h"
+#include "Stats/Stats.h"
+#include "UObject/UObjectArray.h"
+
+DECLARE_STATS_GROUP(TEXT("DynamicLoadDemo"), STATGROUP_DynamicLoadDemo, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Cull Nodes"), STAT_DemoCullNodes, STATGROUP_DynamicLoadDemo);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Culled Nodes"), STAT_DemoNumCulledNodes, STATGROUP_DynamicLoadDemo);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Visible Unloaded Nodes"), STAT_DemoNumVisibleNodes, STATGROUP_DynamicLoadDemo);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Requested Nodes"), STAT_DemoNumRequestedNodes, STATGROUP_DynamicLoadDemo);
+DECLARE_CYCLE_STAT(TEXT("Occlusion Cull"), STAT_DemoOcclusionCull, STATGROUP_DynamicLoadDemo);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Occluders"), STAT_DemoNumOccluders, STATGROUP_DynamicLoadDemo);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Occluded Nodes"), STAT_DemoNumOccludedNodes, STATGROUP_DynamicLoadDemo);
+DECLARE_CYCLE_STAT(TEXT("Select Proxies"), STAT_DemoSelectProxies, STATGROUP_DynamicLoadDemo);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Chosen Proxies"), STAT_DemoNumChosenProxies, STATGROUP_DynamicLoadDemo);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Covered Nodes"), STAT_DemoNumCoveredNodes, STATGROUP_DynamicLoadDemo);
+
+static int32 GBatchRequests = 1;
+FAutoConsoleVariableRef CVarBatchRequests(
+    TEXT("r.My.BatchRequests"),
+    GBatchRequests,
+    TEXT("Submit static mesh requests to XSPLoader in one batch per frame, compare the cost with 'stat XSPLoader'.\n")
+    TEXT(" 1: on(default)\n"),
+    ECVF_Default
+);
+
+static int32 GMaxRequestsPerFrame = 1000;
+FAutoConsoleVariableRef CVarMaxRequestsPerFrame(
+    TEXT("r.My.MaxRequestsPerFrame"),
+    GMaxRequestsPerFrame,
+    TEXT("Max number of visible nodes requested per frame, the largest on screen first.\n")
+    TEXT(" 1000: default\n"),
+    ECVF_Default
+);
+
+//距离分段:近段内的可见节点全部请求,中段和远段只请求投影屏幕尺寸达到阈值的节点,远段以外的节点被剔除
+static float GCullNearDistance = 10000.0f;
+FAutoConsoleVariableRef CVarCullNearDistance(
+    TEXT("r.My.CullNearDistance"),
+    GCullNearDistance,
+    TEXT("End of the near distance band (cm), visible nodes in it are always requested.\n")
+    TEXT(" 10000: default\n"),
+    ECVF_Default
+);
+
+static float GCullMidDistance = 50000.0f;
+FAutoConsoleVariableRef CVarCullMidDistance(
+    TEXT("r.My.CullMidDistance"),
+    GCullMidDistance,
+    TEXT("End of the middle distance band (cm).\n")
+    TEXT(" 50000: default\n"),
+    ECVF_Default
+);
+
+static float GCullFarDistance = 200000.0f;
+FAutoConsoleVariableRef CVarCullFarDistance(
+    TEXT("r.My.CullFarDistance"),
+    GCullFarDistance,
+    TEXT("End of the far distance band (cm), nodes beyond it are culled.\n")
+    TEXT(" 200000: default\n"),
+    ECVF_Default
+);
+
+static float GCullMidMinScreenSize = 0.002f;
+FAutoConsoleVariableRef CVarCullMidMinScreenSize(
+    TEXT("r.My.CullMidMinScreenSize"),
+    GCullMidMinScreenSize,
+    TEXT("Min screen size of nodes requested in the middle distance band.\n")
+    TEXT(" 0.002: default\n"),
+    ECVF_Default
+);
+
+static float GCullFarMinScreenSize = 0.01f;
+FAutoConsoleVariableRef CVarCullFarMinScreenSize(
+    TEXT("r.My.CullFarMinScreenSize"),
+    GCullFarMinScreenSize,
+    TEXT("Min screen size of nodes requested in the far distance band.\n")
+    TEXT(" 0.01: default\n"),
+    ECVF_Default
+);
+
+static int32 GOcclusionCulling = 0;
+FAutoConsoleVariableRef CVarOcclusionCulling(
+    TEXT("r.My.OcclusionCulling"),
+    GOcclusionCulling,
+    TEXT("Skip requests for visible nodes fully hidden behind the triangles of loaded nodes, tested with a CPU occlusion buffer.\n")
+    TEXT("Compare 'Requested Nodes' and 'Completed Triangles' with it on and off.\n")
+    TEXT(" 0: off(default)\n"),
+    ECVF_Default
+);
+
+static int32 GOcclusionMaxOccluders = 64;
+FAutoConsoleVariableRef CVarOcclusionMaxOccluders(
+    TEXT("r.My.OcclusionMaxOccluders"),
+    GOcclusionMaxOccluders,
+    TEXT("Max number of loaded nodes rasterized as occluders per frame, the largest on screen first.\n")
+    TEXT(" 64: default\n"),
+    ECVF_Default
+);
+
+static float GOcclusionMinOccluderScreenSize = 0.05f;
+FAutoConsoleVariableRef CVarOcclusionMinOccluderScreenSize(
+    TEXT("r.My.OcclusionMinOccluderScreenSize"),
+    GOcclusionMinOccluderScreenSize,
+    TEXT("Min screen size of loaded nodes used as occluders.\n")
+    TEXT(" 0.05: default\n"),
+    ECVF_Default
+);
+
+static int32 GOcclusionMaxOccluderTriangles = 20000;
+FAutoConsoleVariableRef CVarOcclusionMaxOccluderTriangles(
+    TEXT("r.My.OcclusionMaxOccluderTriangles"),
+    GOcclusionMaxOccluderTriangles,
+    TEXT("Loaded nodes with more triangles than this are not rasterized as occluders.\n")
+    TEXT(" 20000: default\n"),
+    ECVF_Default
+);
+
+static int32 GOcclusionMaxBuildsPerFrame = 4;
+FAutoConsoleVariableRef CVarOcclusionMaxBuildsPerFrame(
+    TEXT("r.My.OcclusionMaxBuildsPerFrame"),
+    GOcclusionMaxBuildsPerFrame,
+    TEXT("Max number of triangle builds issued per frame for occluder candidates that are not cached yet.\n")
+    TEXT(" 4: default\n"),
+    ECVF_Default
+);
+
+static int32 GHLOD = 1;
+FAutoConsoleVariableRef CVarHLOD(
+    TEXT("r.My.HLOD"),
+    GHLOD,
+    TEXT("Draw HLOD proxies of subtrees instead of their nodes when the proxy error is small on screen, compare 'Requested Nodes' with it on and off.\n")
+    TEXT(" 1: on(default)\n"),
+    ECVF_Default
+);
+
+static float GHLODMaxScreenError = 0.002f;
+FAutoConsoleVariableRef CVarHLODMaxScreenError(
+    TEXT("r.My.HLODMaxScreenError"),
+    GHLODMaxScreenError,
+    TEXT("Max geometric error of an HLOD proxy projected on screen, in the same unit as screen size.\n")
+    TEXT(" 0.002: default\n"),
+    ECVF_Default
+);
 
 DEFINE_LOG_CATEGORY_STATIC(LogDynamicLoadDemo, Log, All);
 
@@ -15,6 +159,9 @@ ADynamicLoadGameMode::ADynamicLoadGameMode()
 
 void ADynamicLoadGameMode::BeginPlay()
 {
+    double BeginTime = FPlatformTime::Seconds();
+    int32 NumUObjectsBefore = GUObjectArray.GetObjectArrayNumMinusAvailable();
+
     FString DataFilePath = FPaths::Combine(FPaths::ProjectDir(), TEXT("XSP"));
     TArray<FString> FileArray;
     IFileManager::Get().FindFiles(FileArray, *DataFilePath, TEXT(".xsp"));
@@ -23,28 +170,9 @@ void ADynamicLoadGameMode::BeginPlay()
         UE_LOG(LogDynamicLoadDemo, Error, TEXT("查找XSP文件失败"));
         return;
     }
-
-    bool bFail = false;
     for (FString& FileName : FileArray)
     {
         FileName = FPaths::Combine(DataFilePath, FileName);
-        std::fstream FileStream;
-        FileStream.open(std::wstring(*FileName), std::ios::in | std::ios::binary);
-        if (!FileStream.is_open())
-        {
-            bFail = true;
-            break;
-        }
-        FileStream.seekg(0, std::ios::beg);
-        int NumNodes;
-        FileStream.read((char*)&NumNodes, sizeof(NumNodes));
-        NodesNumArray.Add(NumNodes);
-        FileStream.close();
-    }
-    if (bFail)
-    {
-        UE_LOG(LogDynamicLoadDemo, Error, TEXT("读取XSP文件失败"));
-        return;
     }
 
     IXSPLoader& Loader = FModuleManager::LoadModuleChecked<FXSPLoaderModule>("XSPLoader").Get();
@@ -55,45 +183,378 @@ void ADynamicLoadGameMode::BeginPlay()
         return;
     }
     
+    //不再为每个节点预先创建组件,网格体就绪时XSPLoader才从组件池中取出组件,被淘汰时归还
     DataActor = GetWorld()->SpawnActor<AActor>();
     USceneComponent* SceneComponent = NewObject<USceneComponent>(DataActor, TEXT("RootComponent"));
     DataActor->SetRootComponent(SceneComponent);
+    Loader.SetComponentOwner(DataActor);
 
-    int32 Index = 0;
-    for (int32 i = 0; i < NodesNumArray.Num(); ++i)
+    //缓存全部节点的包围盒,供每帧剔除使用
+    NodeBounds.SetNumUninitialized(Loader.GetNumNodes());
+    for (int32 Dbid = 0; Dbid < NodeBounds.Num(); ++Dbid)
     {
-        int32 Num = NodesNumArray[i];
-        for (int32 j = 0; j < Num; ++j)
+        FBox Box;
+        NodeBounds[Dbid] = Loader.GetNodeBoundingBox(Dbid, Box) ? FBox3f(Box) : FBox3f(ForceInit);
+    }
+
+    UE_LOG(LogDynamicLoadDemo, Display, TEXT("总共%d节点, 启动耗时%.1fms, 新增UObject %d个(共%d个)"), Loader.GetNumNodes(), (FPlatformTime::Seconds() - BeginTime) * 1000.0,
+        GUObjectArray.GetObjectArrayNumMinusAvailable() - NumUObjectsBefore, GUObjectArray.GetObjectArrayNumMinusAvailable());
+}
+
+void ADynamicLoadGameMode::Logout(AController* Exiting)
+{
+    FModuleManager::GetModuleChecked<FXSPLoaderModule>("XSPLoader").Get().Reset();
+}
+
+bool ADynamicLoadGameMode::GetViewInfo(FVector& OutViewOrigin, FRotator& OutViewRotation, FMatrix& OutProjMatrix) const
+{
+    APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+    if (!PlayerController || !PlayerController->PlayerCameraManager)
+        return false;
+
+    int32 SizeX = 0, SizeY = 0;
+    PlayerController->GetViewportSize(SizeX, SizeY);
+    if (SizeX <= 0 || SizeY <= 0)
+        return false;
+
+    OutViewOrigin = PlayerController->PlayerCameraManager->GetCameraLocation();
+    OutViewRotation = PlayerController->PlayerCameraManager->GetCameraRotation();
+    float HalfFOVRadians = FMath::DegreesToRadians(PlayerController->PlayerCameraManager->GetFOVAngle() * 0.5f);
+    OutProjMatrix = FReversedZPerspectiveMatrix(HalfFOVRadians, SizeX, SizeY, GNearClippingPlane);
+    return true;
+}
+
+void ADynamicLoadGameMode::CullNodes(const FVector& ViewOrigin, const FRotator& ViewRotation, const FMatrix& ProjMatrix)
+{
+    SCOPE_CYCLE_COUNTER(STAT_DemoCullNodes);
+    double BeginTime = FPlatformTime::Seconds();
+
+    //与引擎相同的视图矩阵约定:先平移到视点,再旋转到X朝右/Y朝上/Z朝前的视图空间
+    FMatrix TranslatedViewMatrix = FInverseRotationMatrix(ViewRotation) * FMatrix(
+        FPlane(0, 0, 1, 0),
+        FPlane(1, 0, 0, 0),
+        FPlane(0, 1, 0, 0),
+        FPlane(0, 0, 0, 1));
+    FMatrix ViewMatrix = FTranslationMatrix(-ViewOrigin) * TranslatedViewMatrix;
+    FConvexVolume ViewFrustum;
+    GetViewFrustumBounds(ViewFrustum, ViewMatrix * ProjMatrix, false);
+
+    FVector3f ViewOrigin3f(ViewOrigin);
+    float NearDistanceSquared = FMath::Square(GCullNearDistance);
+    float MidDistanceSquared = FMath::Square(FMath::Max(GCullNearDistance, GCullMidDistance));
+    float FarDistanceSquared = FMath::Square(FMath::Max3(GCullNearDistance, GCullMidDistance, GCullFarDistance));
+
+    //先由XSPLoader的空间索引查出与视锥相交的节点,只对这些节点做距离分段和屏幕尺寸的判断
+    IXSPLoader& Loader = FModuleManager::GetModuleChecked<FXSPLoaderModule>("XSPLoader").Get();
+    CandidateNodes.Reset();
+    Loader.GetNodeBVH().QueryConvex(ViewFrustum.Planes, CandidateNodes);
+
+    //候选节点按块并行处理,每块输出到各自的数组,最后合并
+    const int32 NumNodes = NodeBounds.Num();
+    const int32 NumCandidates = CandidateNodes.Num();
+    const int32 ChunkSize = 4096;
+    const int32 NumChunks = FMath::DivideAndRoundUp(NumCandidates, ChunkSize);
+    TArray<TArray<FVisibleNode>> ChunkResults;
+    ChunkResults.SetNum(NumChunks);
+    ParallelFor(NumChunks, [&](int32 ChunkIndex) {
+        TArray<FVisibleNode>& ChunkResult = ChunkResults[ChunkIndex];
+        int32 End = FMath::Min(NumCandidates, (ChunkIndex + 1) * ChunkSize);
+        for (int32 i = ChunkIndex * ChunkSize; i < End; ++i)
         {
-            FString Name = FString::FromInt(Index);
-            UStaticMeshComponent* StaticMeshComponent = NewObject<UStaticMeshComponent>(DataActor, *Name);
-            StaticMeshComponent->SetMobility(EComponentMobility::Movable);
-            StaticMeshComponent->AttachToComponent(DataActor->GetRootComponent(), FAttachmentTransformRules::KeepRelativeTransform);
-            StaticMeshComponents.Emplace(Index, StaticMeshComponent);
+            int32 Dbid = CandidateNodes[i];
+            if (!NodeBounds.IsValidIndex(Dbid))
+                continue;
+
+            const FBox3f& Box = NodeBounds[Dbid];
+            FVector Center = FVector(Box.GetCenter());
+            FVector Extent = FVector(Box.GetExtent());
+
+            //距离取视点到包围盒的最近距离,包含视点的包围盒距离为0
+            float DistanceSquared = Box.ComputeSquaredDistanceToPoint(ViewOrigin3f);
+            if (DistanceSquared > FarDistanceSquared)
+                continue;
+
+            float ScreenSize = ComputeBoundsScreenSize(Center, Extent.Size(), ViewOrigin, ProjMatrix);
+            if (DistanceSquared > MidDistanceSquared)
+            {
+                if (ScreenSize < GCullFarMinScreenSize)
+                    continue;
+            }
+            else if (DistanceSquared > NearDistanceSquared)
+            {
+                if (ScreenSize < GCullMidMinScreenSize)
+                    continue;
+            }
 
-            Index += 1;
+            ChunkResult.Add({ Dbid, ScreenSize });
         }
+        });
+
+    VisibleNodes.Reset();
+    for (TArray<FVisibleNode>& ChunkResult : ChunkResults)
+    {
+        VisibleNodes.Append(ChunkResult);
+    }
+    int32 NumVisible = VisibleNodes.Num();
+
+    //被选中的代理覆盖的节点不再单独请求
+    int32 NumCovered = SelectProxies(ViewOrigin, ProjMatrix);
+
+    //只保留尚未加载的节点,已加载的大节点留作遮挡体
+    Occluders.Reset();
+    VisibleLoadedNodes.Reset();
+    VisibleNodes.RemoveAllSwap([this, &Loader](const FVisibleNode& Node) {
+        UStaticMeshComponent* Component = Loader.GetNodeComponent(Node.Dbid);
+        if (nullptr == Component)
+            return false;
+        //此前被代理覆盖而隐藏的节点重新显示
+        if (!Component->IsVisible())
+            Component->SetVisibility(true);
+        VisibleLoadedNodes.Add(Node.Dbid);
+        if (Node.ScreenSize >= GOcclusionMinOccluderScreenSize)
+            Occluders.Add(Node);
+        return true;
+        }, false);
+    int32 NumOccluded = GOcclusionCulling > 0 ? CullOccludedNodes(ViewOrigin, TranslatedViewMatrix * ProjMatrix) : 0;
+
+    //按投影屏幕尺寸从大到小排序
+    VisibleNodes.Sort([](const FVisibleNode& Lhs, const FVisibleNode& Rhs) { return Lhs.ScreenSize > Rhs.ScreenSize; });
+
+    SET_DWORD_STAT(STAT_DemoNumCulledNodes, NumNodes - NumVisible);
+    SET_DWORD_STAT(STAT_DemoNumVisibleNodes, VisibleNodes.Num());
+    SET_DWORD_STAT(STAT_DemoNumOccludedNodes, NumOccluded);
+    SET_DWORD_STAT(STAT_DemoNumChosenProxies, ChosenProxies.Num());
+    SET_DWORD_STAT(STAT_DemoNumCoveredNodes, NumCovered);
+
+    //每5秒输出一次平均剔除耗时
+    double CurrentTime = FPlatformTime::Seconds();
+    CullTimeSum += CurrentTime - BeginTime;
+    NumCullFrames += 1;
+    if (CurrentTime - LastCullReportTime >= 5.0)
+    {
+        UE_LOG(LogDynamicLoadDemo, Display, TEXT("剔除: %d节点, 视锥内%d, 可见%d, 代理%d(覆盖%d), 被遮挡%d, 未加载%d, 平均耗时%.3fms, UObject %d个"), NumNodes, NumCandidates, NumVisible, ChosenProxies.Num(), NumCovered, NumOccluded, VisibleNodes.Num(), CullTimeSum * 1000.0 / NumCullFrames, GUObjectArray.GetObjectArrayNumMinusAvailable());
+        CullTimeSum = 0;
+        NumCullFrames = 0;
+        LastCullReportTime = CurrentTime;
     }
-    UE_LOG(LogDynamicLoadDemo, Display, TEXT("总共%d节点"), Index);
 }
 
-void ADynamicLoadGameMode::Logout(AController* Exiting)
+int32 ADynamicLoadGameMode::CullOccludedNodes(const FVector& ViewOrigin, const FMatrix& TranslatedViewProjMatrix)
 {
-    FModuleManager::GetModuleChecked<FXSPLoaderModule>("XSPLoader").Get().Reset();
+    SCOPE_CYCLE_COUNTER(STAT_DemoOcclusionCull);
+
+    if (OcclusionBuffer.GetWidth() == 0)
+    {
+        OcclusionBuffer.Init(OcclusionBufferWidth, OcclusionBufferHeight);
+    }
+    OcclusionBuffer.Clear(ViewOrigin, TranslatedViewProjMatrix, GNearClippingPlane);
+
+    //节点包围盒内的几何体通常是空心或稀疏的,只能以节点的真实三角形作为遮挡体;三角形与拾取共用缓存,尚未缓存的节点本帧不参与遮挡
+    IXSPLoader& Loader = FModuleManager::GetModuleChecked<FXSPLoaderModule>("XSPLoader").Get();
+    Occluders.Sort([](const FVisibleNode& Lhs, const FVisibleNode& Rhs) { return Lhs.ScreenSize > Rhs.ScreenSize; });
+    int32 MaxOccluders = FMath::Max(0, GOcclusionMaxOccluders);
+    int32 MaxOccluderTriangles = FMath::Max(0, GOcclusionMaxOccluderTriangles);
+    int32 NumBuildsAllowed = FMath::Max(0, GOcclusionMaxBuildsPerFrame);
+    for (int32 i = 0; i < Occluders.Num() && OcclusionBuffer.GetNumOccluders() < MaxOccluders; ++i)
+    {
+        Loader.VisitNodeTriangles(Occluders[i].Dbid, MaxOccluderTriangles, NumBuildsAllowed, [this](TArrayView<const FVector3f> TriangleVertices) {
+            OcclusionBuffer.AddOccluder(TriangleVertices);
+            });
+    }
+    OcclusionBuffer.Finalize();
+    SET_DWORD_STAT(STAT_DemoNumOccluders, OcclusionBuffer.GetNumOccluders());
+    if (OcclusionBuffer.GetNumOccluders() == 0)
+        return 0;
+
+    //并行测试后按结果压缩数组,保持其余节点的顺序
+    const int32 NumTested = VisibleNodes.Num();
+    TArray<bool> Occluded;
+    Occluded.SetNumZeroed(NumTested);
+    ParallelFor(NumTested, [&](int32 i) {
+        Occluded[i] = !OcclusionBuffer.IsVisible(NodeBounds[VisibleNodes[i].Dbid]);
+        }, NumTested < 256 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+    int32 NumKept = 0;
+    for (int32 i = 0; i < NumTested; ++i)
+    {
+        if (!Occluded[i])
+        {
+            VisibleNodes[NumKept++] = VisibleNodes[i];
+        }
+    }
+    VisibleNodes.SetNum(NumKept, false);
+    return NumTested - NumKept;
+}
+
+int32 ADynamicLoadGameMode::SelectProxies(const FVector& ViewOrigin, const FMatrix& ProjMatrix)
+{
+    SCOPE_CYCLE_COUNTER(STAT_DemoSelectProxies);
+
+    IXSPLoader& Loader = FModuleManager::GetModuleChecked<FXSPLoaderModule>("XSPLoader").Get();
+    ProxyChoices.Reset();
+    ChosenProxies.Reset();
+    ProxyRequests.Reset();
+    Swap(LastVisibleProxies, VisibleProxies);
+    VisibleProxies.Reset();
+
+    int32 NumCovered = 0;
+    if (GHLOD > 0)
+    {
+        //与ComputeBoundsScreenSize相同的屏幕尺寸度量
+        const float ScreenMultiple = FMath::Max(0.5f * ProjMatrix.M[0][0], 0.5f * ProjMatrix.M[1][1]);
+        VisibleNodes.RemoveAllSwap([&](const FVisibleNode& Node) {
+            int32 Proxy = FindTopProxy(Loader, Node.Dbid, ViewOrigin, ScreenMultiple);
+            if (Proxy == INDEX_NONE)
+                return false;
+            ChosenProxies.Add(Proxy);
+
+            //已加载的节点在代理加载之前仍然显示,代理加载之后与子树中其他已加载的节点一起隐藏
+            if (nullptr != Loader.GetNodeComponent(Node.Dbid) && nullptr == Loader.GetProxyComponent(Proxy))
+                return false;
+            NumCovered++;
+            return true;
+            }, false);
+    }
+
+    //选中的代理已加载则显示,否则请求
+    for (int32 Proxy : ChosenProxies)
+    {
+        if (nullptr != Loader.GetProxyComponent(Proxy))
+        {
+            VisibleProxies.Add(Proxy);
+        }
+        else
+        {
+            FBox Bounds;
+            float Error;
+            Loader.GetProxyInfo(Proxy, Bounds, Error);
+            ProxyRequests.Add({ Proxy, ComputeBoundsScreenSize(Bounds.GetCenter(), Bounds.GetExtent().Size(), ViewOrigin, ProjMatrix) });
+        }
+    }
+
+    //不再显示的代理隐藏,因它而隐藏的节点恢复显示;先恢复再隐藏,代理切换到上级或下级时节点的最终状态由新代理决定
+    for (int32 Proxy : LastVisibleProxies)
+    {
+        if (VisibleProxies.Contains(Proxy))
+            continue;
+        if (UStaticMeshComponent* ProxyComponent = Loader.GetProxyComponent(Proxy))
+            ProxyComponent->SetVisibility(false);
+        TArray<int32> HiddenNodes;
+        if (ProxyHiddenNodes.RemoveAndCopyValue(Proxy, HiddenNodes))
+        {
+            for (int32 Dbid : HiddenNodes)
+            {
+                UStaticMeshComponent* Component = Loader.GetNodeComponent(Dbid);
+                if (nullptr != Component && !Component->IsVisible())
+                    Component->SetVisibility(true);
+            }
+        }
+    }
+
+    //显示的代理隐藏其子树中全部已加载的节点,包括被距离或屏幕尺寸剔除的节点,以及代理显示之后才加载完成的节点
+    for (int32 Proxy : VisibleProxies)
+    {
+        UStaticMeshComponent* ProxyComponent = Loader.GetProxyComponent(Proxy);
+        if (!ProxyComponent->IsVisible())
+            ProxyComponent->SetVisibility(true);
+
+        TArray<int32>& HiddenNodes = ProxyHiddenNodes.FindOrAdd(Proxy);
+        SubtreeStack.Reset();
+        SubtreeStack.Append(Loader.GetNodeChildren(Proxy));
+        while (SubtreeStack.Num() > 0)
+        {
+            int32 Dbid = SubtreeStack.Pop(false);
+            SubtreeStack.Append(Loader.GetNodeChildren(Dbid));
+            UStaticMeshComponent* Component = Loader.GetNodeComponent(Dbid);
+            if (nullptr != Component && Component->IsVisible())
+            {
+                Component->SetVisibility(false);
+                HiddenNodes.Add(Dbid);
+            }
+        }
+    }
+    ProxyRequests.Sort([](const FVisibleNode& Lhs, const FVisibleNode& Rhs) { return Lhs.ScreenSize > Rhs.ScreenSize; });
+    return NumCovered;
+}
+
+int32 ADynamicLoadGameMode::FindTopProxy(const IXSPLoader& Loader, int32 Dbid, const FVector& ViewOrigin, float ScreenMultiple)
+{
+    //自下而上收集尚未判断过的节点,遇到本帧已判断过的节点即可得知其上方的结果;层级数设上限以防数据中有环
+    static constexpr int32 MaxNodeDepth = 256;
+    ProxyChain.Reset();
+    int32 TopProxy = INDEX_NONE;
+    for (int32 Node = Dbid; Node != INDEX_NONE && ProxyChain.Num() < MaxNodeDepth; Node = Loader.GetNodeParent(Node))
+    {
+        if (const int32* Found = ProxyChoices.Find(Node))
+        {
+            TopProxy = *Found;
+            break;
+        }
+        ProxyChain.Add(Node);
+    }
+
+    //自上而下:上级已选中代理时沿用,否则判断自身代理的误差投影到屏幕上是否可接受,视点在代理包围盒内时不可接受
+    for (int32 i = ProxyChain.Num() - 1; i >= 0; --i)
+    {
+        int32 Node = ProxyChain[i];
+        FBox Bounds;
+        float Error;
+        if (TopProxy == INDEX_NONE && Loader.GetProxyInfo(Node, Bounds, Error))
+        {
+            double Distance = FMath::Sqrt(Bounds.ComputeSquaredDistanceToPoint(ViewOrigin));
+            if (Distance > 0 && 2.0 * ScreenMultiple * Error / Distance <= GHLODMaxScreenError)
+                TopProxy = Node;
+        }
+        ProxyChoices.Add(Node, TopProxy);
+    }
+    return TopProxy;
 }
 
 void ADynamicLoadGameMode::Tick(float deltaSeconds)
 {
-    //模拟每帧剔除操作,所有节点都通过,对未加载的节点发起加载请求
-    int32 Count = 0;
-    for (auto& Pair : StaticMeshComponents)
+    IXSPLoader& Loader = FModuleManager::GetModuleChecked<FXSPLoaderModule>("XSPLoader").Get();
+
+    FVector ViewOrigin;
+    FRotator ViewRotation;
+    FMatrix ProjMatrix;
+    if (!GetViewInfo(ViewOrigin, ViewRotation, ProjMatrix))
+        return;
+
+    //视锥和距离分段剔除后,对未加载的可见节点按投影屏幕尺寸从大到小发起加载请求
+    //优先级取节点包围盒的投影屏幕尺寸,每帧重新计算,已在队列中的请求会被就地更新
+    CullNodes(ViewOrigin, ViewRotation, ProjMatrix);
+    //已加载的可见节点刷新其最近可见的帧,超出内存预算时XSPLoader优先卸载长时间不可见的节点
+    Loader.MarkNodesVisible(VisibleLoadedNodes);
+    Loader.MarkProxiesVisible(VisibleProxies);
+
+    //代理代替了整个子树的节点,先于节点请求
+    PendingRequests.Reset();
+    int32 MaxRequests = FMath::Max(0, GMaxRequestsPerFrame);
+    for (int32 i = 0; i < ProxyRequests.Num() && PendingRequests.Num() < MaxRequests; ++i)
+    {
+        const FVisibleNode& Proxy = ProxyRequests[i];
+        PendingRequests.Emplace(Proxy.Dbid, Proxy.ScreenSize, nullptr, true);
+    }
+    int32 NumRequests = FMath::Min(VisibleNodes.Num(), MaxRequests - PendingRequests.Num());
+    for (int32 i = 0; i < NumRequests; ++i)
+    {
+        const FVisibleNode& Node = VisibleNodes[i];
+        PendingRequests.Emplace(Node.Dbid, Node.ScreenSize, nullptr);
+    }
+    SET_DWORD_STAT(STAT_DemoNumRequestedNodes, PendingRequests.Num());
+
+    if (GBatchRequests > 0)
+    {
+        Loader.RequestStaticMeshes(PendingRequests);
+    }
+    else
     {
-        if (Pair.Value->GetStaticMesh() == nullptr)
+        for (const FXSPMeshRequest& Request : PendingRequests)
         {
-            FModuleManager::GetModuleChecked<FXSPLoaderModule>("XSPLoader").Get().RequestStaticMesh(Pair.Key, 0, Pair.Value);
-            Count += 1;
+            if (Request.bProxy)
+                Loader.RequestProxyMesh(Request.Dbid, Request.Priority, Request.TargetMeshComponent);
+            else
+                Loader.RequestStaticMesh(Request.Dbid, Request.Priority, Request.TargetMeshComponent);
         }
-        if (Count > 1000)
-            return;
     }
 }
@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/GameModeBase.h"
+#include "IXSPLoader.h"
+#include "XSPOcclusionBuffer.h"
 #include "DynamicLoadGameMode.generated.h"
 
 /**
@@ -22,11 +24,68 @@ public:
 	virtual void Tick(float deltaSeconds) override;
 
 private:
+	//获取当前玩家视点位置、朝向和投影矩阵,用于视锥剔除和计算节点的投影屏幕尺寸
+	bool GetViewInfo(FVector& OutViewOrigin, FRotator& OutViewRotation, FMatrix& OutProjMatrix) const;
+
+	//对全部节点做视锥和距离分段剔除,按投影屏幕尺寸从大到小输出尚未加载的可见节点
+	void CullNodes(const FVector& ViewOrigin, const FRotator& ViewRotation, const FMatrix& ProjMatrix);
+
+	//以已加载的大节点的三角形为遮挡体,从VisibleNodes中移除被完全遮挡的节点,返回移除的个数
+	int32 CullOccludedNodes(const FVector& ViewOrigin, const FMatrix& TranslatedViewProjMatrix);
+
+	//为VisibleNodes中的节点选择可代替其子树的HLOD代理,从VisibleNodes中移除被代理覆盖的节点,返回移除的个数
+	int32 SelectProxies(const FVector& ViewOrigin, const FMatrix& ProjMatrix);
+
+	//节点及其上级中屏幕误差可接受的最上层代理,没有时为INDEX_NONE
+	int32 FindTopProxy(const IXSPLoader& Loader, int32 Dbid, const FVector& ViewOrigin, float ScreenMultiple);
+
+private:
+	//节点和代理的组件都由XSPLoader在网格体就绪时从组件池中取出,创建在此Actor上
 	UPROPERTY()
 	AActor* DataActor;
 
-	UPROPERTY()
-	TMap<int32, UStaticMeshComponent*> StaticMeshComponents;
+	//每帧收集的批量请求,复用以避免每帧分配
+	TArray<FXSPMeshRequest> PendingRequests;
+
+	//全部节点的包围盒,按dbid索引,在BeginPlay时从XSPLoader取得
+	TArray<FBox3f> NodeBounds;
+
+	//视锥查询得到的候选节点,复用以避免每帧分配
+	TArray<int32> CandidateNodes;
+
+	//剔除结果:通过剔除的节点及其投影屏幕尺寸
+	struct FVisibleNode
+	{
+		int32 Dbid;
+		float ScreenSize;
+	};
+	TArray<FVisibleNode> VisibleNodes;
+
+	//通过剔除的已加载节点,每帧报告给XSPLoader,使其不被淘汰
+	TArray<int32> VisibleLoadedNodes;
+
+	//本帧每个判断过的节点对应的最上层代理,避免对共同的上级重复判断
+	TMap<int32, int32> ProxyChoices;
+	TArray<int32> ProxyChain;
+
+	//本帧选中的代理,以及其中尚未加载需要请求的和已加载显示的;上一帧显示的代理本帧未被选中时隐藏
+	TSet<int32> ChosenProxies;
+	TArray<FVisibleNode> ProxyRequests;
+	TArray<int32> VisibleProxies;
+	TArray<int32> LastVisibleProxies;
+
+	//显示的代理及因其显示而隐藏的节点,代理不再显示时这些节点恢复显示;遍历子树用的栈
+	TMap<int32, TArray<int32>> ProxyHiddenNodes;
+	TArray<int32> SubtreeStack;
+
+	//遮挡剔除:可作为遮挡体的已加载节点,以及CPU上的低分辨率遮挡缓冲
+	TArray<FVisibleNode> Occluders;
+	FXSPOcclusionBuffer OcclusionBuffer;
+	static constexpr int32 OcclusionBufferWidth = 256;
+	static constexpr int32 OcclusionBufferHeight = 128;
 
-	TArray<int32> NodesNumArray;
+	//剔除耗时的统计,定期输出到日志
+	double CullTimeSum = 0;
+	int32 NumCullFrames = 0;
+	double LastCullReportTime = 0;
 };
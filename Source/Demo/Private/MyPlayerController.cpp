@@ -3,6 +3,10 @@
 
 #include "MyPlayerController.h"
 #include "Engine/EngineTypes.h"
+#include "Engine/StaticMesh.h"
+#include "Components/StaticMeshComponent.h"
+#include "MeshFaceObjectMap.h"
+#include "XSPLoaderModule.h"
 
 bool AMyPlayerController::GetHitResultWithFaceIndexUnderCursorByChannel(ETraceTypeQuery TraceChannel, FHitResult& HitResult) const
 {
@@ -28,3 +32,42 @@ bool AMyPlayerController::GetHitResultWithFaceIndexUnderCursorByChannel(ETraceTy
 
     return bHit;
 }
+
+bool AMyPlayerController::GetHitObjectIDUnderCursorByChannel(ETraceTypeQuery TraceChannel, FHitResult& HitResult, FName& ObjectID) const
+{
+    ObjectID = NAME_None;
+    if (!GetHitResultWithFaceIndexUnderCursorByChannel(TraceChannel, HitResult))
+        return false;
+
+    //合并时生成的三角形对应表挂在静态网格资产上
+    const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(HitResult.GetComponent());
+    UStaticMesh* StaticMesh = StaticMeshComponent ? StaticMeshComponent->GetStaticMesh() : nullptr;
+    if (const UMeshFaceObjectMap* FaceObjectMap = StaticMesh ? StaticMesh->GetAssetUserData<UMeshFaceObjectMap>() : nullptr)
+    {
+        ObjectID = FaceObjectMap->FindObjectID(HitResult.FaceIndex);
+    }
+    return true;
+}
+
+bool AMyPlayerController::GetHitNodeUnderCursor(float MaxDistance, int32& Dbid, int32& FaceIndex, FVector& Location, bool& bPending) const
+{
+    Dbid = INDEX_NONE;
+    FaceIndex = INDEX_NONE;
+    Location = FVector::ZeroVector;
+    bPending = false;
+
+    FVector WorldOrigin, WorldDirection;
+    if (!DeprojectMousePositionToWorld(WorldOrigin, WorldDirection))
+        return false;
+
+    FXSPPickHit Hit;
+    bool bHit = FModuleManager::GetModuleChecked<FXSPLoaderModule>("XSPLoader").Get().PickNode(WorldOrigin, WorldDirection, MaxDistance, Hit);
+    bPending = Hit.bPending;
+    if (bHit)
+    {
+        Dbid = Hit.Dbid;
+        FaceIndex = Hit.TriangleIndex;
+        Location = Hit.Location;
+    }
+    return bHit;
+}
@@ -4,6 +4,10 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/GameModeBase.h"
+#include "XSPBuildBudget.h"
+#include "XSPMergeBudget.h"
+#include "XSPBatchRegistrar.h"
+#include "XSPStaticMeshPool.h"
 #include "DynamicGenActorsGameMode.generated.h"
 
 /**
@@ -20,6 +24,23 @@ public:
 	virtual void BeginPlay() override;
 	virtual void Tick(float deltaSeconds) override;
 
+	// 聚簇模式(r.My.BatchNodes=2)下由拾取到的组件和三角形序号查找节点,不是聚簇的组件返回-1
+	// 簇的网格体带有复杂碰撞,FaceIndex取自开启bTraceComplex和bReturnFaceIndex的射线检测的FHitResult::FaceIndex,如AMyPlayerController::GetHitResultWithFaceIndexUnderCursorByChannel
+	UFUNCTION(BlueprintCallable, Category = "Dynamic Gen Actors")
+	int32 FindNodeByFace(const UPrimitiveComponent* Component, int32 FaceIndex) const;
+
+	// 聚簇模式下隐藏或显示节点,异步重建其所在的簇
+	UFUNCTION(BlueprintCallable, Category = "Dynamic Gen Actors")
+	void SetNodeHidden(int32 Dbid, bool bHidden);
+
+	// 节点在所在簇的网格体中的三角形范围,与FMeshInfoTableRow相同
+	struct FNodeFaceRange
+	{
+		int32 Dbid;
+		int32 StartFaceIndex;
+		int32 FaceCount;
+	};
+
 private:
 	// 材质模板
 	UPROPERTY()
@@ -74,6 +95,41 @@ private:
 	int32 NumLoadedNodes = 0;
 	int32 NumTotoalTriangles = 0;
 
+	// 异步构建时下一个待分发的节点,受构建预算限制逐帧分发
+	int32 NextNodeToBuild = 0;
+	FXSPBuildBudget BuildBudget;
+
+	// 合并新网格到场景的帧时间预算
+	FXSPMergeBudget MergeBudget;
+
+	// 本帧加入场景的组件在全部设置好后一起注册
+	FXSPBatchRegistrar ComponentRegistrar;
+
+	// 预先创建的静态网格对象,读取文件期间和加载过程中逐帧补充,分发构建任务时取用
+	FXSPStaticMeshPool MeshPool;
+
+	// 材质相同且空间上相邻的一组节点,合并为一个静态网格
+	struct FNodeCluster
+	{
+		std::vector<struct Body_info*> Nodes;
+		FLinearColor Color;
+		float Roughness;
+		int64 NumTriangles = 0;
+		// 按StartFaceIndex升序,隐藏的节点FaceCount为0
+		TArray<FNodeFaceRange> FaceRanges;
+		UStaticMeshComponent* Component = nullptr;
+		// 已在构建队列中,避免重复重建
+		bool bBuildQueued = false;
+		// 有构建任务在进行,完成前不再分发,保证按顺序替换网格体
+		bool bBuilding = false;
+	};
+	TArray<FNodeCluster> Clusters;
+	// 待构建的簇,按加入的顺序分发
+	TArray<int32> ClusterBuildQueue;
+	TMap<int32, int32> NodeClusterIndices;
+	TMap<const UPrimitiveComponent*, int32> ComponentClusterIndices;
+	TSet<int32> HiddenNodes;
+
 	// 存放构建完成的静态网格对象及相关数据
 	struct FLoadedData
 	{
@@ -82,13 +138,27 @@ private:
 		FLinearColor Color;
 		float Roughness;
 		int32 NumTriangles = 0;
+		// 本次加载完成的节点数,重建簇时为0
+		int32 NumNodes = 1;
+		// 聚簇模式下所属的簇及各节点的三角形范围
+		int32 ClusterIndex = INDEX_NONE;
+		TArray<FNodeFaceRange> FaceRanges;
 	};
 
 	// 多生产者单消费者的无锁队列
 	TQueue<FLoadedData, EQueueMode::Mpsc> LoadedNodes;
 	friend class FBuildStaticMeshTask;
+	friend class FBuildClusterTask;
 
 private:
 	void LoadScene();
-	void AddToScene(FLoadedData* LoadedData);
+	// 按材质分组,再按空间递归二分,使每个簇的三角形数不超过r.My.ClusterMaxTriangles
+	void BuildClusters();
+	void IssueBuildTasks();
+	void IssueClusterBuildTasks();
+	// 从完成队列取出静态网格加入场景
+	void MergeLoadedNodes(float DeltaSeconds);
+	void AddToScene(FLoadedData* LoadedData, bool bDeferRegister);
+	// 加载完成后对一个簇做一次复杂射线检测,确认碰撞数据可以返回FaceIndex,结果写入日志
+	void VerifyClusterPicking() const;
 };
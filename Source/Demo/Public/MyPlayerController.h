@@ -18,4 +18,12 @@ public:
 	//封装这个拾取函数以便能够在HitResult中返回FaceIndex
 	UFUNCTION(BlueprintCallable, Category = "Game|Player")
 	bool GetHitResultWithFaceIndexUnderCursorByChannel(ETraceTypeQuery TraceChannel, FHitResult& HitResult) const;
+
+	//拾取光标下的物体，命中合并的静态网格时由FaceIndex二分查找其源物体的ID，否则ObjectID为None
+	UFUNCTION(BlueprintCallable, Category = "Game|Player")
+	bool GetHitObjectIDUnderCursorByChannel(ETraceTypeQuery TraceChannel, FHitResult& HitResult, FName& ObjectID) const;
+
+	//拾取光标下XSPLoader的节点，不依赖碰撞体，节点数据以世界原点为基准；bPending为true时较近的节点尚在准备，稍后重试
+	UFUNCTION(BlueprintCallable, Category = "Game|Player")
+	bool GetHitNodeUnderCursor(float MaxDistance, int32& Dbid, int32& FaceIndex, FVector& Location, bool& bPending) const;
 };